@@ -39,5 +39,6 @@ LOCAL_SRC_FILES               := hwc.cpp          \
                                  hwc_qclient.cpp  \
                                  hwc_dump_layers.cpp \
                                  hwc_ad.cpp \
-                                 hwc_virtual.cpp
+                                 hwc_virtual.cpp \
+                                 hwc_cadence.cpp
 include $(BUILD_SHARED_LIBRARY)
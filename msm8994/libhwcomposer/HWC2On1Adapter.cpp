@@ -82,15 +82,41 @@ namespace android {
 void HWC2On1Adapter::DisplayContentsDeleter::operator()(
         hwc_display_contents_1_t* contents)
 {
-    if (contents != nullptr) {
-        for (size_t l = 0; l < contents->numHwLayers; ++l) {
-            auto& layer = contents->hwLayers[l];
-            std::free(const_cast<hwc_rect_t*>(layer.visibleRegionScreen.rects));
-        }
-    }
+    // The rects are owned by the layers' latched visible regions and by the
+    // display's framebuffer target rect
     std::free(contents);
 }
 
+void* HWC2On1Adapter::FrameArena::allocate(size_t size)
+{
+    size_t words = (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    if (words == 0) {
+        return nullptr;
+    }
+
+    if (mUsed + words <= mStorage.size()) {
+        void* block = &mStorage[mUsed];
+        mUsed += words;
+        return block;
+    }
+
+    // Out of storage for this frame; blocks already handed out must stay put,
+    // so serve the request separately and grow on the next reset
+    mOverflowSize += words;
+    mOverflow.emplace_back(new uint64_t[words]);
+    return mOverflow.back().get();
+}
+
+void HWC2On1Adapter::FrameArena::reset()
+{
+    if (mOverflowSize != 0) {
+        mStorage.resize(mUsed + mOverflowSize);
+        mOverflow.clear();
+        mOverflowSize = 0;
+    }
+    mUsed = 0;
+}
+
 class HWC2On1Adapter::Callbacks : public hwc_procs_t {
     public:
         explicit Callbacks(HWC2On1Adapter& adapter) : mAdapter(adapter) {
@@ -555,6 +581,9 @@ HWC2On1Adapter::Display::Display(HWC2On1Adapter& device, HWC2::DisplayType type)
     mZIsDirty(false),
     mHwc1RequestedContents(nullptr),
     mHwc1ReceivedContents(nullptr),
+    mFrameArenas(),
+    mFrameArenaIndex(0),
+    mHwc1TargetVisibleRect(),
     mRetireFence(),
     mChanges(),
     mHwc1Id(-1),
@@ -591,7 +620,24 @@ Error HWC2On1Adapter::Display::acceptChanges()
 
     mChanges->clearTypeChanges();
 
-    mHwc1RequestedContents = std::move(mHwc1ReceivedContents);
+    // Carry what HWC1 decided over into the requested contents. The rects are
+    // the same as in the requested contents, keep pointing at our own copies.
+    if (mHwc1ReceivedContents != nullptr && mHwc1RequestedContents &&
+            mHwc1ReceivedContents->numHwLayers ==
+            mHwc1RequestedContents->numHwLayers) {
+        auto requested = mHwc1RequestedContents.get();
+        for (size_t l = 0; l < requested->numHwLayers; ++l) {
+            auto& layer = requested->hwLayers[l];
+            auto visibleRegion = layer.visibleRegionScreen;
+            auto surfaceDamage = layer.surfaceDamage;
+            layer = mHwc1ReceivedContents->hwLayers[l];
+            layer.visibleRegionScreen = visibleRegion;
+            layer.surfaceDamage = surfaceDamage;
+        }
+        requested->retireFenceFd = mHwc1ReceivedContents->retireFenceFd;
+        requested->flags = mHwc1ReceivedContents->flags;
+    }
+    mHwc1ReceivedContents = nullptr;
 
     return Error::None;
 }
@@ -1300,37 +1346,41 @@ bool HWC2On1Adapter::Display::prepare()
     return true;
 }
 
-static void cloneHWCRegion(hwc_region_t& region)
-{
-    auto size = sizeof(hwc_rect_t) * region.numRects;
-    auto newRects = static_cast<hwc_rect_t*>(std::malloc(size));
-    std::copy_n(region.rects, region.numRects, newRects);
-    region.rects = newRects;
-}
-
-HWC2On1Adapter::Display::HWC1Contents
-        HWC2On1Adapter::Display::cloneRequestedContents() const
+hwc_display_contents_1_t* HWC2On1Adapter::Display::cloneRequestedContents()
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
+    mFrameArenaIndex ^= 1;
+    auto& arena = mFrameArenas[mFrameArenaIndex];
+    arena.reset();
+
     size_t size = sizeof(hwc_display_contents_1_t) +
             sizeof(hwc_layer_1_t) * (mHwc1RequestedContents->numHwLayers);
-    auto contents = static_cast<hwc_display_contents_1_t*>(std::malloc(size));
+    auto contents = static_cast<hwc_display_contents_1_t*>(
+            arena.allocate(size));
     std::memcpy(contents, mHwc1RequestedContents.get(), size);
+
+    auto cloneHWCRegion = [&arena](hwc_region_t& region) {
+        auto rectsSize = sizeof(hwc_rect_t) * region.numRects;
+        auto newRects = static_cast<hwc_rect_t*>(arena.allocate(rectsSize));
+        std::copy_n(region.rects, region.numRects, newRects);
+        region.rects = newRects;
+    };
     for (size_t layerId = 0; layerId < contents->numHwLayers; ++layerId) {
         auto& layer = contents->hwLayers[layerId];
-        // Deep copy the regions to avoid double-frees
+        // Deep copy the regions so HWC1 never sees our live storage
         cloneHWCRegion(layer.visibleRegionScreen);
         cloneHWCRegion(layer.surfaceDamage);
     }
-    return HWC1Contents(contents);
+    return contents;
 }
 
-void HWC2On1Adapter::Display::setReceivedContents(HWC1Contents contents)
+void HWC2On1Adapter::Display::setReceivedContents(
+        hwc_display_contents_1_t* contents)
 {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
-    mHwc1ReceivedContents = std::move(contents);
+    mHwc1ReceivedContents = contents;
 
     mChanges.reset(new Changes);
 
@@ -1957,12 +2007,8 @@ void HWC2On1Adapter::Display::prepareFramebufferTarget()
     hwc1Target.displayFrame = {0, 0, width, height};
     hwc1Target.planeAlpha = 255;
     hwc1Target.visibleRegionScreen.numRects = 1;
-    auto rects = static_cast<hwc_rect_t*>(std::malloc(sizeof(hwc_rect_t)));
-    rects[0].left = 0;
-    rects[0].top = 0;
-    rects[0].right = width;
-    rects[0].bottom = height;
-    hwc1Target.visibleRegionScreen.rects = rects;
+    mHwc1TargetVisibleRect = {0, 0, width, height};
+    hwc1Target.visibleRegionScreen.rects = &mHwc1TargetVisibleRect;
 
     // We will set this to the correct value in set
     hwc1Target.acquireFenceFd = -1;
@@ -2246,15 +2292,12 @@ void HWC2On1Adapter::Layer::applyCommonState(hwc_layer_1_t& hwc1Layer,
     if (applyAllState || mVisibleRegion.isDirty()) {
         auto& hwc1VisibleRegion = hwc1Layer.visibleRegionScreen;
 
-        std::free(const_cast<hwc_rect_t*>(hwc1VisibleRegion.rects));
-
-        auto pending = mVisibleRegion.getPendingValue();
-        hwc_rect_t* newRects = static_cast<hwc_rect_t*>(
-                std::malloc(sizeof(hwc_rect_t) * pending.size()));
-        std::copy(pending.begin(), pending.end(), newRects);
-        hwc1VisibleRegion.rects = const_cast<const hwc_rect_t*>(newRects);
-        hwc1VisibleRegion.numRects = pending.size();
+        // The latched region stays untouched until the next latch, which
+        // always repoints the HWC1 layer at it again
         mVisibleRegion.latch();
+        const auto& visible = mVisibleRegion.getValue();
+        hwc1VisibleRegion.rects = visible.data();
+        hwc1VisibleRegion.numRects = visible.size();
     }
 }
 
@@ -2425,24 +2468,23 @@ bool HWC2On1Adapter::prepareAllDisplays()
         return false;
     }
 
+    // mHwc1Contents keeps its capacity from frame to frame
+    mHwc1Contents.clear();
+
     // Always push the primary display
-    std::vector<HWC2On1Adapter::Display::HWC1Contents> requestedContents;
     auto primaryDisplayId = mHwc1DisplayMap[HWC_DISPLAY_PRIMARY];
     auto& primaryDisplay = mDisplays[primaryDisplayId];
-    auto primaryDisplayContents = primaryDisplay->cloneRequestedContents();
-    requestedContents.push_back(std::move(primaryDisplayContents));
+    mHwc1Contents.push_back(primaryDisplay->cloneRequestedContents());
 
     // Push the external display, if present
     if (mHwc1DisplayMap.count(HWC_DISPLAY_EXTERNAL) != 0) {
         auto externalDisplayId = mHwc1DisplayMap[HWC_DISPLAY_EXTERNAL];
         auto& externalDisplay = mDisplays[externalDisplayId];
-        auto externalDisplayContents =
-                externalDisplay->cloneRequestedContents();
-        requestedContents.push_back(std::move(externalDisplayContents));
+        mHwc1Contents.push_back(externalDisplay->cloneRequestedContents());
     } else {
         // Even if an external display isn't present, we still need to send
         // at least two displays down to HWC1
-        requestedContents.push_back(nullptr);
+        mHwc1Contents.push_back(nullptr);
     }
 
     // Push the hardware virtual display, if supported and present
@@ -2450,22 +2492,19 @@ bool HWC2On1Adapter::prepareAllDisplays()
         if (mHwc1DisplayMap.count(HWC_DISPLAY_VIRTUAL) != 0) {
             auto virtualDisplayId = mHwc1DisplayMap[HWC_DISPLAY_VIRTUAL];
             auto& virtualDisplay = mDisplays[virtualDisplayId];
-            auto virtualDisplayContents =
-                    virtualDisplay->cloneRequestedContents();
-            requestedContents.push_back(std::move(virtualDisplayContents));
+            mHwc1Contents.push_back(virtualDisplay->cloneRequestedContents());
         } else {
-            requestedContents.push_back(nullptr);
+            mHwc1Contents.push_back(nullptr);
         }
     }
 
-    mHwc1Contents.clear();
-    for (auto& displayContents : requestedContents) {
-        mHwc1Contents.push_back(displayContents.get());
+    for (size_t c = 0; c < mHwc1Contents.size(); ++c) {
+        auto displayContents = mHwc1Contents[c];
         if (!displayContents) {
             continue;
         }
 
-        ALOGV("Display %zd layers:", mHwc1Contents.size() - 1);
+        ALOGV("Display %zd layers:", c);
         for (size_t l = 0; l < displayContents->numHwLayers; ++l) {
             auto& layer = displayContents->hwLayers[l];
             ALOGV("  %zd: %d", l, layer.compositionType);
@@ -2498,7 +2537,7 @@ bool HWC2On1Adapter::prepareAllDisplays()
 
         auto displayId = mHwc1DisplayMap[hwc1Id];
         auto& display = mDisplays[displayId];
-        display->setReceivedContents(std::move(requestedContents[hwc1Id]));
+        display->setReceivedContents(mHwc1Contents[hwc1Id]);
     }
 
     return true;
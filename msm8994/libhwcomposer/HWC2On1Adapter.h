@@ -151,6 +151,27 @@ private:
             std::queue<sp<Fence>> mFences;
     };
 
+    // Bump allocator for the HWC1 contents handed to prepare and set. It is
+    // reset every frame and keeps the largest frame's worth of storage, so
+    // once the layer count settles no allocations are made.
+    class FrameArena {
+        public:
+            FrameArena()
+              : mStorage(),
+                mUsed(0),
+                mOverflowSize(0),
+                mOverflow() {}
+
+            void* allocate(size_t size);
+            void reset();
+
+        private:
+            std::vector<uint64_t> mStorage;
+            size_t mUsed;
+            size_t mOverflowSize;
+            std::vector<std::unique_ptr<uint64_t[]>> mOverflow;
+    };
+
     class FencedBuffer {
         public:
             FencedBuffer() : mBuffer(nullptr), mFence(Fence::NO_FENCE) {}
@@ -231,8 +252,8 @@ private:
             void populateConfigs(uint32_t width, uint32_t height);
 
             bool prepare();
-            HWC1Contents cloneRequestedContents() const;
-            void setReceivedContents(HWC1Contents contents);
+            struct hwc_display_contents_1* cloneRequestedContents();
+            void setReceivedContents(struct hwc_display_contents_1* contents);
             bool hasChanges() const;
             HWC2::Error set(hwc_display_contents_1& hwcContents);
             void addRetireFence(int fenceFd);
@@ -369,7 +390,13 @@ private:
 
             bool mZIsDirty;
             HWC1Contents mHwc1RequestedContents;
-            HWC1Contents mHwc1ReceivedContents;
+            // Points into one of the frame arenas, which are used in turn so
+            // that the contents received in the previous frame stay valid
+            // while the next frame is cloned
+            struct hwc_display_contents_1* mHwc1ReceivedContents;
+            FrameArena mFrameArenas[2];
+            size_t mFrameArenaIndex;
+            hwc_rect_t mHwc1TargetVisibleRect;
             DeferredFence mRetireFence;
 
             // Will only be non-null after the layer has been validated but
@@ -476,8 +503,8 @@ private:
                 mPendingValue = value;
             }
 
-            T getValue() const { return mValue; }
-            T getPendingValue() const { return mPendingValue; }
+            const T& getValue() const { return mValue; }
+            const T& getPendingValue() const { return mPendingValue; }
 
             bool isDirty() const { return mPendingValue != mValue; }
 
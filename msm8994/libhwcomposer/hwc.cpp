@@ -39,6 +39,7 @@
 #include "hwc_ad.h"
 #include "profiler.h"
 #include "hwc_virtual.h"
+#include "hwc_cadence.h"
 
 using namespace qhwc;
 using namespace overlay;
@@ -85,9 +86,9 @@ static void hwc_registerProcs(struct hwc_composer_device_1* dev,
     ctx->proc = procs;
 
     // Now that we have the functions needed, kick off
-    // the uevent & vsync threads
+    // the uevent & vsync event threads
     init_uevent_thread(ctx);
-    init_vsync_thread(ctx);
+    init_event_thread(ctx);
 }
 
 static void setPaddingRound(hwc_context_t *ctx, int numDisplays,
@@ -904,7 +905,10 @@ void hwc_dump(struct hwc_composer_device_1* dev, char *buff, int buff_len)
     for(int dpy = 0; dpy < HWC_NUM_DISPLAY_TYPES; dpy++) {
         if(ctx->mMDPComp[dpy])
             ctx->mMDPComp[dpy]->dump(aBuf, ctx);
+        if(ctx->mCadence[dpy] && ctx->dpyAttr[dpy].connected)
+            ctx->mCadence[dpy]->dump(aBuf);
     }
+    dump_event_thread_stats(aBuf);
     char ovDump[2048] = {'\0'};
     ctx->mOverlay->getDump(ovDump, 2048);
     dumpsys_log(aBuf, ovDump);
@@ -0,0 +1,123 @@
+/*
+* Copyright (c) 2017 The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation. nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <inttypes.h>
+#include "hwc_cadence.h"
+
+namespace qhwc {
+
+void CadenceTracker::Track::reset(uint32_t trackId, const hwc_rect_t& frame) {
+    *this = Track();
+    id = trackId;
+    displayFrame = frame;
+}
+
+bool CadenceTracker::Track::owns(buffer_handle_t hnd) const {
+    for (int i = 0; i < MAX_HANDLES; i++) {
+        if (handles[i] == hnd)
+            return true;
+    }
+    return false;
+}
+
+void CadenceTracker::Track::addUpdate(buffer_handle_t hnd, nsecs_t now) {
+    if (!owns(hnd)) {
+        handles[nextHandle] = hnd;
+        nextHandle = (nextHandle + 1) % MAX_HANDLES;
+    }
+    lastHandle = hnd;
+    cadence.Update(now);
+}
+
+CadenceTracker::CadenceTracker(int dpy) : mDpy(dpy), mNextId(0),
+        mTrackCount(0) {
+}
+
+int CadenceTracker::findTrack(const hwc_layer_1_t *layer) const {
+    buffer_handle_t hnd = layer->handle;
+    // Same BufferQueue buffer, same layer
+    if (hnd) {
+        for (int t = 0; t < mTrackCount; t++) {
+            if (!mPrevTracks[t].claimed && mPrevTracks[t].owns(hnd))
+                return t;
+        }
+    }
+    // New buffer or color layer, fall back to the geometry
+    for (int t = 0; t < mTrackCount; t++) {
+        const Track& track = mPrevTracks[t];
+        if (!track.claimed &&
+                isSameRect(track.displayFrame, layer->displayFrame) &&
+                (hnd == NULL) == (track.lastHandle == NULL))
+            return t;
+    }
+    return -1;
+}
+
+void CadenceTracker::update(hwc_display_contents_1_t *list,
+        int numAppLayers) {
+    nsecs_t now = systemTime();
+    int count = min(numAppLayers, MAX_NUM_APP_LAYERS);
+
+    memcpy(mPrevTracks, mTracks, sizeof(Track) * mTrackCount);
+    for (int i = 0; i < count; i++) {
+        hwc_layer_1_t *layer = &list->hwLayers[i];
+        Track& track = mTracks[i];
+        int prev = findTrack(layer);
+        if (prev >= 0) {
+            mPrevTracks[prev].claimed = true;
+            track = mPrevTracks[prev];
+            track.claimed = false;
+        } else {
+            track.reset(mNextId++, layer->displayFrame);
+        }
+        track.displayFrame = layer->displayFrame;
+        if (layer->handle && layer->handle != track.lastHandle)
+            track.addUpdate(layer->handle, now);
+    }
+    mTrackCount = count;
+}
+
+void CadenceTracker::dump(android::String8& buf) {
+    nsecs_t now = systemTime();
+    dumpsys_log(buf, "Layer cadence for Dpy %d (window %" PRId64 "ms):\n",
+            mDpy, ns2ms(qdutils::LayerCadence::kWindowNs));
+    dumpsys_log(buf, " listIdx | id   | rate(fps) | stddev(ms) | age(ms) | "
+            "updates\n");
+    for (int i = 0; i < mTrackCount; i++) {
+        const Track& track = mTracks[i];
+        nsecs_t age = track.cadence.GetAgeNs(now);
+        dumpsys_log(buf, " %7d | %4u | %9.1f | %10.2f | %7" PRId64 " | %"
+                PRIu64 "\n", i, track.id, track.cadence.GetRate(now),
+                track.cadence.GetJitterMs(now),
+                age < 0 ? (int64_t)-1 : ns2ms(age),
+                track.cadence.GetUpdateCount());
+    }
+}
+
+}; //namespace qhwc
@@ -0,0 +1,83 @@
+/*
+* Copyright (c) 2017 The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*    * Redistributions of source code must retain the above copyright
+*      notice, this list of conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above
+*      copyright notice, this list of conditions and the following
+*      disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation. nor the names of its
+*      contributors may be used to endorse or promote products derived
+*      from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef HWC_CADENCE_H
+#define HWC_CADENCE_H
+
+#include <utils/Timers.h>
+#include "hwc_utils.h"
+#include "layer_cadence.h"
+
+namespace qhwc {
+
+/* Tracks how often each app layer of a display gets a new buffer.
+ * HWC1 has no layer identity, so a layer is followed through the buffer
+ * handles of its BufferQueue: a handle seen before belongs to the same
+ * layer. A layer showing a new handle is matched by its display frame.
+ * The statistics of each layer are kept by qdutils::LayerCadence.
+ */
+class CadenceTracker {
+public:
+    explicit CadenceTracker(int dpy);
+    /* Records the buffer updates of the frame. Called from setListStats */
+    void update(hwc_display_contents_1_t *list, int numAppLayers);
+    void dump(android::String8& buf);
+
+private:
+    enum {
+        // BufferQueue slots remembered per layer
+        MAX_HANDLES = 4,
+    };
+
+    struct Track {
+        uint32_t id;
+        bool claimed;
+        buffer_handle_t handles[MAX_HANDLES];
+        int nextHandle;
+        buffer_handle_t lastHandle;
+        hwc_rect_t displayFrame;
+        qdutils::LayerCadence cadence;
+        void reset(uint32_t trackId, const hwc_rect_t& frame);
+        bool owns(buffer_handle_t hnd) const;
+        void addUpdate(buffer_handle_t hnd, nsecs_t now);
+    };
+
+    int findTrack(const hwc_layer_1_t *layer) const;
+
+    int mDpy;
+    uint32_t mNextId;
+    int mTrackCount;
+    Track mTracks[MAX_NUM_APP_LAYERS];
+    // Tracks of the previous frame while the current one is matched
+    Track mPrevTracks[MAX_NUM_APP_LAYERS];
+};
+
+}; //namespace qhwc
+
+#endif //HWC_CADENCE_H
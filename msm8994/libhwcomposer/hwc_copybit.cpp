@@ -28,6 +28,12 @@
 #include "cb_swap_rect.h"
 #include "math.h"
 #include "sync/sync.h"
+#include <linux/sw_sync.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <cutils/native_handle.h>
 
 using namespace qdutils;
 namespace qhwc {
@@ -222,22 +228,20 @@ bool CopyBit::prepareOverlap(hwc_context_t *ctx,
     }
     PtorInfo* ptorInfo = &(ctx->mPtorInfo);
 
+    // Pack the overlaps into one render buffer, stacked vertically.
     // Allocate render buffers if they're not allocated
     int alignW = 0, alignH = 0;
     int finalW = 0, finalH = 0;
     for (int i = 0; i < ptorInfo->count; i++) {
-        int ovlapIndex = ptorInfo->layerIndex[i];
-        hwc_rect_t overlap = list->hwLayers[ovlapIndex].displayFrame;
-        // render buffer width will be the max of two layers
+        hwc_rect_t overlap = ptorInfo->overlapRect[i];
+        // render buffer width will be the max of all overlaps
         // Align Widht and height to 32, Mdp would be configured
         // with Aligned overlap w/h
         finalW = max(finalW, ALIGN((overlap.right - overlap.left), 32));
+        // Calculate the dest top, left will always be zero
+        ptorInfo->displayFrame[i].left = 0;
+        ptorInfo->displayFrame[i].top = finalH;
         finalH += ALIGN((overlap.bottom - overlap.top), 32);
-        if(finalH > ALIGN((overlap.bottom - overlap.top), 32)) {
-            // Calculate the dest top, left will always be zero
-            ptorInfo->displayFrame[i].top = (finalH -
-                                (ALIGN((overlap.bottom - overlap.top), 32)));
-        }
         // calculate the right and bottom values
         ptorInfo->displayFrame[i].right =  ptorInfo->displayFrame[i].left +
                                             (overlap.right - overlap.left);
@@ -262,7 +266,20 @@ bool CopyBit::prepareOverlap(hwc_context_t *ctx,
 
     mAlignedWidth = alignW;
     mAlignedHeight = alignH;
-    mCurRenderBufferIndex = (mCurRenderBufferIndex + 1) % NUM_RENDER_BUFFERS;
+
+    // Keep scanning out the render buffer which already holds these overlaps
+    // if none of the contributing layers has been updated.
+    mOverlapRequest.update(ctx, list);
+    mOverlapReused = (mOverlapCache.renderBufferIndex >= 0) &&
+            mOverlapRequest.isSame(mOverlapCache);
+    if (mOverlapReused) {
+        mCurRenderBufferIndex = mOverlapCache.renderBufferIndex;
+    } else {
+        mCurRenderBufferIndex =
+                (mCurRenderBufferIndex + 1) % NUM_RENDER_BUFFERS;
+        if (mOverlapCache.renderBufferIndex == mCurRenderBufferIndex)
+            mOverlapCache.reset();
+    }
     return true;
 }
 
@@ -468,7 +485,7 @@ bool CopyBit::drawUsingAppBufferComposition(hwc_context_t *ctx,
           }
           for(int i = abcRenderBufIdx + 1; i < layerCount; i++){
              int retVal = drawLayerUsingCopybit(ctx,
-               &(list->hwLayers[i]),renderBuffer, 0);
+               &(list->hwLayers[i]),renderBuffer, 0, mDirtyLayerIndex != -1);
              if(retVal < 0) {
                 ALOGE("%s : Copybit failed", __FUNCTION__);
              }
@@ -497,6 +514,10 @@ bool  CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
        return false ;
     }
 
+    if(mAsyncDraw) {
+       return drawAsync(ctx, list, dpy, fd);
+    }
+
     if(drawUsingAppBufferComposition(ctx, list, dpy, fd)) {
        return true;
     }
@@ -566,7 +587,8 @@ bool  CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
             list->hwLayers[i].acquireFenceFd = -1;
         }
         retVal = drawLayerUsingCopybit(ctx, &(list->hwLayers[i]),
-                                          renderBuffer, !i);
+                                          renderBuffer, !i,
+                                          mDirtyLayerIndex != -1);
         copybitLayerCount++;
         if(retVal < 0) {
             ALOGE("%s : drawLayerUsingCopybit failed", __FUNCTION__);
@@ -587,6 +609,230 @@ bool  CopyBit::draw(hwc_context_t *ctx, hwc_display_contents_1_t *list,
     return true;
 }
 
+bool CopyBit::drawAsync(hwc_context_t *ctx, hwc_display_contents_1_t *list,
+                        int dpy, int *fd) {
+    LayerProp *layerProp = ctx->layerProp[dpy];
+    uint32_t last = (uint32_t)list->numHwLayers - 1;
+    hwc_layer_1_t *fbLayer = &list->hwLayers[last];
+
+    if (!fbLayer->handle) {
+        ALOGE("%s: Render buffer layer handle is NULL", __FUNCTION__);
+        return false;
+    }
+
+    // The previous frame must have handed its blits to the driver before
+    // the copybit device or the job can be touched again.
+    waitForDrawThread();
+
+    if(drawUsingAppBufferComposition(ctx, list, dpy, fd)) {
+       return true;
+    }
+
+    DrawJob& job = mDrawJob;
+    job.ctx = ctx;
+    job.renderBuffer =
+            (private_handle_t *)native_handle_clone(fbLayer->handle);
+    job.renderAcquireFd = (fbLayer->acquireFenceFd >= 0) ?
+            dup(fbLayer->acquireFenceFd) : -1;
+
+    mDirtyLayerIndex =  checkDirtyRect(ctx, list, dpy);
+    job.useDirtyRect = (mDirtyLayerIndex != -1);
+    job.clearRequired = false;
+    if( mDirtyLayerIndex != -1){
+          hwc_layer_1_t *layer = &list->hwLayers[mDirtyLayerIndex];
+#ifdef QCOM_BSP
+          job.clearRect = layer->dirtyRect;
+#else
+          job.clearRect = layer->displayFrame;
+#endif
+          job.clearRequired = true;
+    } else {
+          hwc_rect_t clearRegion = {0,0,0,0};
+          if(CBUtils::getuiClearRegion(list, clearRegion, layerProp)) {
+             job.clearRect = clearRegion;
+             job.clearRequired = true;
+          }
+    }
+
+    for (int i = 0; i <= (ctx->listStats[dpy].numAppLayers-1); i++) {
+        if(!(layerProp[i].mFlags & HWC_COPYBIT) || ctx->copybitDrop[i])
+            continue;
+        //skip non updating layers
+        if((mDirtyLayerIndex != -1) && (mDirtyLayerIndex != i) )
+            continue;
+        hwc_layer_1_t layer = list->hwLayers[i];
+        if (layer.handle)
+            layer.handle = native_handle_clone(layer.handle);
+        layer.acquireFenceFd = (layer.acquireFenceFd >= 0) ?
+                dup(layer.acquireFenceFd) : -1;
+        job.layers.push_back(layer);
+        job.isFG.push_back(!i);
+    }
+
+    // Own a copy of the visible regions, pointers into the vectors are
+    // only taken once they no longer grow.
+    job.visibleRects.resize(job.layers.size());
+    for (size_t i = 0; i < job.layers.size(); i++) {
+        hwc_region_t& region = job.layers[i].visibleRegionScreen;
+        job.visibleRects[i].assign(region.rects, region.rects + region.numRects);
+        region.rects = job.visibleRects[i].data();
+    }
+
+    struct sw_sync_create_fence_data fence;
+    memset(&fence, 0, sizeof(fence));
+    fence.value = mTimelineValue + 1;
+    snprintf(fence.name, sizeof(fence.name), "hwc_copybit");
+    if (ioctl(mTimelineFd, SW_SYNC_IOC_CREATE_FENCE, &fence) < 0) {
+        ALOGE("%s: sw_sync fence creation failed: %s, drawing inline",
+              __FUNCTION__, strerror(errno));
+        renderJob(job, fd);
+        job.release();
+        return true;
+    }
+    mTimelineValue++;
+
+    pthread_mutex_lock(&mDrawLock);
+    mDrawPending = true;
+    pthread_cond_signal(&mDrawCond);
+    pthread_mutex_unlock(&mDrawLock);
+
+    *fd = fence.fence;
+    return true;
+}
+
+int CopyBit::renderJob(DrawJob& job, int *fd) {
+    copybit_device_t *copybit = getCopyBitDevice();
+    int copybitLayerCount = 0;
+
+    if (!job.renderBuffer) {
+        ALOGE("%s: Render buffer layer handle is NULL", __FUNCTION__);
+        return -1;
+    }
+
+    if(job.renderAcquireFd >= 0)
+        copybit->set_sync(copybit, job.renderAcquireFd);
+
+    if(job.clearRequired)
+        clear(job.renderBuffer, job.clearRect);
+
+    for (size_t i = 0; i < job.layers.size(); i++) {
+        int retVal = drawLayerUsingCopybit(job.ctx, &job.layers[i],
+                                           job.renderBuffer, job.isFG[i],
+                                           job.useDirtyRect);
+        copybitLayerCount++;
+        if(retVal < 0) {
+            ALOGE("%s : drawLayerUsingCopybit failed", __FUNCTION__);
+        }
+    }
+
+    // Flush even without layers so the queued acquire fence is consumed
+    copybit->flush_get_fence(copybit, fd);
+    return copybitLayerCount;
+}
+
+CopyBit::DrawJob::DrawJob() : ctx(NULL), renderBuffer(NULL),
+        renderAcquireFd(-1), clearRequired(false), useDirtyRect(false) {
+    memset(&clearRect, 0, sizeof(clearRect));
+}
+
+void CopyBit::DrawJob::release() {
+    if (renderAcquireFd >= 0) {
+        close(renderAcquireFd);
+        renderAcquireFd = -1;
+    }
+    if (renderBuffer) {
+        native_handle_close((native_handle_t *)renderBuffer);
+        native_handle_delete((native_handle_t *)renderBuffer);
+        renderBuffer = NULL;
+    }
+    for (size_t i = 0; i < layers.size(); i++) {
+        if (layers[i].acquireFenceFd >= 0)
+            close(layers[i].acquireFenceFd);
+        if (layers[i].handle) {
+            native_handle_t *hnd = (native_handle_t *)layers[i].handle;
+            native_handle_close(hnd);
+            native_handle_delete(hnd);
+        }
+    }
+    layers.clear();
+    isFG.clear();
+    visibleRects.clear();
+}
+
+void *CopyBit::drawThreadLoop(void *param) {
+    CopyBit *copyBit = reinterpret_cast<CopyBit *>(param);
+    char thread_name[64] = "hwcCopybitThread";
+    prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
+    setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY);
+
+    while (true) {
+        pthread_mutex_lock(&copyBit->mDrawLock);
+        while (!copyBit->mDrawPending && !copyBit->mDrawThreadExit)
+            pthread_cond_wait(&copyBit->mDrawCond, &copyBit->mDrawLock);
+        if (!copyBit->mDrawPending) {
+            pthread_mutex_unlock(&copyBit->mDrawLock);
+            break;
+        }
+        pthread_mutex_unlock(&copyBit->mDrawLock);
+
+        int fd = -1;
+        copyBit->renderJob(copyBit->mDrawJob, &fd);
+        copyBit->mDrawJob.release();
+
+        // Blits are with the driver, let set() of the next frame proceed
+        pthread_mutex_lock(&copyBit->mDrawLock);
+        copyBit->mDrawPending = false;
+        pthread_cond_broadcast(&copyBit->mDrawCond);
+        pthread_mutex_unlock(&copyBit->mDrawLock);
+
+        if (fd >= 0) {
+            if (sync_wait(fd, 1000) < 0) {
+                ALOGE("%s: sync_wait error!! error no = %d err str = %s",
+                      __FUNCTION__, errno, strerror(errno));
+            }
+            close(fd);
+        }
+        // Always advance the timeline, MDP would stall on the commit
+        // otherwise
+        unsigned int count = 1;
+        if (ioctl(copyBit->mTimelineFd, SW_SYNC_IOC_INC, &count) < 0) {
+            ALOGE("%s: sw_sync timeline inc failed: %s", __FUNCTION__,
+                  strerror(errno));
+        }
+    }
+    return NULL;
+}
+
+bool CopyBit::initDrawThread() {
+    mTimelineFd = open("/dev/sw_sync", O_RDWR | O_CLOEXEC);
+    if (mTimelineFd < 0) {
+        ALOGI("%s: sw_sync not available (%s), copybit draws synchronously",
+              __FUNCTION__, strerror(errno));
+        return false;
+    }
+
+    pthread_mutex_init(&mDrawLock, NULL);
+    pthread_cond_init(&mDrawCond, NULL);
+    int ret = pthread_create(&mDrawThread, NULL, drawThreadLoop, this);
+    if (ret) {
+        ALOGE("%s: failed to create draw thread: %s", __FUNCTION__,
+              strerror(ret));
+        pthread_cond_destroy(&mDrawCond);
+        pthread_mutex_destroy(&mDrawLock);
+        close(mTimelineFd);
+        mTimelineFd = -1;
+        return false;
+    }
+    return true;
+}
+
+void CopyBit::waitForDrawThread() {
+    pthread_mutex_lock(&mDrawLock);
+    while (mDrawPending)
+        pthread_cond_wait(&mDrawCond, &mDrawLock);
+    pthread_mutex_unlock(&mDrawLock);
+}
+
 int CopyBit::drawOverlap(hwc_context_t *ctx, hwc_display_contents_1_t *list) {
     int fd = -1;
     PtorInfo* ptorInfo = &(ctx->mPtorInfo);
@@ -603,6 +849,31 @@ int CopyBit::drawOverlap(hwc_context_t *ctx, hwc_display_contents_1_t *list) {
         return fd;
     }
 
+    int pixelCount = 0;
+    for(int j = 0; j < ptorInfo->count; j++) {
+        hwc_rect_t overlap = ptorInfo->overlapRect[j];
+        pixelCount += (overlap.right - overlap.left) *
+                (overlap.bottom - overlap.top);
+    }
+
+    if (mOverlapReused) {
+        // Render buffer already holds this frame's overlaps
+        mOverlapStats.framesReused++;
+        mOverlapStats.pixelsReused += (uint64_t)pixelCount;
+        ALOGD_IF(DEBUG_COPYBIT, "%s: reusing render buffer %d", __FUNCTION__,
+                 mCurRenderBufferIndex);
+        return fd;
+    }
+
+    //Wait for the previous frame to complete before rendering onto it
+    if(mRelFd[mCurRenderBufferIndex] >= 0) {
+        sync_wait(mRelFd[mCurRenderBufferIndex], 1000);
+        close(mRelFd[mCurRenderBufferIndex]);
+        mRelFd[mCurRenderBufferIndex] = -1;
+    }
+
+    nsecs_t startTime = systemTime();
+
     //Clear the transparent or left out region on the render buffer
     hwc_rect_t clearRegion = {0,0,0,0};
     LayerProp *layerProp = ctx->layerProp[0];
@@ -610,24 +881,11 @@ int CopyBit::drawOverlap(hwc_context_t *ctx, hwc_display_contents_1_t *list) {
         clear(renderBuffer, clearRegion);
 
     int copybitLayerCount = 0;
+    bool failed = false;
     for(int j = 0; j < ptorInfo->count; j++) {
         int ovlapIndex = ptorInfo->layerIndex[j];
-        hwc_rect_t overlap = list->hwLayers[ovlapIndex].displayFrame;
-        if(j) {
-            /**
-             * It's possible that 2 PTOR layers might have overlapping.
-             * In such case, remove the intersection(again if peripheral)
-             * from the lower PTOR layer to avoid overlapping.
-             * If intersection is not on peripheral then compromise
-             * by reducing number of PTOR layers.
-             **/
-            int prevOvlapIndex = ptorInfo->layerIndex[0];
-            hwc_rect_t prevOvlap = list->hwLayers[prevOvlapIndex].displayFrame;
-            hwc_rect_t commonRect = getIntersection(prevOvlap, overlap);
-            if(isValidRect(commonRect)) {
-                overlap = deductRect(overlap, commonRect);
-            }
-        }
+        // Area shared with a higher PTOR layer has already been removed
+        hwc_rect_t overlap = ptorInfo->overlapRect[j];
 
         // Draw overlapped content of layers on render buffer
         for (int i = 0; i <= ovlapIndex; i++) {
@@ -670,6 +928,7 @@ int CopyBit::drawOverlap(hwc_context_t *ctx, hwc_display_contents_1_t *list) {
             if(retVal < 0) {
                 ALOGE("%s: drawRectUsingCopybit failed", __FUNCTION__);
                 copybitLayerCount = 0;
+                failed = true;
             }
         }
     }
@@ -679,6 +938,16 @@ int CopyBit::drawOverlap(hwc_context_t *ctx, hwc_display_contents_1_t *list) {
         copybit->flush_get_fence(copybit, &fd);
     }
 
+    if (!failed && fd >= 0) {
+        mOverlapCache = mOverlapRequest;
+        mOverlapCache.renderBufferIndex = mCurRenderBufferIndex;
+    } else {
+        mOverlapCache.reset();
+    }
+    mOverlapStats.framesDrawn++;
+    mOverlapStats.pixelsDrawn += (uint64_t)pixelCount;
+    mOverlapStats.drawTime += systemTime() - startTime;
+
     ALOGD_IF(DEBUG_COPYBIT, "%s: done! copybitLayerCount = %d", __FUNCTION__,
              copybitLayerCount);
     return fd;
@@ -770,7 +1039,8 @@ int CopyBit::drawRectUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
 }
 
 int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
-                          private_handle_t *renderBuffer, bool isFG)
+                          private_handle_t *renderBuffer, bool isFG,
+                          bool useDirtyRect)
 {
     hwc_context_t* ctx = (hwc_context_t*)(dev);
     int err = 0, acquireFd;
@@ -851,7 +1121,7 @@ int  CopyBit::drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
                               displayFrame.bottom};
 #ifdef QCOM_BSP
     //change src and dst with dirtyRect
-    if(mDirtyLayerIndex != -1) {
+    if(useDirtyRect) {
       srcRect.l = layer->dirtyRect.left;
       srcRect.t = layer->dirtyRect.top;
       srcRect.r = layer->dirtyRect.right;
@@ -1127,6 +1397,7 @@ void CopyBit::freeRenderBuffers()
             mRenderBuffer[i] = NULL;
         }
     }
+    mOverlapCache.reset();
 }
 
 private_handle_t * CopyBit::getCurrentRenderBuffer() {
@@ -1140,12 +1411,16 @@ void CopyBit::setReleaseFd(int fd) {
 }
 
 void CopyBit::setReleaseFdSync(int fd) {
+    // When the overlaps are reused the buffer is still being scanned out
+    // for the previous frame, so waiting here would stall a full vsync.
     if (mRelFd[mCurRenderBufferIndex] >=0) {
-        int ret = -1;
-        ret = sync_wait(mRelFd[mCurRenderBufferIndex], 1000);
-        if (ret < 0)
-            ALOGE("%s: sync_wait error! errno = %d, err str = %s",
-                  __FUNCTION__, errno, strerror(errno));
+        if (!mOverlapReused) {
+            int ret = -1;
+            ret = sync_wait(mRelFd[mCurRenderBufferIndex], 1000);
+            if (ret < 0)
+                ALOGE("%s: sync_wait error! errno = %d, err str = %s",
+                      __FUNCTION__, errno, strerror(errno));
+        }
         close(mRelFd[mCurRenderBufferIndex]);
     }
     mRelFd[mCurRenderBufferIndex] = dup(fd);
@@ -1156,7 +1431,11 @@ struct copybit_device_t* CopyBit::getCopyBitDevice() {
 }
 
 CopyBit::CopyBit(hwc_context_t *ctx, const int& dpy) :  mEngine(0),
-    mIsModeOn(false), mCopyBitDraw(false), mCurRenderBufferIndex(0) {
+    mIsModeOn(false), mCopyBitDraw(false), mCurRenderBufferIndex(0),
+    mOverlapReused(false), mAsyncDraw(false), mDrawPending(false),
+    mDrawThreadExit(false), mTimelineFd(-1), mTimelineValue(0) {
+
+    memset(&mOverlapStats, 0, sizeof(mOverlapStats));
 
     getBufferSizeAndDimensions(ctx->dpyAttr[dpy].xres,
             ctx->dpyAttr[dpy].yres,
@@ -1184,10 +1463,29 @@ CopyBit::CopyBit(hwc_context_t *ctx, const int& dpy) :  mEngine(0),
     } else {
         ALOGE("FATAL ERROR: copybit hw module not found");
     }
+
+    // Only MDP3 composes the framebuffer target with copybit
+    property_get("debug.hwc.copybit.async", value, "1");
+    if (mEngine && atoi(value) &&
+            (ctx->mMDP.version == qdutils::MDP_V3_0_4 ||
+             ctx->mMDP.version == qdutils::MDP_V3_0_5)) {
+        mAsyncDraw = initDrawThread();
+    }
 }
 
 CopyBit::~CopyBit()
 {
+    if (mAsyncDraw) {
+        pthread_mutex_lock(&mDrawLock);
+        mDrawThreadExit = true;
+        pthread_cond_broadcast(&mDrawCond);
+        pthread_mutex_unlock(&mDrawLock);
+        pthread_join(mDrawThread, NULL);
+        pthread_cond_destroy(&mDrawCond);
+        pthread_mutex_destroy(&mDrawLock);
+        close(mTimelineFd);
+        mTimelineFd = -1;
+    }
     freeRenderBuffers();
     if(mEngine)
     {
@@ -1211,6 +1509,54 @@ void CopyBit::LayerCache::updateCounts(hwc_context_t *ctx,
    }
 }
 
+CopyBit::OverlapCache::OverlapCache() {
+    reset();
+}
+void CopyBit::OverlapCache::reset() {
+    renderBufferIndex = -1;
+    count = 0;
+    sourceCount = 0;
+}
+void CopyBit::OverlapCache::update(hwc_context_t *ctx,
+              hwc_display_contents_1_t *list)
+{
+    PtorInfo* ptorInfo = &(ctx->mPtorInfo);
+    renderBufferIndex = -1;
+    count = ptorInfo->count;
+    sourceCount = 0;
+    for (int j = 0; j < count; j++) {
+        overlapRect[j] = ptorInfo->overlapRect[j];
+        displayFrame[j] = ptorInfo->displayFrame[j];
+        for (int i = 0; i <= ptorInfo->layerIndex[j]; i++) {
+            hwc_layer_1_t *layer = &list->hwLayers[i];
+            if(!isValidRect(getIntersection(layer->displayFrame,
+                                            overlapRect[j])))
+                continue;
+            Source& src = sources[sourceCount++];
+            memset(&src, 0, sizeof(src));
+            src.overlapIndex = j;
+            src.hnd = layer->handle;
+            src.flags = layer->flags;
+            src.displayFrame = layer->displayFrame;
+            src.sourceCrop = integerizeSourceCrop(layer->sourceCropf);
+            src.blending = layer->blending;
+            src.planeAlpha = layer->planeAlpha;
+            src.transform = layer->transform;
+        }
+    }
+}
+bool CopyBit::OverlapCache::isSame(const OverlapCache& other) const {
+    if (count != other.count || sourceCount != other.sourceCount)
+        return false;
+    for (int j = 0; j < count; j++) {
+        if (!(overlapRect[j] == other.overlapRect[j]) ||
+                !(displayFrame[j] == other.displayFrame[j]))
+            return false;
+    }
+    return !memcmp(sources, other.sources,
+                   sourceCount * sizeof(sources[0]));
+}
+
 CopyBit::FbCache::FbCache() {
      reset();
 }
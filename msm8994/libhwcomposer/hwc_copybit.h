@@ -19,6 +19,9 @@
  */
 #ifndef HWC_COPYBIT_H
 #define HWC_COPYBIT_H
+#include <pthread.h>
+#include <utils/Timers.h>
+#include <vector>
 #include "hwc_utils.h"
 
 #define NUM_RENDER_BUFFERS 3
@@ -55,6 +58,16 @@ public:
 
     int drawOverlap(hwc_context_t *ctx, hwc_display_contents_1_t *list);
 
+    /* overlap render statistics, reported in the MDPComp dump */
+    struct OverlapStats {
+      uint64_t framesDrawn;
+      uint64_t framesReused;
+      uint64_t pixelsDrawn;
+      uint64_t pixelsReused;
+      nsecs_t drawTime;
+    };
+    const OverlapStats& getOverlapStats() const { return mOverlapStats; }
+
 private:
     /* cached data */
     struct LayerCache {
@@ -67,6 +80,33 @@ private:
       void updateCounts(hwc_context_t *ctx, hwc_display_contents_1_t *list,
               int dpy);
     };
+    /* Sources of the PTOR overlaps rendered into a render buffer. The
+     * rendered overlaps are reused as long as every layer contributing to
+     * them keeps its buffer and geometry. */
+    struct OverlapCache {
+      struct Source {
+        int overlapIndex;
+        buffer_handle_t hnd;
+        uint32_t flags;
+        hwc_rect_t displayFrame;
+        hwc_rect_t sourceCrop;
+        int32_t blending;
+        uint8_t planeAlpha;
+        uint32_t transform;
+      };
+      int renderBufferIndex;
+      int count;
+      hwc_rect_t overlapRect[MAX_PTOR_LAYERS];
+      hwc_rect_t displayFrame[MAX_PTOR_LAYERS];
+      int sourceCount;
+      Source sources[MAX_PTOR_LAYERS * MAX_NUM_APP_LAYERS];
+      /* c'tor */
+      OverlapCache();
+      /* clear caching info*/
+      void reset();
+      void update(hwc_context_t *ctx, hwc_display_contents_1_t *list);
+      bool isSame(const OverlapCache& other) const;
+    };
     /* framebuffer cache*/
     struct FbCache {
       hwc_rect_t  FbdirtyRect[NUM_RENDER_BUFFERS];
@@ -77,14 +117,40 @@ private:
       int getUnchangedFbDRCount(hwc_rect_t dirtyRect);
     };
 
+    /* Copybit composition of one frame, snapshotted from the layer list so
+     * that it can be rendered on the draw thread after set() returns. Buffer
+     * handles are cloned and fences dup'ed as the list is owned by
+     * SurfaceFlinger. */
+    struct DrawJob {
+      hwc_context_t *ctx;
+      private_handle_t *renderBuffer;
+      int renderAcquireFd;
+      bool clearRequired;
+      hwc_rect_t clearRect;
+      bool useDirtyRect;
+      std::vector<hwc_layer_1_t> layers;
+      std::vector<bool> isFG;
+      std::vector<std::vector<hwc_rect_t> > visibleRects;
+      DrawJob();
+      /* close the fences and free the cloned handles */
+      void release();
+    };
+
     // holds the copybit device
     struct copybit_device_t *mEngine;
+    bool drawAsync(hwc_context_t *ctx, hwc_display_contents_1_t *list,
+                   int dpy, int *fd);
+    int renderJob(DrawJob& job, int *fd);
+    bool initDrawThread();
+    void waitForDrawThread();
+    static void *drawThreadLoop(void *param);
     bool drawUsingAppBufferComposition(hwc_context_t *ctx,
                                 hwc_display_contents_1_t *list,
                                 int dpy, int *fd);
     // Helper functions for copybit composition
     int  drawLayerUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
-                          private_handle_t *renderBuffer, bool isFG);
+                          private_handle_t *renderBuffer, bool isFG,
+                          bool useDirtyRect);
     // Helper function to draw copybit layer for PTOR comp
     int drawRectUsingCopybit(hwc_context_t *dev, hwc_layer_1_t *layer,
                           private_handle_t *renderBuffer, hwc_rect_t overlap,
@@ -129,6 +195,27 @@ private:
     int mDirtyLayerIndex;
     LayerCache mLayerCache;
     FbCache mFbCache;
+    // Overlaps held by mRenderBuffer[mOverlapCache.renderBufferIndex]
+    OverlapCache mOverlapCache;
+    // Overlaps requested for the current frame
+    OverlapCache mOverlapRequest;
+    // Current frame reuses the overlaps already in the render buffer
+    bool mOverlapReused;
+    OverlapStats mOverlapStats;
+
+    // MDP3 renders the framebuffer target on mDrawThread, overlapping the
+    // blits with the MDP commit. The commit waits on a fence of mTimelineFd
+    // which the draw thread signals once the blits have completed.
+    bool mAsyncDraw;
+    pthread_t mDrawThread;
+    pthread_mutex_t mDrawLock;
+    pthread_cond_t mDrawCond;
+    // A job is queued or its blits have not been submitted yet
+    bool mDrawPending;
+    bool mDrawThreadExit;
+    DrawJob mDrawJob;
+    int mTimelineFd;
+    unsigned int mTimelineValue;
     int getLayersChanging(hwc_context_t *ctx, hwc_display_contents_1_t *list,
                   int dpy);
     int checkDirtyRect(hwc_context_t *ctx, hwc_display_contents_1_t *list,
@@ -17,6 +17,7 @@
  */
 
 #include <math.h>
+#include <inttypes.h>
 #include "hwc_mdpcomp.h"
 #include <sys/ioctl.h>
 #include <dlfcn.h>
@@ -39,11 +40,14 @@ namespace qhwc {
 //==============MDPComp========================================================
 
 IdleInvalidator *MDPComp::sIdleInvalidator = NULL;
+uint64_t MDPComp::sPtorAttempts = 0;
+uint64_t MDPComp::sPtorSuccesses = 0;
 bool MDPComp::sIdleFallBack = false;
 bool MDPComp::sHandleTimeout = false;
 bool MDPComp::sDebugLogs = false;
 bool MDPComp::sEnabled = false;
 bool MDPComp::sEnableMixedMode = true;
+bool MDPComp::sSecurePlaybackPin = true;
 int MDPComp::sSimulationFlags = 0;
 int MDPComp::sMaxPipesPerMixer = 0;
 bool MDPComp::sEnableYUVsplit = false;
@@ -112,6 +116,31 @@ void MDPComp::dump(android::String8& buf, hwc_context_t *ctx)
                     (mCurrentFrame.needsRedraw ? "GLES" : "CACHE")) : "MDP"),
                     (mCurrentFrame.isFBComposed[index] ? mCurrentFrame.fbZ :
     mCurrentFrame.mdpToLayer[mCurrentFrame.layerToMDP[index]].pipeInfo->zOrder));
+    if(!mDpy && ctx->mCopyBit[mDpy] && sPtorAttempts) {
+        const CopyBit::OverlapStats& stats =
+                ctx->mCopyBit[mDpy]->getOverlapStats();
+        // Estimate the time saved by reuse from the measured render cost
+        nsecs_t savedTime = stats.pixelsDrawn ?
+                (nsecs_t)((double)stats.drawTime * (double)stats.pixelsReused /
+                (double)stats.pixelsDrawn) : 0;
+        dumpsys_log(buf, "PTOR: attempts:%" PRIu64 " success:%" PRIu64
+                " (%" PRIu64 "%%) rendered:%" PRIu64 " reused:%" PRIu64
+                " renderTime:%" PRId64 "us savedTime:%" PRId64 "us \n",
+                sPtorAttempts, sPtorSuccesses,
+                sPtorSuccesses * 100 / sPtorAttempts, stats.framesDrawn,
+                stats.framesReused, ns2us(stats.drawTime), ns2us(savedTime));
+    }
+    const SecurePlayback& pinned = mSecurePlayback;
+    if(pinned.reusedFrames || pinned.evaluatedFrames) {
+        dumpsys_log(buf, "SecurePlayback: pinned:%3s reused:%" PRIu64
+                " (avg %" PRId64 "us) evaluated:%" PRIu64 " (avg %" PRId64
+                "us) \n", (pinned.valid ? "YES" : "NO"), pinned.reusedFrames,
+                pinned.reusedFrames ?
+                ns2us(pinned.reuseTime / (nsecs_t)pinned.reusedFrames) : 0,
+                pinned.evaluatedFrames, pinned.evaluatedFrames ?
+                ns2us(pinned.evaluateTime / (nsecs_t)pinned.evaluatedFrames) :
+                0);
+    }
     dumpsys_log(buf,"\n");
 }
 
@@ -139,6 +168,13 @@ bool MDPComp::init(hwc_context_t *ctx) {
         sEnableMixedMode = false;
     }
 
+    sSecurePlaybackPin = true;
+    if((property_get("debug.mdpcomp.securepin.disable", property, NULL) > 0) &&
+       (!strncmp(property, "1", PROPERTY_VALUE_MAX ) ||
+        (!strncasecmp(property,"true", PROPERTY_VALUE_MAX )))) {
+        sSecurePlaybackPin = false;
+    }
+
     qdutils::MDPVersion &mdpVersion = qdutils::MDPVersion::getInstance();
 
     sMaxPipesPerMixer = (int)mdpVersion.getBlendStages();
@@ -934,93 +970,138 @@ bool MDPComp::fullMDPCompWithPTOR(hwc_context_t *ctx,
      1. A below layer needs scaling.
      2. Overlap is not peripheral to display.
      3. Overlap or a below layer has 90 degree transform.
-     4. Overlap area > (1/3 * FrameBuffer) area, based on Perf inputs.
+     4. Pixels to render for the overlaps > (1/3 * FrameBuffer) area,
+        based on Perf inputs.
      */
 
-    int minLayerIndex[MAX_PTOR_LAYERS] = { -1, -1};
-    hwc_rect_t overlapRect[MAX_PTOR_LAYERS];
-    memset(overlapRect, 0, sizeof(overlapRect));
-    int layerPixelCount, minPixelCount = 0;
-    int numPTORLayersFound = 0;
-    for (int i = numAppLayers-1; (i >= 0 &&
-                                  numPTORLayersFound < MAX_PTOR_LAYERS); i--) {
+    struct PtorCandidate {
+        int layerIndex;
+        int cost;
+    };
+    PtorCandidate candidates[MAX_NUM_APP_LAYERS];
+    int numCandidates = 0;
+    for (int i = numAppLayers-1; i >= 0; i--) {
         hwc_layer_1_t* layer = &list->hwLayers[i];
-        hwc_rect_t crop = integerizeSourceCrop(layer->sourceCropf);
         hwc_rect_t dispFrame = layer->displayFrame;
-        layerPixelCount = (crop.right - crop.left) * (crop.bottom - crop.top);
         // PTOR layer should be peripheral and cannot have transform
         if (!isPeripheral(dispFrame, ctx->mViewFrame[mDpy]) ||
                                 has90Transform(layer)) {
             continue;
         }
-        if((3 * (layerPixelCount + minPixelCount)) >
-                ((int)ctx->dpyAttr[mDpy].xres * (int)ctx->dpyAttr[mDpy].yres)) {
-            // Overlap area > (1/3 * FrameBuffer) area, based on Perf inputs.
-            continue;
-        }
         bool found = false;
+        // Copybit cost of an overlap is the number of pixels it blits: the
+        // overlap itself plus every layer below intersecting it.
+        int cost = (dispFrame.right - dispFrame.left) *
+                (dispFrame.bottom - dispFrame.top);
         for (int j = i-1; j >= 0; j--) {
             // Check if the layers below this layer qualifies for PTOR comp
             hwc_layer_1_t* layer = &list->hwLayers[j];
             hwc_rect_t disFrame = layer->displayFrame;
+            hwc_rect_t isect = getIntersection(dispFrame, disFrame);
             // Layer below PTOR is intersecting and has 90 degree transform or
             // needs scaling cannot be supported.
-            if (isValidRect(getIntersection(dispFrame, disFrame))) {
+            if (isValidRect(isect)) {
                 if (has90Transform(layer) || needsScaling(layer)) {
                     found = false;
                     break;
                 }
                 found = true;
+                cost += (isect.right - isect.left) * (isect.bottom - isect.top);
             }
         }
-        // Store the minLayer Index
         if(found) {
-            minLayerIndex[numPTORLayersFound] = i;
-            overlapRect[numPTORLayersFound] = list->hwLayers[i].displayFrame;
-            minPixelCount += layerPixelCount;
-            numPTORLayersFound++;
+            candidates[numCandidates].layerIndex = i;
+            candidates[numCandidates].cost = cost;
+            numCandidates++;
         }
     }
 
     // No overlap layers
-    if (!numPTORLayersFound)
+    if (!numCandidates)
         return false;
 
-    // Store the displayFrame and the sourceCrops of the layers
-    hwc_rect_t displayFrame[numAppLayers];
-    hwc_rect_t sourceCrop[numAppLayers];
-    for(int i = 0; i < numAppLayers; i++) {
-        hwc_layer_1_t* layer = &list->hwLayers[i];
-        displayFrame[i] = layer->displayFrame;
-        sourceCrop[i] = integerizeSourceCrop(layer->sourceCropf);
+    // Pick the cheapest overlaps first until the copybit budget or the
+    // render buffer slots run out; the others stay on pipes as they are.
+    const int budget = ((int)ctx->dpyAttr[mDpy].xres *
+            (int)ctx->dpyAttr[mDpy].yres) / 3;
+    bool selected[MAX_NUM_APP_LAYERS];
+    memset(selected, 0, sizeof(selected));
+    int totalCost = 0, numSelected = 0;
+    while (numSelected < MAX_PTOR_LAYERS) {
+        int best = -1;
+        for (int c = 0; c < numCandidates; c++) {
+            if (!selected[c] && (totalCost + candidates[c].cost) <= budget &&
+                    (best < 0 || candidates[c].cost < candidates[best].cost))
+                best = c;
+        }
+        if (best < 0)
+            break;
+        selected[best] = true;
+        totalCost += candidates[best].cost;
+        numSelected++;
     }
 
     /**
-     * It's possible that 2 PTOR layers might have overlapping.
+     * It's possible that PTOR layers might have overlapping.
      * In such case, remove the intersection(again if peripheral)
      * from the lower PTOR layer to avoid overlapping.
      * If intersection is not on peripheral then compromise
      * by reducing number of PTOR layers.
+     * Candidates are in top to bottom order.
      **/
-    hwc_rect_t commonRect = getIntersection(overlapRect[0], overlapRect[1]);
-    if(isValidRect(commonRect)) {
-        overlapRect[1] = deductRect(overlapRect[1], commonRect);
-        list->hwLayers[minLayerIndex[1]].displayFrame = overlapRect[1];
+    int minLayerIndex[MAX_PTOR_LAYERS];
+    hwc_rect_t overlapRect[MAX_PTOR_LAYERS];
+    int numPTORLayersFound = 0;
+    for (int c = 0; c < numCandidates; c++) {
+        if (!selected[c])
+            continue;
+        int index = candidates[c].layerIndex;
+        hwc_rect_t rect = list->hwLayers[index].displayFrame;
+        bool valid = true;
+        for (int k = 0; k < numPTORLayersFound && valid; k++) {
+            hwc_rect_t commonRect = getIntersection(overlapRect[k], rect);
+            if(isValidRect(commonRect)) {
+                rect = deductRect(rect, commonRect);
+                valid = isValidRect(rect) &&
+                        !isValidRect(getIntersection(overlapRect[k], rect));
+            }
+        }
+        if (valid) {
+            minLayerIndex[numPTORLayersFound] = index;
+            overlapRect[numPTORLayersFound] = rect;
+            numPTORLayersFound++;
+        }
+    }
+
+    if (!numPTORLayersFound)
+        return false;
+
+    // Store the displayFrame and the sourceCrops of the layers
+    hwc_rect_t displayFrame[numAppLayers];
+    hwc_rect_t sourceCrop[numAppLayers];
+    for(int i = 0; i < numAppLayers; i++) {
+        hwc_layer_1_t* layer = &list->hwLayers[i];
+        displayFrame[i] = layer->displayFrame;
+        sourceCrop[i] = integerizeSourceCrop(layer->sourceCropf);
     }
 
+    memset(&(ctx->mPtorInfo), 0, sizeof(ctx->mPtorInfo));
     ctx->mPtorInfo.count = numPTORLayersFound;
-    for(int i = 0; i < MAX_PTOR_LAYERS; i++) {
+    for(int i = 0; i < numPTORLayersFound; i++) {
         ctx->mPtorInfo.layerIndex[i] = minLayerIndex[i];
+        ctx->mPtorInfo.overlapRect[i] = overlapRect[i];
+        list->hwLayers[minLayerIndex[i]].displayFrame = overlapRect[i];
     }
 
+    sPtorAttempts++;
     if (!ctx->mCopyBit[mDpy]->prepareOverlap(ctx, list)) {
         // reset PTOR
         ctx->mPtorInfo.count = 0;
-        if(isValidRect(commonRect)) {
-            // If PTORs are intersecting restore displayframe of PTOR[1]
-            // before returning, as we have modified it above.
-            list->hwLayers[minLayerIndex[1]].displayFrame =
-                    displayFrame[minLayerIndex[1]];
+        // Restore displayframe of PTOR layers before returning, as we may
+        // have modified them above.
+        for(int i = 0; i < numPTORLayersFound; i++) {
+            list->hwLayers[minLayerIndex[i]].displayFrame =
+                    displayFrame[minLayerIndex[i]];
         }
         return false;
     }
@@ -1121,8 +1202,9 @@ bool MDPComp::fullMDPCompWithPTOR(hwc_context_t *ctx,
         ctx->mPtorInfo.count = 0;
         reset(ctx);
     } else {
-        ALOGD_IF(isDebug(), "%s: PTOR Indexes: %d and %d", __FUNCTION__,
-                 ctx->mPtorInfo.layerIndex[0],  ctx->mPtorInfo.layerIndex[1]);
+        sPtorSuccesses++;
+        ALOGD_IF(isDebug(), "%s: PTOR count: %d top index: %d", __FUNCTION__,
+                 ctx->mPtorInfo.count, ctx->mPtorInfo.layerIndex[0]);
     }
 
     ALOGD_IF(isDebug(), "%s: Postheuristics %s!", __FUNCTION__,
@@ -1453,6 +1535,89 @@ bool MDPComp::mdpOnlyLayersComp(hwc_context_t *ctx,
     return true;
 }
 
+/* Protected playback of one secure video layer with a few UI layers on top.
+ * The composition picked for such a stack holds until its geometry changes,
+ * so it is pinned instead of running the strategies on every frame. */
+bool MDPComp::isSecurePlayback(hwc_context_t *ctx,
+        hwc_display_contents_1_t* list) {
+    if(!sSecurePlaybackPin || sSimulationFlags || sIdleFallBack)
+        return false;
+
+    const int numAppLayers = ctx->listStats[mDpy].numAppLayers;
+    if(ctx->listStats[mDpy].yuvCount != 1 || numAppLayers > sMaxPipesPerMixer)
+        return false;
+
+    hwc_layer_1_t* layer = &list->hwLayers[ctx->listStats[mDpy].yuvIndices[0]];
+    if(!isSecureBuffer((private_handle_t *)layer->handle) ||
+            isSecuring(ctx, layer))
+        return false;
+
+    return !(isSkipPresent(ctx, mDpy) || ctx->listStats[mDpy].secureUI ||
+            ctx->listStats[mDpy].mAIVVideoMode || mCurrentFrame.dropCount ||
+            isSecondaryConfiguring(ctx) || ctx->isPaddingRound);
+}
+
+bool MDPComp::trySecurePlayback(hwc_context_t *ctx,
+        hwc_display_contents_1_t* list) {
+    SecurePlayback& pinned = mSecurePlayback;
+    const int numAppLayers = ctx->listStats[mDpy].numAppLayers;
+    const int yuvIndex = ctx->listStats[mDpy].yuvIndices[0];
+    hwc_layer_1_t* layer = &list->hwLayers[yuvIndex];
+
+    if(!pinned.valid || (list->flags & HWC_GEOMETRY_CHANGED) ||
+            pinned.layerCount != numAppLayers ||
+            pinned.yuvIndex != yuvIndex ||
+            pinned.transform != layer->transform ||
+            !isSameRect(pinned.displayFrame, layer->displayFrame) ||
+            !isSameRect(pinned.sourceCrop,
+                    integerizeSourceCrop(layer->sourceCropf))) {
+        return false;
+    }
+
+    mCurrentFrame.reset(numAppLayers);
+    memcpy(&mCurrentFrame.isFBComposed, &pinned.isFBComposed,
+            sizeof(mCurrentFrame.isFBComposed));
+    mCurrentFrame.fbCount = pinned.fbCount;
+    mCurrentFrame.mdpCount = pinned.mdpCount;
+    mCurrentFrame.fbZ = pinned.fbZ;
+
+    // Pipes and rotator sessions get reassigned from the previous round,
+    // so only the overlay configuration is validated again
+    if(!postHeuristicsHandling(ctx, list)) {
+        ALOGD_IF(isDebug(), "%s: pinned composition failed", __FUNCTION__);
+        pinned.valid = false;
+        reset(ctx);
+        return false;
+    }
+
+    ALOGD_IF(isDebug(), "%s: reusing pinned composition dpy %d", __FUNCTION__,
+            mDpy);
+    return true;
+}
+
+void MDPComp::pinSecurePlayback(hwc_context_t *ctx,
+        hwc_display_contents_1_t* list) {
+    // PTOR depends on the content of each frame
+    if(!mDpy && ctx->mPtorInfo.isActive())
+        return;
+
+    SecurePlayback& pinned = mSecurePlayback;
+    const int yuvIndex = ctx->listStats[mDpy].yuvIndices[0];
+    hwc_layer_1_t* layer = &list->hwLayers[yuvIndex];
+
+    pinned.valid = true;
+    pinned.layerCount = mCurrentFrame.layerCount;
+    pinned.yuvIndex = yuvIndex;
+    pinned.displayFrame = layer->displayFrame;
+    pinned.sourceCrop = integerizeSourceCrop(layer->sourceCropf);
+    pinned.transform = layer->transform;
+    memcpy(&pinned.isFBComposed, &mCurrentFrame.isFBComposed,
+            sizeof(pinned.isFBComposed));
+    pinned.fbCount = mCurrentFrame.fbCount;
+    pinned.mdpCount = mCurrentFrame.mdpCount;
+    pinned.fbZ = mCurrentFrame.fbZ;
+}
+
 /* Checks for conditions where YUV layers cannot be bypassed */
 bool MDPComp::isYUVDoable(hwc_context_t* ctx, hwc_layer_1_t* layer) {
     if(isSkipLayer(layer)) {
@@ -2054,10 +2219,25 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_display_contents_1_t* list) {
             dropNonAIVLayers(ctx, list);
         }
 
-        // if tryFullFrame fails, try to push all video and secure RGB layers
-        // to MDP for composition.
-        mModeOn = tryFullFrame(ctx, list) || tryMDPOnlyLayers(ctx, list) ||
-                  tryVideoOnly(ctx, list);
+        const bool securePlayback = isSecurePlayback(ctx, list);
+        const nsecs_t startTime = securePlayback ? systemTime() : 0;
+        mModeOn = securePlayback && trySecurePlayback(ctx, list);
+        if(mModeOn) {
+            mSecurePlayback.reusedFrames++;
+            mSecurePlayback.reuseTime += systemTime() - startTime;
+        } else {
+            // if tryFullFrame fails, try to push all video and secure RGB
+            // layers to MDP for composition.
+            mModeOn = tryFullFrame(ctx, list) || tryMDPOnlyLayers(ctx, list) ||
+                      tryVideoOnly(ctx, list);
+            mSecurePlayback.valid = false;
+            if(securePlayback) {
+                if(mModeOn)
+                    pinSecurePlayback(ctx, list);
+                mSecurePlayback.evaluatedFrames++;
+                mSecurePlayback.evaluateTime += systemTime() - startTime;
+            }
+        }
         if(mModeOn) {
             setMDPCompLayerFlags(ctx, list);
         } else {
@@ -2079,6 +2259,7 @@ int MDPComp::prepare(hwc_context_t *ctx, hwc_display_contents_1_t* list) {
         }
         ALOGD_IF( isDebug(),"%s: MDP Comp not possible for this frame",
                 __FUNCTION__);
+        mSecurePlayback.valid = false;
         ret = -1;
     }
 
@@ -140,6 +140,29 @@ protected:
                          hwc_display_contents_1_t* list);
     };
 
+    /* Composition pinned while a single secure video layer is played back.
+     * Reused every frame until the geometry changes */
+    struct SecurePlayback {
+        bool valid;
+        int layerCount;
+        int yuvIndex;
+        hwc_rect_t displayFrame;
+        hwc_rect_t sourceCrop;
+        uint32_t transform;
+        bool isFBComposed[MAX_NUM_APP_LAYERS];
+        int fbCount;
+        int mdpCount;
+        int fbZ;
+        /* prepare cost of frames using the pinned composition and of frames
+         * going through the strategies */
+        uint64_t reusedFrames;
+        uint64_t evaluatedFrames;
+        nsecs_t reuseTime;
+        nsecs_t evaluateTime;
+
+        SecurePlayback() { memset(this, 0, sizeof(*this)); }
+    };
+
     /* allocates pipe from pipe book */
     virtual bool allocLayerPipes(hwc_context_t *ctx,
                                  hwc_display_contents_1_t* list) = 0;
@@ -197,6 +220,12 @@ protected:
     bool tryMDPOnlyLayers(hwc_context_t *ctx, hwc_display_contents_1_t* list);
     bool mdpOnlyLayersComp(hwc_context_t *ctx, hwc_display_contents_1_t* list,
             bool secureOnly);
+    /* checks for protected playback of a single secure video layer */
+    bool isSecurePlayback(hwc_context_t *ctx, hwc_display_contents_1_t* list);
+    /* applies the pinned secure playback composition if geometry is same */
+    bool trySecurePlayback(hwc_context_t *ctx, hwc_display_contents_1_t* list);
+    /* pins the composition chosen by the strategies for secure playback */
+    void pinSecurePlayback(hwc_context_t *ctx, hwc_display_contents_1_t* list);
     /* checks for conditions where YUV layers cannot be bypassed */
     bool isYUVDoable(hwc_context_t* ctx, hwc_layer_1_t* layer);
     /* checks for conditions where Secure RGB layers cannot be bypassed */
@@ -265,11 +294,16 @@ protected:
     static int sMaxPipesPerMixer;
     static bool sSrcSplitEnabled;
     static IdleInvalidator *sIdleInvalidator;
+    /* PTOR frames attempted with copybit and accepted by MDP */
+    static uint64_t sPtorAttempts;
+    static uint64_t sPtorSuccesses;
     static bool sIsSingleFullScreenUpdate;
     static int sMaxSecLayers;
     static bool sIsPartialUpdateActive;
     struct FrameInfo mCurrentFrame;
     struct LayerCache mCachedFrame;
+    struct SecurePlayback mSecurePlayback;
+    static bool sSecurePlaybackPin;
     //Enable 4kx2k yuv layer split
     static bool sEnableYUVsplit;
     bool mModeOn; // if prepare happened
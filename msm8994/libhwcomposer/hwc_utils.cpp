@@ -42,6 +42,7 @@
 #include "QService.h"
 #include "comptype.h"
 #include "hwc_virtual.h"
+#include "hwc_cadence.h"
 #include "qd_utils.h"
 #include <sys/sysinfo.h>
 #include <dlfcn.h>
@@ -346,6 +347,7 @@ void initContext(hwc_context_t *ctx)
 
     for (uint32_t i = 0; i < HWC_NUM_DISPLAY_TYPES; i++) {
         ctx->mHwcDebug[i] = new HwcDebug(i);
+        ctx->mCadence[i] = new CadenceTracker(i);
         ctx->mLayerRotMap[i] = new LayerRotMap();
         ctx->mAnimationState[i] = ANIMATION_STOPPED;
         ctx->dpyAttr[i].mActionSafePresent = false;
@@ -462,6 +464,10 @@ void closeContext(hwc_context_t *ctx)
             delete ctx->mHwcDebug[i];
             ctx->mHwcDebug[i] = NULL;
         }
+        if(ctx->mCadence[i]) {
+            delete ctx->mCadence[i];
+            ctx->mCadence[i] = NULL;
+        }
         if(ctx->mLayerRotMap[i]) {
             delete ctx->mLayerRotMap[i];
             ctx->mLayerRotMap[i] = NULL;
@@ -1022,6 +1028,8 @@ void setListStats(hwc_context_t *ctx,
 
     trimList(ctx, list, dpy);
     optimizeLayerRects(list);
+    if(ctx->mCadence[dpy])
+        ctx->mCadence[dpy]->update(list, ctx->listStats[dpy].numAppLayers);
     for (size_t i = 0; i < (size_t)ctx->listStats[dpy].numAppLayers; i++) {
         hwc_layer_1_t const* layer = &list->hwLayers[i];
         private_handle_t *hnd = (private_handle_t *)layer->handle;
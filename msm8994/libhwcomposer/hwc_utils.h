@@ -47,7 +47,7 @@
 #define HWC_WFDDISPSYNC_LOG 0
 #define STR(f) #f;
 // Max number of PTOR layers handled
-#define MAX_PTOR_LAYERS 2
+#define MAX_PTOR_LAYERS 4
 #define MAX_NUM_COLOR_MODES 32
 
 //Fwrd decls
@@ -71,6 +71,7 @@ class IVideoOverlay;
 class MDPComp;
 class CopyBit;
 class HwcDebug;
+class CadenceTracker;
 class AssertiveDisplay;
 class HWCVirtualVDS;
 
@@ -152,6 +153,10 @@ struct ListStats {
 struct PtorInfo {
     int count;
     int layerIndex[MAX_PTOR_LAYERS];
+    // Overlap rect in screen co-ordinates, with the area shared with a
+    // higher PTOR overlap removed
+    hwc_rect_t overlapRect[MAX_PTOR_LAYERS];
+    // Position of the overlap in the render buffer
     hwc_rect_t displayFrame[MAX_PTOR_LAYERS];
     bool isActive() { return (count>0); }
     int getPTORArrayIndex(int index) {
@@ -545,8 +550,10 @@ template<typename T> inline T min(T a, T b) { return (a < b) ? a : b; }
 
 // Initialize uevent thread
 void init_uevent_thread(hwc_context_t* ctx);
-// Initialize vsync thread
-void init_vsync_thread(hwc_context_t* ctx);
+// Initialize the event thread serving vsync, blank and thermal events
+void init_event_thread(hwc_context_t* ctx);
+// Dump event thread wake-up statistics
+void dump_event_thread_stats(android::String8& buf);
 
 inline void getLayerResolution(const hwc_layer_1_t* layer,
                                int& width, int& height) {
@@ -625,6 +632,8 @@ struct hwc_context_t {
     qhwc::LayerProp *layerProp[HWC_NUM_DISPLAY_TYPES];
     qhwc::MDPComp *mMDPComp[HWC_NUM_DISPLAY_TYPES];
     qhwc::HwcDebug *mHwcDebug[HWC_NUM_DISPLAY_TYPES];
+    // Per layer buffer update cadence
+    qhwc::CadenceTracker *mCadence[HWC_NUM_DISPLAY_TYPES];
     hwc_rect_t mViewFrame[HWC_NUM_DISPLAY_TYPES];
     qhwc::AssertiveDisplay *mAD;
     eAnimationState mAnimationState[HWC_NUM_DISPLAY_TYPES];
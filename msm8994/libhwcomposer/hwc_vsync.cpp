@@ -25,8 +25,11 @@
 #include <linux/msm_mdp.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <pthread.h>
 #include "hwc_utils.h"
+#include "hwc_mdpcomp.h"
 #include "hdmi.h"
 #include "qd_utils.h"
 #include "string.h"
@@ -36,16 +39,62 @@
 using namespace qdutils;
 namespace qhwc {
 
-#define HWC_VSYNC_THREAD_NAME "hwcVsyncThread"
+#define HWC_EVENT_THREAD_NAME "hwcEventThread"
 #define PANEL_ON_STR "panel_power_on ="
 #define ARRAY_LENGTH(array) (sizeof((array))/sizeof((array)[0]))
 #define MAX_THERMAL_LEVEL 3
+#define MAX_EPOLL_EVENTS 8
+#define DEFAULT_VSYNC_PERIOD_NS 16666666LL
 const int MAX_DATA = 64;
 
+// Event thread state. The fds are set up by init_event_thread before the
+// thread is started; the fake vsync timer is (re)armed from the binder
+// thread through hwc_vsync_control and is protected by sFakeVsyncLock.
+static int sEpollFd = -1;
+static int sFakeVsyncFd = -1;
+static nsecs_t sFakeVsyncPeriod = 0;
+static nsecs_t sFakeVsyncNext = 0;
+static pthread_mutex_t sFakeVsyncLock = PTHREAD_MUTEX_INITIALIZER;
+
+struct EventThreadStats {
+    uint64_t wakeups;
+    uint64_t vsync;
+    uint64_t blank;
+    uint64_t thermal;
+    uint64_t fakeVsync;
+    uint64_t fakeVsyncMissed;
+};
+static EventThreadStats sStats;
+
+static void arm_fake_vsync(bool enable)
+{
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    pthread_mutex_lock(&sFakeVsyncLock);
+    if(enable) {
+        // Ticks are scheduled on an absolute CLOCK_MONOTONIC grid so that
+        // wake-up latency never accumulates into the vsync phase.
+        sFakeVsyncNext = systemTime(SYSTEM_TIME_MONOTONIC) + sFakeVsyncPeriod;
+        spec.it_value.tv_sec = (time_t)(sFakeVsyncNext / 1000000000LL);
+        spec.it_value.tv_nsec = (long)(sFakeVsyncNext % 1000000000LL);
+        spec.it_interval.tv_sec = (time_t)(sFakeVsyncPeriod / 1000000000LL);
+        spec.it_interval.tv_nsec = (long)(sFakeVsyncPeriod % 1000000000LL);
+    }
+    if(timerfd_settime(sFakeVsyncFd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        ALOGE("%s: timerfd_settime failed: %s", __FUNCTION__, strerror(errno));
+    }
+    pthread_mutex_unlock(&sFakeVsyncLock);
+}
+
 int hwc_vsync_control(hwc_context_t* ctx, int dpy, int enable)
 {
     int ret = 0;
-    if(!ctx->vstate.fakevsync &&
+    if(ctx->vstate.fakevsync) {
+        //Fake vsync is delivered only for the primary display, and only
+        //while SurfaceFlinger has it enabled.
+        if(dpy == HWC_DISPLAY_PRIMARY && sFakeVsyncFd >= 0)
+            arm_fake_vsync(enable);
+    } else if(
        ioctl(ctx->dpyAttr[dpy].fd, MSMFB_OVERLAY_VSYNC_CTRL,
              &enable) < 0) {
         ALOGE("%s: vsync control failed. Dpy=%d, enable=%d : %s",
@@ -97,38 +146,151 @@ static void handle_thermal_event(hwc_context_t* ctx, int dpy, char *data)
 struct event {
     const char* name;
     void (*callback)(hwc_context_t* ctx, int dpy, char *data);
+    uint64_t EventThreadStats::*counter;
 };
 
 struct event event_list[] =  {
-    { "vsync_event", handle_vsync_event },
-    { "show_blank_event", handle_blank_event },
-    { "msm_fb_thermal_level", handle_thermal_event },
+    { "vsync_event", handle_vsync_event, &EventThreadStats::vsync },
+    { "show_blank_event", handle_blank_event, &EventThreadStats::blank },
+    { "msm_fb_thermal_level", handle_thermal_event,
+            &EventThreadStats::thermal },
 };
 
 #define num_events ARRAY_LENGTH(event_list)
 
-static void *vsync_loop(void *param)
+//Number of physical displays
+//We poll on all the nodes.
+#define num_displays (HWC_NUM_DISPLAY_TYPES - 1)
+static int sEventFds[num_displays][num_events];
+
+// epoll data tags: the source lives in the high byte, the display and
+// sysfs event index of a sysfs source in the low bytes.
+enum {
+    EVENT_SRC_SYSFS = 1,
+    EVENT_SRC_FAKE_VSYNC,
+};
+
+#define EVENT_TAG(src, dpy, ev) (((uint32_t)(src) << 16) | \
+        ((uint32_t)(dpy) << 8) | (uint32_t)(ev))
+
+static bool add_event_fd(int fd, uint32_t events, uint32_t tag)
+{
+    struct epoll_event epEvent;
+    memset(&epEvent, 0, sizeof(epEvent));
+    epEvent.events = events;
+    epEvent.data.u32 = tag;
+    if(epoll_ctl(sEpollFd, EPOLL_CTL_ADD, fd, &epEvent) < 0) {
+        ALOGE("%s: epoll_ctl failed for fd %d: %s", __FUNCTION__, fd,
+                strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void handle_fake_vsync(hwc_context_t* ctx)
+{
+    uint64_t expirations = 0;
+    if(read(sFakeVsyncFd, &expirations, sizeof(expirations)) !=
+            (ssize_t)sizeof(expirations) || !expirations) {
+        // Timer was disarmed or re-armed after it fired
+        return;
+    }
+
+    pthread_mutex_lock(&sFakeVsyncLock);
+    // Report the ideal time of the most recent tick rather than the
+    // wake-up time, dropping the ticks we slept through.
+    nsecs_t timestamp = sFakeVsyncNext +
+            (nsecs_t)(expirations - 1) * sFakeVsyncPeriod;
+    sFakeVsyncNext = timestamp + sFakeVsyncPeriod;
+    pthread_mutex_unlock(&sFakeVsyncLock);
+
+    sStats.fakeVsync++;
+    sStats.fakeVsyncMissed += expirations - 1;
+    ALOGD_IF(ctx->vstate.debug, "%s: fake timestamp %" PRId64" sent to SF, "
+            "missed %" PRIu64, __FUNCTION__, timestamp, expirations - 1);
+    ctx->proc->vsync(ctx->proc, HWC_DISPLAY_PRIMARY, timestamp);
+}
+
+static void handle_sysfs_event(hwc_context_t* ctx, int dpy, size_t ev)
+{
+    char vdata[MAX_DATA];
+    ssize_t len = pread(sEventFds[dpy][ev], vdata, MAX_DATA - 1, 0);
+    if (UNLIKELY(len < 0)) {
+        // If the read was just interrupted - it is not
+        // a fatal error. Just continue in this case
+        ALOGE ("%s: Unable to read event:%zu for dpy=%d : %s",
+                __FUNCTION__, ev, dpy, strerror(errno));
+        return;
+    }
+    vdata[len] = '\0';
+    sStats.*(event_list[ev].counter) += 1;
+    event_list[ev].callback(ctx, dpy, vdata);
+}
+
+// Only handlers that never block run here. Hotplug, WFD teardown and the
+// idle timeout wait on locks or on SurfaceFlinger, which needs vsync to
+// compose, so they keep their own uevent and IdleInvalidator threads.
+static void *event_loop(void *param)
 {
     hwc_context_t * ctx = reinterpret_cast<hwc_context_t *>(param);
 
-    char thread_name[64] = HWC_VSYNC_THREAD_NAME;
+    char thread_name[64] = HWC_EVENT_THREAD_NAME;
     prctl(PR_SET_NAME, (unsigned long) &thread_name, 0, 0, 0);
     setpriority(PRIO_PROCESS, 0, HAL_PRIORITY_URGENT_DISPLAY +
                 android::PRIORITY_MORE_FAVORABLE);
 
-    char vdata[MAX_DATA];
-    //Number of physical displays
-    //We poll on all the nodes.
-    int num_displays = HWC_NUM_DISPLAY_TYPES - 1;
-    struct pollfd pfd[num_displays][num_events];
+    struct epoll_event epEvents[MAX_EPOLL_EVENTS];
+
+    do {
+        int count = epoll_wait(sEpollFd, epEvents, MAX_EPOLL_EVENTS, -1);
+        if(count < 0) {
+            if(errno != EINTR) {
+                ALOGE("%s: epoll_wait failed errno: %s", __FUNCTION__,
+                        strerror(errno));
+            }
+            continue;
+        }
+        sStats.wakeups++;
+
+        for(int i = 0; i < count; i++) {
+            uint32_t tag = epEvents[i].data.u32;
+            switch(tag >> 16) {
+            case EVENT_SRC_SYSFS:
+                if(epEvents[i].events & EPOLLPRI)
+                    handle_sysfs_event(ctx, (int)((tag >> 8) & 0xff),
+                            (size_t)(tag & 0xff));
+                break;
+            case EVENT_SRC_FAKE_VSYNC:
+                handle_fake_vsync(ctx);
+                break;
+            default:
+                break;
+            }
+        }
+    } while (true);
 
+    return NULL;
+}
+
+void init_event_thread(hwc_context_t* ctx)
+{
+    int ret;
+    pthread_t event_thread;
+    char vdata[MAX_DATA];
+    char node_path[MAX_SYSFS_FILE_PATH];
     char property[PROPERTY_VALUE_MAX];
+
+    ALOGI("Initializing EVENT Thread");
     if(property_get("debug.hwc.fakevsync", property, NULL) > 0) {
         if(atoi(property) == 1)
             ctx->vstate.fakevsync = true;
     }
 
-    char node_path[MAX_SYSFS_FILE_PATH];
+    sEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(sEpollFd < 0) {
+        ALOGE("%s: epoll_create1 failed: %s", __FUNCTION__, strerror(errno));
+        return;
+    }
 
     for (int dpy = HWC_DISPLAY_PRIMARY; dpy < num_displays; dpy++) {
         for(size_t ev = 0; ev < num_events; ev++) {
@@ -141,89 +303,61 @@ static void *vsync_loop(void *param)
 
             ALOGI("%s: Reading event %zu for dpy %d from %s", __FUNCTION__,
                     ev, dpy, node_path);
-            pfd[dpy][ev].fd = open(node_path, O_RDONLY);
-
-            if (dpy == HWC_DISPLAY_PRIMARY && pfd[dpy][ev].fd < 0) {
-                // Make sure fb device is opened before starting
-                // this thread so this never happens.
-                ALOGE ("%s:unable to open event node for dpy=%d event=%zu, %s",
-                        __FUNCTION__, dpy, ev, strerror(errno));
-                if (ev == 0) {
-                    ctx->vstate.fakevsync = true;
-                    //XXX: Blank events don't work with fake vsync,
-                    //but we shouldn't be running on fake vsync anyway.
-                    break;
-                }
-            }
+            sEventFds[dpy][ev] = open(node_path, O_RDONLY | O_CLOEXEC);
 
-            pread(pfd[dpy][ev].fd, vdata , MAX_DATA, 0);
-            if (pfd[dpy][ev].fd >= 0)
-                pfd[dpy][ev].events = POLLPRI | POLLERR;
-        }
-    }
-
-    if (LIKELY(!ctx->vstate.fakevsync)) {
-        do {
-            int err = poll(*pfd, (int)(num_displays * num_events), -1);
-            if(err > 0) {
-                for (int dpy = HWC_DISPLAY_PRIMARY; dpy < num_displays; dpy++) {
-                    for(size_t ev = 0; ev < num_events; ev++) {
-                        if (pfd[dpy][ev].revents & POLLPRI) {
-                            ssize_t len = pread(pfd[dpy][ev].fd, vdata, MAX_DATA, 0);
-                            if (UNLIKELY(len < 0)) {
-                                // If the read was just interrupted - it is not
-                                // a fatal error. Just continue in this case
-                                ALOGE ("%s: Unable to read event:%zu for \
-                                        dpy=%d : %s",
-                                        __FUNCTION__, ev, dpy, strerror(errno));
-                                continue;
-                            }
-                            event_list[ev].callback(ctx, dpy, vdata);
-                        }
-                    }
+            if (sEventFds[dpy][ev] < 0) {
+                if (dpy == HWC_DISPLAY_PRIMARY) {
+                    // Make sure fb device is opened before starting
+                    // this thread so this never happens.
+                    ALOGE ("%s:unable to open event node for dpy=%d "
+                            "event=%zu, %s", __FUNCTION__, dpy, ev,
+                            strerror(errno));
+                    if (ev == 0)
+                        ctx->vstate.fakevsync = true;
                 }
-            } else {
-                ALOGE("%s: poll failed errno: %s", __FUNCTION__,
-                        strerror(errno));
                 continue;
             }
-        } while (true);
 
-    } else {
-
-        //Fake vsync is used only when set explicitly through a property or when
-        //the vsync timestamp node cannot be opened at bootup. There is no
-        //fallback to fake vsync from the true vsync loop, ever, as the
-        //condition can easily escape detection.
-        //Also, fake vsync is delivered only for the primary display.
-        do {
-            usleep(16666);
-            uint64_t timestamp = systemTime();
-            ctx->proc->vsync(ctx->proc, HWC_DISPLAY_PRIMARY, timestamp);
-
-        } while (true);
+            pread(sEventFds[dpy][ev], vdata , MAX_DATA, 0);
+            add_event_fd(sEventFds[dpy][ev], EPOLLPRI | EPOLLERR,
+                    EVENT_TAG(EVENT_SRC_SYSFS, dpy, ev));
+        }
     }
 
-    for (int dpy = HWC_DISPLAY_PRIMARY; dpy <= HWC_DISPLAY_EXTERNAL; dpy++ ) {
-        for( size_t event = 0; event < num_events; event++) {
-            if(pfd[dpy][event].fd >= 0)
-                close (pfd[dpy][event].fd);
+    //Fake vsync is used only when set explicitly through a property or when
+    //the vsync timestamp node cannot be opened at bootup. There is no
+    //fallback to fake vsync from the true vsync loop, ever, as the
+    //condition can easily escape detection.
+    if (UNLIKELY(ctx->vstate.fakevsync)) {
+        sFakeVsyncPeriod = ctx->dpyAttr[HWC_DISPLAY_PRIMARY].vsync_period ?
+                (nsecs_t)ctx->dpyAttr[HWC_DISPLAY_PRIMARY].vsync_period :
+                DEFAULT_VSYNC_PERIOD_NS;
+        sFakeVsyncFd = timerfd_create(CLOCK_MONOTONIC,
+                TFD_NONBLOCK | TFD_CLOEXEC);
+        if(sFakeVsyncFd < 0) {
+            ALOGE("%s: timerfd_create failed: %s", __FUNCTION__,
+                    strerror(errno));
+        } else if(add_event_fd(sFakeVsyncFd, EPOLLIN,
+                EVENT_TAG(EVENT_SRC_FAKE_VSYNC, 0, 0))) {
+            if(ctx->vstate.enable)
+                arm_fake_vsync(true);
         }
     }
 
-    return NULL;
-}
-
-void init_vsync_thread(hwc_context_t* ctx)
-{
-    int ret;
-    pthread_t vsync_thread;
-    ALOGI("Initializing VSYNC Thread");
-    ret = pthread_create(&vsync_thread, NULL, vsync_loop, (void*) ctx);
+    ret = pthread_create(&event_thread, NULL, event_loop, (void*) ctx);
     if (ret) {
         ALOGE("%s: failed to create %s: %s", __FUNCTION__,
-              HWC_VSYNC_THREAD_NAME, strerror(ret));
+              HWC_EVENT_THREAD_NAME, strerror(ret));
     }
 }
 
+void dump_event_thread_stats(android::String8& buf)
+{
+    dumpsys_log(buf, "Event thread: wakeups=%" PRIu64 " vsync=%" PRIu64
+            " blank=%" PRIu64 " thermal=%" PRIu64 " fakevsync=%" PRIu64
+            " fakevsync_missed=%" PRIu64 "\n", sStats.wakeups, sStats.vsync,
+            sStats.blank, sStats.thermal, sStats.fakeVsync,
+            sStats.fakeVsyncMissed);
+}
+
 }; //namespace
@@ -0,0 +1,120 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __LAYER_CADENCE_H__
+#define __LAYER_CADENCE_H__
+
+#include <stdint.h>
+#include <chrono>
+#include <cmath>
+
+namespace qdutils {
+
+// Tracks how often a layer receives a new buffer. Updates within the last kWindowNs feed the
+// rate and the jitter of the update intervals.
+class LayerCadence {
+ public:
+  void Update(int64_t timestamp_ns) {
+    samples_[next_sample_] = timestamp_ns;
+    next_sample_ = (next_sample_ + 1) % kMaxSamples;
+    if (sample_count_ < kMaxSamples) {
+      sample_count_++;
+    }
+    update_count_++;
+  }
+
+  // Update rate in Hz, 0 when the layer has not updated within the window
+  float GetRate(int64_t now_ns) const {
+    int64_t samples[kMaxSamples];
+    int count = GetWindow(now_ns, samples);
+    if (count < 2 || samples[0] == samples[count - 1]) {
+      return 0.0f;
+    }
+
+    return static_cast<float>(count - 1) * 1e9f /
+           static_cast<float>(samples[0] - samples[count - 1]);
+  }
+
+  // Standard deviation of the update intervals within the window in milliseconds
+  float GetJitterMs(int64_t now_ns) const {
+    int64_t samples[kMaxSamples];
+    int count = GetWindow(now_ns, samples);
+    if (count < 2) {
+      return 0.0f;
+    }
+
+    double mean = static_cast<double>(samples[0] - samples[count - 1]) / (count - 1);
+    double variance = 0;
+    for (int i = 1; i < count; i++) {
+      double diff = static_cast<double>(samples[i - 1] - samples[i]) - mean;
+      variance += diff * diff;
+    }
+
+    return static_cast<float>(std::sqrt(variance / (count - 1)) / 1e6);
+  }
+
+  // Time since the last update, -1 if the layer never updated
+  int64_t GetAgeNs(int64_t now_ns) const {
+    if (!sample_count_) {
+      return -1;
+    }
+
+    return now_ns - samples_[(next_sample_ - 1 + kMaxSamples) % kMaxSamples];
+  }
+
+  uint64_t GetUpdateCount() const { return update_count_; }
+
+  static int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static const int64_t kWindowNs = 1000000000LL;
+
+ private:
+  static const int kMaxSamples = 32;
+
+  // Copies the timestamps within the window, newest first, and returns their count
+  int GetWindow(int64_t now_ns, int64_t *samples) const {
+    int count = 0;
+    for (int i = 0; i < sample_count_; i++) {
+      int64_t timestamp = samples_[(next_sample_ - 1 - i + kMaxSamples) % kMaxSamples];
+      if (now_ns - timestamp > kWindowNs) {
+        break;
+      }
+      samples[count++] = timestamp;
+    }
+
+    return count;
+  }
+
+  int64_t samples_[kMaxSamples] = {};
+  int sample_count_ = 0;
+  int next_sample_ = 0;
+  uint64_t update_count_ = 0;
+};
+
+}  // namespace qdutils
+
+#endif  // __LAYER_CADENCE_H__
@@ -1297,7 +1297,7 @@ static int stretch_copybit_internal(
         IMemAlloc* memalloc = sAlloc->getAllocator(src_hnd->flags);
         if (memalloc->clean_buffer((void *)(src_hnd->base), src_hnd->size,
                                    src_hnd->offset, src_hnd->fd,
-                                   gralloc::CACHE_CLEAN)) {
+                                   gralloc::CACHE_CLEAN, -1)) {
             ALOGE("%s: clean_buffer failed", __FUNCTION__);
             delete_handle(dst_hnd);
             delete_handle(src_hnd);
@@ -1383,7 +1383,7 @@ static int stretch_copybit_internal(
         IMemAlloc* memalloc = sAlloc->getAllocator(dst_hnd->flags);
         memalloc->clean_buffer((void *)(dst_hnd->base), dst_hnd->size,
                                dst_hnd->offset, dst_hnd->fd,
-                               gralloc::CACHE_CLEAN);
+                               gralloc::CACHE_CLEAN, -1);
     }
     delete_handle(dst_hnd);
     delete_handle(src_hnd);
@@ -0,0 +1,249 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+// Intentionally included after xf86 headers so that they in-turn include libdrm version of drm.h
+// that doesn't use keyword "virtual" for a variable name. Not doing so leads to the kernel version
+// of drm.h being included causing compilation to fail
+#include <drm/msm_drm.h>
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+#include "drm_fb_id_manager.h"
+
+#define __CLASS__ "DRMFbIdManager"
+
+using std::mutex;
+using std::lock_guard;
+using std::begin;
+using std::copy;
+using std::end;
+using std::equal;
+using std::fill;
+using std::lexicographical_compare;
+using std::tie;
+
+namespace drm_utils {
+
+DRMFbIdManager *DRMFbIdManager::s_instance = nullptr;
+mutex DRMFbIdManager::s_lock;
+
+bool DRMFbIdManager::FbKey::operator<(const FbKey &rhs) const {
+  auto lhs_fields = tie(gem_handle, width, height, drm_format, drm_format_modifier);
+  auto rhs_fields = tie(rhs.gem_handle, rhs.width, rhs.height, rhs.drm_format,
+                        rhs.drm_format_modifier);
+  if (lhs_fields != rhs_fields) {
+    return lhs_fields < rhs_fields;
+  }
+
+  if (!equal(begin(stride), end(stride), begin(rhs.stride))) {
+    return lexicographical_compare(begin(stride), end(stride), begin(rhs.stride),
+                                   end(rhs.stride));
+  }
+
+  return lexicographical_compare(begin(offset), end(offset), begin(rhs.offset), end(rhs.offset));
+}
+
+int DRMFbIdManager::GetInstance(DRMFbIdManager **manager) {
+  lock_guard<mutex> obj(s_lock);
+
+  if (!s_instance) {
+    s_instance = new DRMFbIdManager();
+    if (s_instance->Init() < 0) {
+      delete s_instance;
+      s_instance = nullptr;
+      return -ENODEV;
+    }
+  }
+
+  *manager = s_instance;
+  return 0;
+}
+
+int DRMFbIdManager::Init() {
+  DRMMaster *master = nullptr;
+  int ret = DRMMaster::GetInstance(&master);
+  if (ret < 0) {
+    DRM_LOGE("Failed to acquire DRMMaster instance");
+    return ret;
+  }
+
+  master->GetHandle(&dev_fd_);
+  return 0;
+}
+
+DRMFbIdManager::~DRMFbIdManager() {
+  lock_guard<mutex> obj(lock_);
+  FlushLocked();
+}
+
+int DRMFbIdManager::GetFbId(const DRMBuffer &drm_buffer, uint32_t *gem_handle, uint32_t *fb_id) {
+  lock_guard<mutex> obj(lock_);
+
+  // Importing an already imported buffer returns the existing handle, which is what makes the
+  // handle usable as the identity of the buffer.
+  uint32_t handle = 0;
+  int ret = drmPrimeFDToHandle(dev_fd_, drm_buffer.fd, &handle);
+  if (ret) {
+    DRM_LOGE("drmPrimeFDToHandle failed with error %d", ret);
+    return ret;
+  }
+
+  FbKey key;
+  key.gem_handle = handle;
+  key.width = drm_buffer.width;
+  key.height = drm_buffer.height;
+  key.drm_format = drm_buffer.drm_format;
+  key.drm_format_modifier = drm_buffer.drm_format_modifier;
+  copy(begin(drm_buffer.stride), end(drm_buffer.stride), begin(key.stride));
+  copy(begin(drm_buffer.offset), end(drm_buffer.offset), begin(key.offset));
+
+  auto it = fb_ids_.find(key);
+  if (it == fb_ids_.end()) {
+    uint32_t id = 0;
+    ret = AddFb(drm_buffer, handle, &id);
+    if (ret) {
+      if (gem_refs_.find(handle) == gem_refs_.end()) {
+        struct drm_gem_close gem_close = {};
+        gem_close.handle = handle;
+        if (drmIoctl(dev_fd_, DRM_IOCTL_GEM_CLOSE, &gem_close)) {
+          DRM_LOGE("drmIoctl::DRM_IOCTL_GEM_CLOSE failed with error %d", errno);
+        }
+      }
+      return ret;
+    }
+
+    it = fb_ids_.emplace(key, id).first;
+    fb_entries_[id].key = key;
+    gem_refs_[handle]++;
+  }
+
+  // A released framebuffer that has not been flushed yet is simply picked up again.
+  fb_entries_[it->second].ref_count++;
+  *gem_handle = handle;
+  *fb_id = it->second;
+
+  return 0;
+}
+
+void DRMFbIdManager::ReleaseFbId(uint32_t gem_handle, uint32_t fb_id) {
+  lock_guard<mutex> obj(lock_);
+
+  auto it = fb_entries_.find(fb_id);
+  if (it == fb_entries_.end() || it->second.key.gem_handle != gem_handle) {
+    DRM_LOGE("Unknown fb_id %d, gem handle %d", fb_id, gem_handle);
+    return;
+  }
+
+  if (it->second.ref_count && --it->second.ref_count == 0) {
+    released_fb_ids_.push_back(fb_id);
+    if (released_fb_ids_.size() >= kReleaseBatchSize) {
+      FlushLocked();
+    }
+  }
+}
+
+void DRMFbIdManager::Flush() {
+  lock_guard<mutex> obj(lock_);
+  FlushLocked();
+}
+
+void DRMFbIdManager::FlushLocked() {
+  for (uint32_t fb_id : released_fb_ids_) {
+    auto it = fb_entries_.find(fb_id);
+    // Skip framebuffers that were reused or already removed since they were released.
+    if (it == fb_entries_.end() || it->second.ref_count) {
+      continue;
+    }
+
+    uint32_t gem_handle = it->second.key.gem_handle;
+    fb_ids_.erase(it->second.key);
+    fb_entries_.erase(it);
+    RemoveFb(fb_id);
+    PutGemHandle(gem_handle);
+  }
+
+  released_fb_ids_.clear();
+}
+
+int DRMFbIdManager::AddFb(const DRMBuffer &drm_buffer, uint32_t gem_handle, uint32_t *fb_id) {
+  struct drm_mode_fb_cmd2 cmd2 {};
+  cmd2.width = drm_buffer.width;
+  cmd2.height = drm_buffer.height;
+  cmd2.pixel_format = drm_buffer.drm_format;
+  cmd2.flags = DRM_MODE_FB_MODIFIERS;
+  fill(begin(cmd2.handles), begin(cmd2.handles) + drm_buffer.num_planes, gem_handle);
+  copy(begin(drm_buffer.stride), end(drm_buffer.stride), begin(cmd2.pitches));
+  copy(begin(drm_buffer.offset), end(drm_buffer.offset), begin(cmd2.offsets));
+  fill(begin(cmd2.modifier), begin(cmd2.modifier) + drm_buffer.num_planes,
+       drm_buffer.drm_format_modifier);
+
+  int ret = drmIoctl(dev_fd_, DRM_IOCTL_MODE_ADDFB2, &cmd2);
+  if (ret) {
+    DRM_LOGE("DRM_IOCTL_MODE_ADDFB2 failed with error %d", ret);
+    return ret;
+  }
+
+  *fb_id = cmd2.fb_id;
+  return 0;
+}
+
+void DRMFbIdManager::RemoveFb(uint32_t fb_id) {
+#ifdef DRM_IOCTL_MSM_RMFB2
+  int ret = drmIoctl(dev_fd_, DRM_IOCTL_MSM_RMFB2, &fb_id);
+  if (ret) {
+    DRM_LOGE("drmIoctl::DRM_IOCTL_MSM_RMFB2 failed for fb_id %d with error %d", fb_id, errno);
+  }
+#else
+  int ret = drmModeRmFB(dev_fd_, fb_id);
+  if (ret) {
+    DRM_LOGE("drmModeRmFB failed for fb_id %d with error %d", fb_id, ret);
+  }
+#endif
+}
+
+void DRMFbIdManager::PutGemHandle(uint32_t gem_handle) {
+  auto it = gem_refs_.find(gem_handle);
+  if (it == gem_refs_.end() || --it->second) {
+    return;
+  }
+
+  gem_refs_.erase(it);
+  struct drm_gem_close gem_close = {};
+  gem_close.handle = gem_handle;
+  if (drmIoctl(dev_fd_, DRM_IOCTL_GEM_CLOSE, &gem_close)) {
+    DRM_LOGE("drmIoctl::DRM_IOCTL_GEM_CLOSE failed with error %d", errno);
+  }
+}
+
+}  // namespace drm_utils
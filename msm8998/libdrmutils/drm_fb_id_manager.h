@@ -0,0 +1,119 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without
+* modification, are permitted provided that the following conditions are
+* met:
+*   * Redistributions of source code must retain the above copyright
+*     notice, this list of conditions and the following disclaimer.
+*   * Redistributions in binary form must reproduce the above
+*     copyright notice, this list of conditions and the following
+*     disclaimer in the documentation and/or other materials provided
+*     with the distribution.
+*   * Neither the name of The Linux Foundation nor the names of its
+*     contributors may be used to endorse or promote products derived
+*     from this software without specific prior written permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+* ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+* BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+* CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+* SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+* OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+* IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __DRM_FB_ID_MANAGER_H__
+#define __DRM_FB_ID_MANAGER_H__
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "drm_master.h"
+
+namespace drm_utils {
+
+/* Hands out DRM framebuffer ids on demand. Framebuffers are cached by the GEM handle of the
+ * imported buffer and its layout, so a buffer that is imported more than once maps to a single
+ * fb_id. Framebuffers that are no longer referenced are removed in batches.
+ */
+class DRMFbIdManager {
+ public:
+  ~DRMFbIdManager();
+  /* Returns a framebuffer id for the buffer, creating one on the first request. Every successful
+   * call must be balanced by a call to ReleaseFbId.
+   * Input:
+   *   drm_buffer: A DRMBuffer obj that packages description of buffer
+   * Output:
+   *   gem_handle: Pointer to store the GEM handle backing the framebuffer
+   *   fb_id: Pointer to store DRM framebuffer id into
+   * Returns:
+   *   ioctl error code
+   */
+  int GetFbId(const DRMBuffer &drm_buffer, uint32_t *gem_handle, uint32_t *fb_id);
+  /* Drops a reference taken with GetFbId. The framebuffer stays cached until the next batch of
+   * released framebuffers is removed from DRM, or until Flush is called.
+   * Input:
+   *   gem_handle: GEM handle returned by GetFbId
+   *   fb_id: DRM FB returned by GetFbId
+   */
+  void ReleaseFbId(uint32_t gem_handle, uint32_t fb_id);
+  /* Removes all released framebuffers from DRM and closes their GEM handles. To be called when
+   * buffer memory is freed, so that a batch that does not fill up does not keep it pinned.
+   */
+  void Flush();
+
+  /* Creates an instance of DRMFbIdManager if it doesn't exist and initializes it. Threadsafe.
+   * Input:
+   *   manager: Pointer to store a pointer to the instance
+   * Returns:
+   *   -ENODEV if DRMMaster cannot be acquired
+   */
+  static int GetInstance(DRMFbIdManager **manager);
+
+ private:
+  // Released framebuffers pin their buffer memory through the GEM handle, keep the batch small.
+  static const uint32_t kReleaseBatchSize = 8;
+
+  struct FbKey {
+    uint32_t gem_handle = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t drm_format = 0;
+    uint64_t drm_format_modifier = 0;
+    uint32_t stride[4] = {};
+    uint32_t offset[4] = {};
+
+    bool operator<(const FbKey &rhs) const;
+  };
+
+  struct FbEntry {
+    FbKey key;
+    uint32_t ref_count = 0;
+  };
+
+  DRMFbIdManager() {}
+  int Init();
+  int AddFb(const DRMBuffer &drm_buffer, uint32_t gem_handle, uint32_t *fb_id);
+  void RemoveFb(uint32_t fb_id);
+  void PutGemHandle(uint32_t gem_handle);
+  void FlushLocked();
+
+  int dev_fd_ = -1;
+  std::map<FbKey, uint32_t> fb_ids_;       // Buffer layout --> fb_id
+  std::map<uint32_t, FbEntry> fb_entries_;  // fb_id --> cache entry
+  std::map<uint32_t, uint32_t> gem_refs_;   // GEM handle --> number of cached fb_ids
+  std::vector<uint32_t> released_fb_ids_;
+  std::mutex lock_;
+  static DRMFbIdManager *s_instance;  // Singleton instance
+  static std::mutex s_lock;
+};
+
+}  // namespace drm_utils
+
+#endif  // __DRM_FB_ID_MANAGER_H__
@@ -454,6 +454,7 @@ int IonController::allocate(alloc_data& data, int usage)
     int ret;
 
     data.uncached = useUncached(usage);
+    data.prefault = usage & GRALLOC_USAGE_PRIVATE_PREFAULT;
     data.allocType = 0;
 
     if(usage & GRALLOC_USAGE_PROTECTED) {
@@ -24,6 +24,7 @@
 #ifdef COMPILE_DRM
 #include <drm/drm_fourcc.h>
 #include <drm_master.h>
+#include <drm_fb_id_manager.h>
 #endif
 #include <qdMetaData.h>
 #include <qd_utils.h>
@@ -230,6 +231,91 @@ static void getDRMFormat(int hal_format, int flags, uint32_t *drm_format,
 }
 #endif
 
+// Framebuffer ids are created when a buffer is first handed to a display plane rather than at
+// allocation, buffers that are only ever composed by the GPU never get one.
+int getFbId(private_handle_t *hnd, unsigned int *fb_id)
+{
+#ifdef COMPILE_DRM
+    if (hnd->fb_id) {
+        *fb_id = hnd->fb_id;
+        return 0;
+    }
+
+    if (qdutils::getDriverType() != qdutils::DriverType::DRM ||
+            !(hnd->flags & private_handle_t::PRIV_FLAGS_DISP_CONSUMER)) {
+        return -EINVAL;
+    }
+
+    DRMBuffer buf = {};
+    int ret = getPlaneStrideOffset(hnd, buf.stride, buf.offset,
+            &buf.num_planes);
+    if (ret < 0) {
+        ALOGE("%s failed", __FUNCTION__);
+        return ret;
+    }
+
+    buf.fd = hnd->fd;
+    buf.width = hnd->width;
+    buf.height = hnd->height;
+    getDRMFormat(hnd->format, hnd->flags, &buf.drm_format,
+            &buf.drm_format_modifier);
+
+    DRMFbIdManager *fb_id_mgr = nullptr;
+    ret = DRMFbIdManager::GetInstance(&fb_id_mgr);
+    if (ret < 0) {
+        ALOGE("%s Failed to acquire DRMFbIdManager instance", __FUNCTION__);
+        return ret;
+    }
+
+    ret = fb_id_mgr->GetFbId(buf, &hnd->gem_handle, &hnd->fb_id);
+    if (ret < 0) {
+        ALOGE("%s: GetFbId failed. width %d, height %d, " \
+                "format: %s, stride %u, error %d", __FUNCTION__,
+                buf.width, buf.height,
+                qdutils::GetHALPixelFormatString(hnd->format),
+                buf.stride[0], errno);
+        return ret;
+    }
+
+    *fb_id = hnd->fb_id;
+    return 0;
+#else
+    (void) hnd;
+    (void) fb_id;
+    return -EINVAL;
+#endif
+}
+
+void releaseFbId(private_handle_t *hnd, bool flush)
+{
+#ifdef COMPILE_DRM
+    if (!hnd->fb_id && !flush) {
+        return;
+    }
+
+    DRMFbIdManager *fb_id_mgr = nullptr;
+    if (DRMFbIdManager::GetInstance(&fb_id_mgr) < 0) {
+        ALOGE("%s Failed to acquire DRMFbIdManager instance", __FUNCTION__);
+        return;
+    }
+
+    if (hnd->fb_id) {
+        fb_id_mgr->ReleaseFbId(hnd->gem_handle, hnd->fb_id);
+        hnd->gem_handle = 0;
+        hnd->fb_id = 0;
+    }
+
+    // Released framebuffers keep the memory of their buffers through the
+    // GEM handle, drop them once a buffer is actually freed
+    if (flush) {
+        fb_id_mgr->Flush();
+    }
+#else
+    (void) hnd;
+    (void) flush;
+#endif
+}
+
 gpu_context_t::gpu_context_t(const private_module_t* module,
                              IAllocController* alloc_ctrl ) :
     mAllocCtrl(alloc_ctrl)
@@ -369,42 +455,6 @@ int gpu_context_t::gralloc_alloc_buffer(unsigned int size, int usage,
         ColorSpace_t colorSpace = ITU_R_601;
         setMetaData(hnd, UPDATE_COLOR_SPACE, (void*) &colorSpace);
 
-#ifdef COMPILE_DRM
-        if (qdutils::getDriverType() == qdutils::DriverType::DRM &&
-                usage & GRALLOC_USAGE_HW_COMPOSER) {
-            DRMBuffer buf = {};
-            int ret = getPlaneStrideOffset(hnd, buf.stride, buf.offset,
-                    &buf.num_planes);
-            if (ret < 0) {
-                ALOGE("%s failed", __FUNCTION__);
-                return ret;
-            }
-
-            buf.fd = hnd->fd;
-            buf.width = hnd->width;
-            buf.height = hnd->height;
-            getDRMFormat(hnd->format, flags, &buf.drm_format,
-                    &buf.drm_format_modifier);
-
-            DRMMaster *master = nullptr;
-            ret = DRMMaster::GetInstance(&master);
-            if (ret < 0) {
-                ALOGE("%s Failed to acquire DRMMaster instance", __FUNCTION__);
-                return ret;
-            }
-
-            ret = master->CreateFbId(buf, &hnd->gem_handle, &hnd->fb_id);
-            if (ret < 0) {
-                ALOGE("%s: CreateFbId failed. width %d, height %d, " \
-                        "format: %s, stride %u, error %d", __FUNCTION__,
-                        buf.width, buf.height,
-                        qdutils::GetHALPixelFormatString(hnd->format),
-                        buf.stride[0], errno);
-                return ret;
-            }
-        }
-#endif
-
         *pHandle = hnd;
     }
 
@@ -605,21 +655,7 @@ int gpu_context_t::free_impl(private_handle_t const* hnd) {
             return err;
     }
 
-#ifdef COMPILE_DRM
-    if (hnd->fb_id) {
-        DRMMaster *master = nullptr;
-        int ret = DRMMaster::GetInstance(&master);
-        if (ret < 0) {
-            ALOGE("%s Failed to acquire DRMMaster instance", __FUNCTION__);
-            return ret;
-        }
-        ret = master->RemoveFbId(hnd->gem_handle, hnd->fb_id);
-        if (ret < 0) {
-            ALOGE("%s: Removing fb_id %d failed with error %d", __FUNCTION__,
-                    hnd->fb_id, errno);
-        }
-    }
-#endif
+    releaseFbId(const_cast<private_handle_t*>(hnd), true);
 
     delete hnd;
     return 0;
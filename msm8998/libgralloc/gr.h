@@ -49,6 +49,8 @@ inline Type ALIGN(Type x, Type align) {
 
 int mapFrameBufferLocked(struct private_module_t* module);
 int terminateBuffer(gralloc_module_t const* module, private_handle_t* hnd);
+int getFbId(private_handle_t* hnd, unsigned int *fb_id);
+void releaseFbId(private_handle_t* hnd, bool flush);
 unsigned int getBufferSizeAndDimensions(int width, int height, int format,
         int usage, int& alignedw, int &alignedh);
 unsigned int getBufferSizeAndDimensions(int width, int height, int format,
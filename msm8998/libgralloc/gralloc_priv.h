@@ -38,7 +38,9 @@
  * is cached by default and
  * is not secured */
 
-/* GRALLOC_USAGE_PRIVATE_0 is unused */
+/* Populate the CPU mapping at allocation time so that the first
+ * access does not fault */
+#define GRALLOC_USAGE_PRIVATE_PREFAULT        GRALLOC_USAGE_PRIVATE_0
 
 /* Non linear, Universal Bandwidth Compression */
 #define GRALLOC_USAGE_PRIVATE_ALLOC_UBWC      GRALLOC_USAGE_PRIVATE_1
@@ -89,6 +91,7 @@
 #define GRALLOC_MODULE_PERFORM_GET_IGC 11
 #define GRALLOC_MODULE_PERFORM_SET_IGC 12
 #define GRALLOC_MODULE_PERFORM_SET_SINGLE_BUFFER_MODE 13
+#define GRALLOC_MODULE_PERFORM_GET_FB_ID 14
 
 /* OEM specific HAL formats */
 
@@ -225,7 +228,9 @@ struct private_handle_t : public native_handle {
             // Buffer is allocated with UBWC alignment
             PRIV_FLAGS_UBWC_ALIGNED       = 0x08000000,
             // Buffer allocated will be consumed by SF/HWC
-            PRIV_FLAGS_DISP_CONSUMER      = 0x10000000
+            PRIV_FLAGS_DISP_CONSUMER      = 0x10000000,
+            // Slice of a buffer set, mapped at offset and offset_metadata
+            PRIV_FLAGS_SUB_ALLOCATED      = 0x40000000
         };
 
         // file-descriptors
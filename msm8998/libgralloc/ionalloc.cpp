@@ -100,8 +100,9 @@ int IonAlloc::alloc_buffer(alloc_data& data)
     }
 
     if(!(data.flags & ION_SECURE)) {
+        int mapFlags = MAP_SHARED | (data.prefault ? MAP_POPULATE : 0);
         base = mmap(0, ionAllocData.len, PROT_READ|PROT_WRITE,
-                    MAP_SHARED, fd_data.fd, 0);
+                    mapFlags, fd_data.fd, 0);
         if(base == MAP_FAILED) {
             err = -errno;
             ALOGE("%s: Failed to map the allocated memory: %s",
@@ -178,30 +179,72 @@ int IonAlloc::unmap_buffer(void *base, unsigned int size,
     return err;
 
 }
+
+int IonAlloc::import_handle(int fd, ion_user_handle_t *handle)
+{
+    struct ion_fd_data fd_data;
+    fd_data.fd = fd;
+    if (ioctl(mIonFd, ION_IOC_IMPORT, &fd_data)) {
+        int err = -errno;
+        ALOGE("%s: ION_IOC_IMPORT failed with error - %s",
+              __FUNCTION__, strerror(errno));
+        return err;
+    }
+    *handle = fd_data.handle;
+    return 0;
+}
+
+int IonAlloc::retain_handle(int fd, int *handle)
+{
+    ATRACE_CALL();
+    Locker::Autolock _l(mLock);
+    int err = open_device();
+    if (err)
+        return err;
+
+    ion_user_handle_t ionHandle;
+    err = import_handle(fd, &ionHandle);
+    if (!err)
+        *handle = ionHandle;
+    return err;
+}
+
+void IonAlloc::release_handle(int handle)
+{
+    struct ion_handle_data handle_data;
+    handle_data.handle = handle;
+    ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+}
+
 int IonAlloc::clean_buffer(void *base, unsigned int size, unsigned int offset,
-        int fd, int op)
+        int fd, int op, int handle)
 {
     ATRACE_CALL();
     ATRACE_INT("operation id", op);
     struct ion_flush_data flush_data;
-    struct ion_fd_data fd_data;
     struct ion_handle_data handle_data;
+    bool imported = false;
     int err = 0;
 
-    err = open_device();
-    if (err)
-        return err;
+    {
+        Locker::Autolock _l(mLock);
+        err = open_device();
+        if (err)
+            return err;
 
-    fd_data.fd = fd;
-    if (ioctl(mIonFd, ION_IOC_IMPORT, &fd_data)) {
-        err = -errno;
-        ALOGE("%s: ION_IOC_IMPORT failed with error - %s",
-              __FUNCTION__, strerror(errno));
-        return err;
+        // Buffers that are not registered get a handle just for this call
+        if (handle < 0) {
+            ion_user_handle_t ionHandle;
+            err = import_handle(fd, &ionHandle);
+            if (err)
+                return err;
+            handle = ionHandle;
+            imported = true;
+        }
     }
 
-    handle_data.handle = fd_data.handle;
-    flush_data.handle  = fd_data.handle;
+    handle_data.handle = handle;
+    flush_data.handle  = handle;
     flush_data.vaddr   = base;
     // offset and length are unsigned int
     flush_data.offset  = offset;
@@ -227,10 +270,9 @@ int IonAlloc::clean_buffer(void *base, unsigned int size, unsigned int offset,
         ALOGE("%s: ION_IOC_CLEAN_INV_CACHES failed with error - %s",
 
               __FUNCTION__, strerror(errno));
-        ioctl(mIonFd, ION_IOC_FREE, &handle_data);
-        return err;
     }
-    ioctl(mIonFd, ION_IOC_FREE, &handle_data);
-    return 0;
+    if (imported)
+        ioctl(mIonFd, ION_IOC_FREE, &handle_data);
+    return err;
 }
 
@@ -51,7 +51,12 @@ class IonAlloc : public IMemAlloc  {
                              unsigned int offset);
 
     virtual int clean_buffer(void*base, unsigned int size,
-                             unsigned int offset, int fd, int op);
+                             unsigned int offset, int fd, int op,
+                             int handle);
+
+    virtual int retain_handle(int fd, int *handle);
+
+    virtual void release_handle(int handle);
 
     IonAlloc() { mIonFd = FD_INIT; }
 
@@ -64,6 +69,8 @@ class IonAlloc : public IMemAlloc  {
 
     void close_device();
 
+    int import_handle(int fd, ion_user_handle_t *handle);
+
     mutable Locker mLock;
 
 };
@@ -28,8 +28,12 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 #include <cutils/log.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <utils/Trace.h>
 
 #include <hardware/hardware.h>
@@ -55,6 +59,86 @@ static IMemAlloc* getAllocator(int flags)
     return memalloc;
 }
 
+/*****************************************************************************/
+
+static pthread_mutex_t sMapLock = PTHREAD_MUTEX_INITIALIZER;
+
+struct buffer_state_t {
+    bool registered = false;
+    // Allocator handle kept while registered, -1 if there is none
+    int allocHandle = -1;
+    // Byte range written by the CPU, cleaned on unlock
+    unsigned int flushOffset = 0;
+    unsigned int flushSize = 0;
+};
+
+// Buffers registered by this process, and buffers locked for a CPU write.
+// Guarded by sMapLock
+static std::unordered_map<const private_handle_t*, buffer_state_t> sBuffers;
+
+// With debug.gralloc.lazy_metadata set, registering a buffer leaves its
+// metadata unmapped until gralloc reads it. Only for processes that do not
+// read base_metadata directly
+static bool isLazyMetadata()
+{
+    static const bool lazy = [] {
+        char property[PROPERTY_VALUE_MAX];
+        return (property_get("debug.gralloc.lazy_metadata", property, NULL) > 0) &&
+               (!strncmp(property, "1", PROPERTY_VALUE_MAX) ||
+                !strncasecmp(property, "true", PROPERTY_VALUE_MAX));
+    }();
+    return lazy;
+}
+
+static unsigned int getRgbBpp(int format)
+{
+    switch (format) {
+        case HAL_PIXEL_FORMAT_RGB_888:
+        case HAL_PIXEL_FORMAT_BGR_888:
+            return 3;
+        case HAL_PIXEL_FORMAT_RGB_565:
+        case HAL_PIXEL_FORMAT_BGR_565:
+        case HAL_PIXEL_FORMAT_RGBA_5551:
+        case HAL_PIXEL_FORMAT_RGBA_4444:
+        case HAL_PIXEL_FORMAT_RG_88:
+            return 2;
+        case HAL_PIXEL_FORMAT_R_8:
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+// Byte range covered by a lock rect. Only linear RGB buffers map a rect to
+// one contiguous range, other buffers and an empty rect use the whole buffer
+static void getCacheRange(const private_handle_t* hnd, int l, int t, int w,
+                          int h, unsigned int& offset, unsigned int& size)
+{
+    offset = 0;
+    size = hnd->size;
+    if (!isUncompressedRgbFormat(hnd->format) ||
+        (hnd->flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED) ||
+        w <= 0 || h <= 0 || l < 0 || t < 0 ||
+        l + w > hnd->width || t + h > hnd->height) {
+        return;
+    }
+
+    unsigned int bpp = getRgbBpp(hnd->format);
+    unsigned int stride = (unsigned int)hnd->width * bpp;
+    unsigned int start = (unsigned int)t * stride + (unsigned int)l * bpp;
+    unsigned int end = (unsigned int)(t + h - 1) * stride +
+                       (unsigned int)(l + w) * bpp;
+
+    // Cache maintenance works on whole pages
+    unsigned int pageSize = (unsigned int)getpagesize();
+    start &= ~(pageSize - 1);
+    end = std::min(ALIGN(end, pageSize), hnd->size);
+    if (start < end) {
+        offset = start;
+        size = end - start;
+    }
+}
+
 static int gralloc_map_metadata(buffer_handle_t handle) {
     private_handle_t* hnd = (private_handle_t*)handle;
     hnd->base_metadata = 0;
@@ -77,7 +161,7 @@ static int gralloc_map_metadata(buffer_handle_t handle) {
 }
 
 static int gralloc_map(gralloc_module_t const* module,
-                       buffer_handle_t handle)
+                       buffer_handle_t handle, bool mapMetadata)
 {
     ATRACE_CALL();
     if(!module)
@@ -113,13 +197,30 @@ static int gralloc_map(gralloc_module_t const* module,
 
     //Allow mapping of metadata for all buffers including secure ones, but not
     //of framebuffer
-    int metadata_err = gralloc_map_metadata(handle);
-    if (!err) {
-        err = metadata_err;
+    if (mapMetadata && !hnd->base_metadata) {
+        int metadata_err = gralloc_map_metadata(handle);
+        if (!err) {
+            err = metadata_err;
+        }
     }
     return err;
 }
 
+// Maps the metadata of a buffer registered with lazy metadata on first use
+static void gralloc_map_metadata_on_demand(const private_handle_t* handle)
+{
+    if (handle->base_metadata)
+        return;
+
+    pthread_mutex_lock(&sMapLock);
+    auto it = sBuffers.find(handle);
+    if (!handle->base_metadata && it != sBuffers.end() &&
+            it->second.registered) {
+        gralloc_map_metadata(handle);
+    }
+    pthread_mutex_unlock(&sMapLock);
+}
+
 static int gralloc_unmap(gralloc_module_t const* module,
                          buffer_handle_t handle)
 {
@@ -133,6 +234,17 @@ static int gralloc_unmap(gralloc_module_t const* module,
     if(!memalloc)
         return err;
 
+    int allocHandle = -1;
+    pthread_mutex_lock(&sMapLock);
+    auto it = sBuffers.find(hnd);
+    if (it != sBuffers.end()) {
+        allocHandle = it->second.allocHandle;
+        sBuffers.erase(it);
+    }
+    pthread_mutex_unlock(&sMapLock);
+    if (allocHandle >= 0)
+        memalloc->release_handle(allocHandle);
+
     if(hnd->base) {
         err = memalloc->unmap_buffer((void*)hnd->base, hnd->size, hnd->offset);
         if (err) {
@@ -160,10 +272,6 @@ static int gralloc_unmap(gralloc_module_t const* module,
 
 /*****************************************************************************/
 
-static pthread_mutex_t sMapLock = PTHREAD_MUTEX_INITIALIZER;
-
-/*****************************************************************************/
-
 int gralloc_register_buffer(gralloc_module_t const* module,
                             buffer_handle_t handle)
 {
@@ -171,10 +279,36 @@ int gralloc_register_buffer(gralloc_module_t const* module,
     if (!module || private_handle_t::validate(handle) < 0)
         return -EINVAL;
 
-    int err =  gralloc_map(module, handle);
+    private_handle_t* hnd = (private_handle_t*)handle;
+    // The metadata address is that of the process sending the handle
+    hnd->base_metadata = 0;
+    int err =  gralloc_map(module, handle, !isLazyMetadata());
     /* Do not fail register_buffer for secure buffers*/
     if (err == -EACCES)
         err = 0;
+
+    if (!err) {
+        // Keep an ion handle for lock and unlock. It belongs to this handle
+        // rather than to its fd number, which is reused once closed. On
+        // failure, each cache operation imports its own
+        int allocHandle = -1;
+        if ((hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) &&
+                (hnd->flags & private_handle_t::PRIV_FLAGS_CACHED) &&
+                getAllocator(hnd->flags)->retain_handle(hnd->fd,
+                                                        &allocHandle)) {
+            allocHandle = -1;
+        }
+
+        pthread_mutex_lock(&sMapLock);
+        buffer_state_t& state = sBuffers[hnd];
+        state.registered = true;
+        std::swap(state.allocHandle, allocHandle);
+        pthread_mutex_unlock(&sMapLock);
+
+        // A handle registered twice keeps a single allocator handle
+        if (allocHandle >= 0)
+            getAllocator(hnd->flags)->release_handle(allocHandle);
+    }
     return err;
 }
 
@@ -191,6 +325,7 @@ int gralloc_unregister_buffer(gralloc_module_t const* module,
      * NOTE: the framebuffer is handled differently and is never unmapped.
      * Also base and base_metadata are reset.
      */
+    releaseFbId((private_handle_t*)handle, false);
     return gralloc_unmap(module, handle);
 }
 
@@ -211,7 +346,8 @@ int terminateBuffer(gralloc_module_t const* module,
 }
 
 static int gralloc_map_and_invalidate (gralloc_module_t const* module,
-                                       buffer_handle_t handle, int usage)
+                                       buffer_handle_t handle, int usage,
+                                       int l, int t, int w, int h)
 {
     ATRACE_CALL();
     if (!module || private_handle_t::validate(handle) < 0)
@@ -220,15 +356,37 @@ static int gralloc_map_and_invalidate (gralloc_module_t const* module,
     int err = 0;
     private_handle_t* hnd = (private_handle_t*)handle;
     if (usage & (GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) {
+        bool cached = (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) &&
+                (hnd->flags & private_handle_t::PRIV_FLAGS_CACHED);
+        unsigned int offset = 0, size = 0;
+        getCacheRange(hnd, l, t, w, h, offset, size);
+
+        int allocHandle = -1;
+        pthread_mutex_t* const lock = &sMapLock;
+        pthread_mutex_lock(lock);
         if (hnd->base == 0) {
             // we need to map for real
-            pthread_mutex_t* const lock = &sMapLock;
-            pthread_mutex_lock(lock);
-            err = gralloc_map(module, handle);
-            pthread_mutex_unlock(lock);
+            err = gralloc_map(module, handle, true);
         }
-        if (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION and
-                hnd->flags & private_handle_t::PRIV_FLAGS_CACHED) {
+        auto it = sBuffers.find(hnd);
+        if (it != sBuffers.end())
+            allocHandle = it->second.allocHandle;
+        //Accumulate the range written by the CPU, to be cleaned on unlock
+        if (!err && cached && (usage & GRALLOC_USAGE_SW_WRITE_MASK)) {
+            buffer_state_t& state = sBuffers[hnd];
+            if (state.flushSize) {
+                unsigned int end = std::max(state.flushOffset + state.flushSize,
+                                            offset + size);
+                state.flushOffset = std::min(state.flushOffset, offset);
+                state.flushSize = end - state.flushOffset;
+            } else {
+                state.flushOffset = offset;
+                state.flushSize = size;
+            }
+        }
+        pthread_mutex_unlock(lock);
+
+        if (!err && cached) {
             //Invalidate if CPU reads in software and there are non-CPU
             //writers. No need to do this for the metadata buffer as it is
             //only read/written in software.
@@ -236,9 +394,9 @@ static int gralloc_map_and_invalidate (gralloc_module_t const* module,
                     (hnd->flags & private_handle_t::PRIV_FLAGS_NON_CPU_WRITER))
             {
                 IMemAlloc* memalloc = getAllocator(hnd->flags) ;
-                err = memalloc->clean_buffer((void*)hnd->base,
-                        hnd->size, hnd->offset, hnd->fd,
-                        CACHE_INVALIDATE);
+                err = memalloc->clean_buffer((void*)(hnd->base + offset),
+                        size, hnd->offset + offset, hnd->fd,
+                        CACHE_INVALIDATE, allocHandle);
             }
             //Mark the buffer to be flushed after CPU write.
             if (usage & GRALLOC_USAGE_SW_WRITE_MASK) {
@@ -252,12 +410,12 @@ static int gralloc_map_and_invalidate (gralloc_module_t const* module,
 
 int gralloc_lock(gralloc_module_t const* module,
                  buffer_handle_t handle, int usage,
-                 int /*l*/, int /*t*/, int /*w*/, int /*h*/,
+                 int l, int t, int w, int h,
                  void** vaddr)
 {
     ATRACE_CALL();
     private_handle_t* hnd = (private_handle_t*)handle;
-    int err = gralloc_map_and_invalidate(module, handle, usage);
+    int err = gralloc_map_and_invalidate(module, handle, usage, l, t, w, h);
     if(!err)
         *vaddr = (void*)hnd->base;
     return err;
@@ -265,14 +423,16 @@ int gralloc_lock(gralloc_module_t const* module,
 
 int gralloc_lock_ycbcr(gralloc_module_t const* module,
                  buffer_handle_t handle, int usage,
-                 int /*l*/, int /*t*/, int /*w*/, int /*h*/,
+                 int l, int t, int w, int h,
                  struct android_ycbcr *ycbcr)
 {
     ATRACE_CALL();
     private_handle_t* hnd = (private_handle_t*)handle;
-    int err = gralloc_map_and_invalidate(module, handle, usage);
-    if(!err)
+    int err = gralloc_map_and_invalidate(module, handle, usage, l, t, w, h);
+    if(!err) {
+        gralloc_map_metadata_on_demand(hnd);
         err = getYUVPlaneInfo(hnd, ycbcr);
+    }
     return err;
 }
 
@@ -288,9 +448,26 @@ int gralloc_unlock(gralloc_module_t const* module,
 
     IMemAlloc* memalloc = getAllocator(hnd->flags);
     if (hnd->flags & private_handle_t::PRIV_FLAGS_NEEDS_FLUSH) {
-        err = memalloc->clean_buffer((void*)hnd->base,
-                hnd->size, hnd->offset, hnd->fd,
-                CACHE_CLEAN);
+        unsigned int offset = 0, size = hnd->size;
+        int allocHandle = -1;
+        pthread_mutex_lock(&sMapLock);
+        auto it = sBuffers.find(hnd);
+        if (it != sBuffers.end()) {
+            allocHandle = it->second.allocHandle;
+            if (it->second.flushSize) {
+                offset = it->second.flushOffset;
+                size = it->second.flushSize;
+            }
+            it->second.flushOffset = 0;
+            it->second.flushSize = 0;
+            if (!it->second.registered)
+                sBuffers.erase(it);
+        }
+        pthread_mutex_unlock(&sMapLock);
+
+        err = memalloc->clean_buffer((void*)(hnd->base + offset),
+                size, hnd->offset + offset, hnd->fd,
+                CACHE_CLEAN, allocHandle);
         hnd->flags &= ~private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
     }
 
@@ -363,6 +540,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 if (private_handle_t::validate(hnd)) {
                     return res;
                 }
+                gralloc_map_metadata_on_demand(hnd);
 
                 int alignedw = 0, alignedh = 0;
                 AdrenoMemInfo::getInstance().getAlignedWidthAndHeight(hnd, alignedw, alignedh);
@@ -379,6 +557,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 if (private_handle_t::validate(hnd)) {
                     return res;
                 }
+                gralloc_map_metadata_on_demand(hnd);
 
                 int alignedw = 0, alignedh = 0;
                 AdrenoMemInfo::getInstance().getAlignedWidthAndHeight(hnd, alignedw, alignedh);
@@ -410,6 +589,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 if (private_handle_t::validate(hnd)) {
                     return res;
                 }
+                gralloc_map_metadata_on_demand(hnd);
                 MetaData_t *metadata = (MetaData_t *)hnd->base_metadata;
                 if (!metadata) {
                     break;
@@ -445,6 +625,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 private_handle_t* hnd =  va_arg(args, private_handle_t*);
                 android_ycbcr* ycbcr = va_arg(args, struct android_ycbcr *);
                 if (!private_handle_t::validate(hnd)) {
+                    gralloc_map_metadata_on_demand(hnd);
                     res = getYUVPlaneInfo(hnd, ycbcr);
                 }
             } break;
@@ -456,6 +637,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 if (private_handle_t::validate(hnd)) {
                     return res;
                 }
+                gralloc_map_metadata_on_demand(hnd);
                 MetaData_t *metadata = (MetaData_t *)hnd->base_metadata;
                 if(metadata && metadata->operation & MAP_SECURE_BUFFER) {
                     *map_secure_buffer = metadata->mapSecureBuffer;
@@ -472,6 +654,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 if (private_handle_t::validate(hnd)) {
                     return res;
                 }
+                gralloc_map_metadata_on_demand(hnd);
                 *flag = hnd->flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED;
                 MetaData_t *metadata = (MetaData_t *)hnd->base_metadata;
                 if (metadata && (metadata->operation & LINEAR_FORMAT)) {
@@ -494,6 +677,7 @@ int gralloc_perform(struct gralloc_module_t const* module,
                 private_handle_t* hnd = va_arg(args, private_handle_t*);
                 uint32_t *igc = va_arg(args, uint32_t *);
                 if (!private_handle_t::validate(hnd) && igc) {
+                    gralloc_map_metadata_on_demand(hnd);
                     MetaData_t *metadata = (MetaData_t *)hnd->base_metadata;
                     if (metadata && (metadata->operation & SET_IGC)) {
                         *igc = metadata->igc;
@@ -515,6 +699,14 @@ int gralloc_perform(struct gralloc_module_t const* module,
                     res = 0;
                 }
             } break;
+        case GRALLOC_MODULE_PERFORM_GET_FB_ID:
+            {
+                private_handle_t* hnd =  va_arg(args, private_handle_t*);
+                unsigned int *fb_id = va_arg(args, unsigned int*);
+                if (!private_handle_t::validate(hnd)) {
+                    res = getFbId(hnd, fb_id);
+                }
+            } break;
         default:
             break;
     }
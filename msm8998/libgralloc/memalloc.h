@@ -48,6 +48,7 @@ struct alloc_data {
     unsigned int   align;
     uintptr_t      pHandle;
     bool           uncached;
+    bool           prefault;
     unsigned int   flags;
     unsigned int   heapId;
     int            allocType;
@@ -73,9 +74,17 @@ class IMemAlloc {
     virtual int unmap_buffer(void *base, unsigned int size,
                              unsigned int offset) = 0;
 
-    // Clean and invalidate
+    // Clean and invalidate. A handle of -1 imports one just for the call
     virtual int clean_buffer(void *base, unsigned int size,
-                             unsigned int offset, int fd, int op) = 0;
+                             unsigned int offset, int fd, int op,
+                             int handle) = 0;
+
+    // Get an allocator handle to the buffer behind fd, so that cache
+    // maintenance needs no import per call. Owned by the caller
+    virtual int retain_handle(int fd, int *handle) = 0;
+
+    // Drop a handle returned by retain_handle
+    virtual void release_handle(int handle) = 0;
 
     // Destructor
     virtual ~IMemAlloc() {};
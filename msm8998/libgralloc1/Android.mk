@@ -20,10 +20,55 @@ LOCAL_CLANG                   := true
 LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps) $(kernel_deps)
 LOCAL_SRC_FILES               := gr_utils.cpp \
                                  gr_ion_alloc.cpp \
+                                 gr_ion_device.cpp \
                                  gr_adreno_info.cpp \
                                  gr_allocator.cpp \
                                  gr_buf_mgr.cpp \
+                                 gr_telemetry.cpp \
+                                 gr_fill_pool.cpp \
                                  gr_device_impl.cpp
 LOCAL_COPY_HEADERS_TO         := $(common_header_export_path)
 LOCAL_COPY_HEADERS            := gr_device_impl.h gralloc_priv.h gr_priv_handle.h
 include $(BUILD_SHARED_LIBRARY)
+
+# Replays a buffer operation trace captured with debug.gralloc.trace_ops
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := gralloc_replay
+LOCAL_PROPRIETARY_MODULE      := true
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes)
+LOCAL_SHARED_LIBRARIES        := $(common_libs)
+LOCAL_CFLAGS                  := $(common_flags) -DLOG_TAG=\"qdgralloc_replay\" -Wall -std=c++11 -Werror -Wno-sign-conversion
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(common_deps)
+LOCAL_SRC_FILES               := gr_replay.cpp
+include $(BUILD_EXECUTABLE)
+
+# Host build of the replay tool, allocating from an in-process ION device
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                  := gralloc_replay
+LOCAL_MODULE_TAGS             := optional
+LOCAL_C_INCLUDES              := $(common_includes) \
+                                 hardware/libhardware/include \
+                                 system/core/libsync/include
+LOCAL_STATIC_LIBRARIES        := libutils libcutils liblog
+LOCAL_LDLIBS                  := -ldl -lpthread
+LOCAL_CFLAGS                  := -DLOG_TAG=\"qdgralloc_replay\" -Wall -std=c++11 -Werror -Wno-sign-conversion \
+                                 -Wno-missing-field-initializers -Wno-multichar
+LOCAL_CFLAGS                  += -isystem  $(kernel_includes)
+LOCAL_CLANG                   := true
+LOCAL_ADDITIONAL_DEPENDENCIES := $(kernel_deps)
+LOCAL_SRC_FILES               := gr_utils.cpp \
+                                 gr_ion_alloc.cpp \
+                                 gr_fake_ion.cpp \
+                                 gr_adreno_info.cpp \
+                                 gr_allocator.cpp \
+                                 gr_buf_mgr.cpp \
+                                 gr_telemetry.cpp \
+                                 gr_fill_pool.cpp \
+                                 gr_device_impl.cpp \
+                                 ../libqdutils/qdMetaData.cpp \
+                                 gr_replay.cpp
+include $(BUILD_HOST_EXECUTABLE)
@@ -54,8 +54,13 @@ bool AdrenoMemInfo::Init() {
     *reinterpret_cast<void **>(&LINK_adreno_get_gpu_pixel_alignment) =
         ::dlsym(libadreno_utils_, "get_gpu_pixel_alignment");
   } else {
+#ifdef __ANDROID__
     ALOGE(" Failed to load libadreno_utils.so");
     return false;
+#else
+    // Host builds have no GPU library and fall back to the default alignments
+    ALOGW(" libadreno_utils.so not found, using default alignments");
+#endif
   }
 
   // Check if the overriding property debug.gralloc.gfx_ubwc_disable_
@@ -28,6 +28,7 @@
  */
 
 #include <cutils/log.h>
+#include <stdio.h>
 #include <algorithm>
 #include <vector>
 
@@ -88,9 +89,54 @@ bool Allocator::Init() {
     return false;
   }
 
+  PrewarmLayoutCache();
+
   return true;
 }
 
+// Fill the layout cache with the buffers SurfaceFlinger allocates for the primary display
+void Allocator::PrewarmLayoutCache() {
+  FILE *fp = fopen("/sys/class/graphics/fb0/modes", "r");
+  if (!fp) {
+    return;
+  }
+
+  int width = 0, height = 0;
+  int count = fscanf(fp, "%*c:%dx%d", &width, &height);
+  fclose(fp);
+  if (count != 2 || width <= 0 || height <= 0) {
+    return;
+  }
+
+  const int formats[] = {HAL_PIXEL_FORMAT_RGBA_8888, HAL_PIXEL_FORMAT_RGBX_8888,
+                         HAL_PIXEL_FORMAT_RGB_565};
+  const struct {
+    gralloc1_producer_usage_t prod_usage;
+    gralloc1_consumer_usage_t cons_usage;
+  } usages[] = {
+    // Application windows
+    {GRALLOC1_PRODUCER_USAGE_GPU_RENDER_TARGET,
+     static_cast<gralloc1_consumer_usage_t>(GRALLOC1_CONSUMER_USAGE_GPU_TEXTURE |
+                                            GRALLOC1_CONSUMER_USAGE_HWCOMPOSER)},
+    // Client target
+    {GRALLOC1_PRODUCER_USAGE_GPU_RENDER_TARGET,
+     static_cast<gralloc1_consumer_usage_t>(GRALLOC1_CONSUMER_USAGE_HWCOMPOSER |
+                                            GRALLOC1_CONSUMER_USAGE_CLIENT_TARGET)},
+  };
+
+  for (auto format : formats) {
+    for (auto &usage : usages) {
+      unsigned int size, alignedw, alignedh;
+      BufferDescriptor descriptor(width, height, format, usage.prod_usage, usage.cons_usage);
+      GetBufferSizeAndDimensions(descriptor, &size, &alignedw, &alignedh);
+    }
+  }
+}
+
+void Allocator::GetLayoutCacheStats(uint64_t *hits, uint64_t *misses) {
+  layout_cache_.GetStats(hits, misses);
+}
+
 Allocator::~Allocator() {
   if (ion_allocator_) {
     delete ion_allocator_;
@@ -105,6 +151,9 @@ int Allocator::AllocateMem(AllocData *alloc_data, gralloc1_producer_usage_t prod
                            gralloc1_consumer_usage_t cons_usage) {
   int ret;
   alloc_data->uncached = UseUncached(prod_usage);
+  alloc_data->zero_fill = prod_usage & GRALLOC1_PRODUCER_USAGE_PRIVATE_ZERO_FILL;
+  alloc_data->prefault = alloc_data->zero_fill ||
+                         (prod_usage & GRALLOC1_PRODUCER_USAGE_PRIVATE_PREFAULT);
 
   // After this point we should have the right heap set, there is no fallback
   GetIonHeapInfo(prod_usage, cons_usage, &alloc_data->heap_id, &alloc_data->alloc_type,
@@ -138,9 +187,18 @@ int Allocator::FreeBuffer(void *base, unsigned int size, unsigned int offset, in
   return -EINVAL;
 }
 
-int Allocator::CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op) {
+int Allocator::ImportBuffer(int fd, int *handle) {
+  if (ion_allocator_) {
+    return ion_allocator_->ImportBuffer(fd, handle);
+  }
+
+  return -EINVAL;
+}
+
+int Allocator::CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op,
+                           int handle) {
   if (ion_allocator_) {
-    return ion_allocator_->CleanBuffer(base, size, offset, fd, op);
+    return ion_allocator_->CleanBuffer(base, size, offset, fd, op, handle);
   }
 
   return -EINVAL;
@@ -292,9 +350,20 @@ void Allocator::GetBufferSizeAndDimensions(int width, int height, int format, un
 
 void Allocator::GetBufferSizeAndDimensions(const BufferDescriptor &descriptor, unsigned int *size,
                                            unsigned int *alignedw, unsigned int *alignedh) {
-  GetAlignedWidthAndHeight(descriptor, alignedw, alignedh);
+  BufferLayout layout;
+  bool found = layout_cache_.Find(descriptor, &layout);
+  if (!found || !layout.has_size) {
+    if (!found) {
+      ComputeAlignedWidthAndHeight(descriptor, &layout.alignedw, &layout.alignedh);
+    }
+    layout.size = GetSize(descriptor, layout.alignedw, layout.alignedh);
+    layout.has_size = true;
+    layout_cache_.Insert(descriptor, layout);
+  }
 
-  *size = GetSize(descriptor, *alignedw, *alignedh);
+  *alignedw = layout.alignedw;
+  *alignedh = layout.alignedh;
+  *size = layout.size;
 }
 
 void Allocator::GetYuvUbwcSPPlaneInfo(uint64_t base, uint32_t width, uint32_t height,
@@ -345,7 +414,6 @@ int Allocator::GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr
   int format = hnd->format;
   gralloc1_producer_usage_t prod_usage = hnd->GetProducerUsage();
   gralloc1_consumer_usage_t cons_usage = hnd->GetConsumerUsage();
-  unsigned int ystride, cstride;
 
   memset(ycbcr->reserved, 0, sizeof(ycbcr->reserved));
   MetaData_t *metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
@@ -369,6 +437,34 @@ int Allocator::GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr
     GetAlignedWidthAndHeight(descriptor, &width, &height);
   }
 
+  BufferDescriptor key(INT(width), INT(height), format);
+  struct android_ycbcr layout;
+  if (!plane_cache_.Find(key, &layout)) {
+    memset(&layout, 0, sizeof(layout));
+    err = GetYUVPlaneLayout(width, height, format, &layout);
+    if (err) {
+      return err;
+    }
+    plane_cache_.Insert(key, layout);
+  }
+
+  // The cached plane addresses are offsets from the start of the buffer
+  ycbcr->y = reinterpret_cast<void *>(hnd->base + reinterpret_cast<uintptr_t>(layout.y));
+  ycbcr->cb = reinterpret_cast<void *>(hnd->base + reinterpret_cast<uintptr_t>(layout.cb));
+  ycbcr->cr = reinterpret_cast<void *>(hnd->base + reinterpret_cast<uintptr_t>(layout.cr));
+  ycbcr->ystride = layout.ystride;
+  ycbcr->cstride = layout.cstride;
+  ycbcr->chroma_step = layout.chroma_step;
+
+  return 0;
+}
+
+int Allocator::GetYUVPlaneLayout(uint32_t width, uint32_t height, int format,
+                                 struct android_ycbcr *ycbcr) {
+  int err = 0;
+  uint64_t base = 0;
+  unsigned int ystride, cstride;
+
   // Get the chroma offsets from the handle width/height. We take advantage
   // of the fact the width _is_ the stride
   switch (format) {
@@ -378,20 +474,20 @@ int Allocator::GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr
     case HAL_PIXEL_FORMAT_YCbCr_420_SP_VENUS:
     case HAL_PIXEL_FORMAT_NV12_ENCODEABLE:
       // Same as YCbCr_420_SP_VENUS
-      GetYuvSPPlaneInfo(hnd->base, width, height, 1, ycbcr);
+      GetYuvSPPlaneInfo(base, width, height, 1, ycbcr);
       break;
 
     case HAL_PIXEL_FORMAT_YCbCr_420_P010:
-      GetYuvSPPlaneInfo(hnd->base, width, height, 2, ycbcr);
+      GetYuvSPPlaneInfo(base, width, height, 2, ycbcr);
       break;
 
     case HAL_PIXEL_FORMAT_YCbCr_420_SP_VENUS_UBWC:
-      GetYuvUbwcSPPlaneInfo(hnd->base, width, height, COLOR_FMT_NV12_UBWC, ycbcr);
+      GetYuvUbwcSPPlaneInfo(base, width, height, COLOR_FMT_NV12_UBWC, ycbcr);
       ycbcr->chroma_step = 2;
       break;
 
     case HAL_PIXEL_FORMAT_YCbCr_420_TP10_UBWC:
-      GetYuvUbwcSPPlaneInfo(hnd->base, width, height, COLOR_FMT_NV12_BPP10_UBWC, ycbcr);
+      GetYuvUbwcSPPlaneInfo(base, width, height, COLOR_FMT_NV12_BPP10_UBWC, ycbcr);
       ycbcr->chroma_step = 3;
       break;
 
@@ -402,7 +498,7 @@ int Allocator::GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr
     case HAL_PIXEL_FORMAT_NV21_ZSL:
     case HAL_PIXEL_FORMAT_RAW16:
     case HAL_PIXEL_FORMAT_RAW10:
-      GetYuvSPPlaneInfo(hnd->base, width, height, 1, ycbcr);
+      GetYuvSPPlaneInfo(base, width, height, 1, ycbcr);
       std::swap(ycbcr->cb, ycbcr->cr);
       break;
 
@@ -410,9 +506,9 @@ int Allocator::GetYUVPlaneInfo(const private_handle_t *hnd, struct android_ycbcr
     case HAL_PIXEL_FORMAT_YV12:
       ystride = width;
       cstride = ALIGN(width / 2, 16);
-      ycbcr->y = reinterpret_cast<void *>(hnd->base);
-      ycbcr->cr = reinterpret_cast<void *>(hnd->base + ystride * height);
-      ycbcr->cb = reinterpret_cast<void *>(hnd->base + ystride * height + cstride * height / 2);
+      ycbcr->y = reinterpret_cast<void *>(base);
+      ycbcr->cr = reinterpret_cast<void *>(base + ystride * height);
+      ycbcr->cb = reinterpret_cast<void *>(base + ystride * height + cstride * height / 2);
       ycbcr->ystride = ystride;
       ycbcr->cstride = cstride;
       ycbcr->chroma_step = 1;
@@ -732,6 +828,18 @@ int Allocator::GetRgbDataAddress(private_handle_t *hnd, void **rgb_data) {
 
 void Allocator::GetAlignedWidthAndHeight(const BufferDescriptor &descriptor, unsigned int *alignedw,
                                          unsigned int *alignedh) {
+  BufferLayout layout;
+  if (!layout_cache_.Find(descriptor, &layout)) {
+    ComputeAlignedWidthAndHeight(descriptor, &layout.alignedw, &layout.alignedh);
+    layout_cache_.Insert(descriptor, layout);
+  }
+
+  *alignedw = layout.alignedw;
+  *alignedh = layout.alignedh;
+}
+
+void Allocator::ComputeAlignedWidthAndHeight(const BufferDescriptor &descriptor,
+                                             unsigned int *alignedw, unsigned int *alignedh) {
   int width = descriptor.GetWidth();
   int height = descriptor.GetHeight();
   int format = descriptor.GetFormat();
@@ -42,9 +42,17 @@
 #include "gr_buf_descriptor.h"
 #include "gr_adreno_info.h"
 #include "gr_ion_alloc.h"
+#include "gr_layout_cache.h"
 
 namespace gralloc1 {
 
+struct BufferLayout {
+  unsigned int alignedw = 0;
+  unsigned int alignedh = 0;
+  unsigned int size = 0;
+  bool has_size = false;
+};
+
 class Allocator {
  public:
   Allocator();
@@ -52,7 +60,8 @@ class Allocator {
   bool Init();
   int MapBuffer(void **base, unsigned int size, unsigned int offset, int fd);
   int FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd, int handle);
-  int CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op);
+  int ImportBuffer(int fd, int *handle);
+  int CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op, int handle);
   int AllocateMem(AllocData *data, gralloc1_producer_usage_t prod_usage,
                   gralloc1_consumer_usage_t cons_usage);
   // @return : index of the descriptor with maximum buffer size req
@@ -75,8 +84,14 @@ class Allocator {
   bool IsUBwcSupported(int format);
   bool IsUBwcEnabled(int format, gralloc1_producer_usage_t prod_usage,
                      gralloc1_consumer_usage_t cons_usage);
+  void GetLayoutCacheStats(uint64_t *hits, uint64_t *misses);
 
  private:
+  void ComputeAlignedWidthAndHeight(const BufferDescriptor &d, unsigned int *aligned_w,
+                                    unsigned int *aligned_h);
+  int GetYUVPlaneLayout(uint32_t width, uint32_t height, int format,
+                        struct android_ycbcr *ycbcr);
+  void PrewarmLayoutCache();
   void GetYuvUBwcWidthAndHeight(int width, int height, int format, unsigned int *aligned_w,
                                 unsigned int *aligned_h);
   void GetYuvSPPlaneInfo(uint64_t base, uint32_t width, uint32_t height, uint32_t bpp,
@@ -92,6 +107,9 @@ class Allocator {
 
   IonAlloc *ion_allocator_ = NULL;
   AdrenoMemInfo *adreno_helper_ = NULL;
+  // Aligned dimensions and size per descriptor, YUV plane offsets per aligned geometry
+  LayoutCache<BufferLayout> layout_cache_{64};
+  LayoutCache<struct android_ycbcr> plane_cache_{32};
 };
 
 }  // namespace gralloc1
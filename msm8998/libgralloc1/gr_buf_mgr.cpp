@@ -17,6 +17,10 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
+#include <algorithm>
+#include <sstream>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -47,6 +51,12 @@ BufferManager::BufferManager() : next_id_(0) {
     ubwc_for_fb_ = true;
   }
 
+  // Capture the most recent buffer operations for offline replay
+  if (property_get("debug.gralloc.trace_ops", property, NULL) > 0) {
+    int capacity = atoi(property);
+    telemetry_.EnableTrace(capacity > 0 ? size_t(capacity) : 0);
+  }
+
   handles_map_.clear();
   allocator_ = new Allocator();
   allocator_->Init();
@@ -82,6 +92,7 @@ BufferManager::~BufferManager() {
 gralloc1_error_t BufferManager::AllocateBuffers(uint32_t num_descriptors,
                                                 const gralloc1_buffer_descriptor_t *descriptor_ids,
                                                 buffer_handle_t *out_buffers) {
+  uint64_t start_ns = BufferTelemetry::Now();
   bool shared = true;
   gralloc1_error_t status = GRALLOC1_ERROR_NONE;
 
@@ -113,12 +124,20 @@ gralloc1_error_t BufferManager::AllocateBuffers(uint32_t num_descriptors,
   ssize_t max_buf_index = -1;
   shared = allocator_->CheckForBufferSharing(num_descriptors, descriptors, &max_buf_index);
 
+  // Buffers explicitly asking for it are carved out of one allocation rather than aliased
+  bool sub_alloc = shared && CanSubAllocate(descriptors);
+
   if (test_allocate) {
-    status = shared ? GRALLOC1_ERROR_NOT_SHARED : status;
+    status = (shared || sub_alloc) ? GRALLOC1_ERROR_NOT_SHARED : status;
     return status;
   }
 
-  if (shared && (max_buf_index >= 0)) {
+  if (sub_alloc) {
+    if (AllocateBufferSet(descriptors, out_buffers)) {
+      return GRALLOC1_ERROR_NO_RESOURCES;
+    }
+    shared = false;
+  } else if (shared && (max_buf_index >= 0)) {
     // Allocate one and duplicate/copy the handles for each descriptor
     if (AllocateBuffer(*descriptors[UINT(max_buf_index)], &out_buffers[max_buf_index])) {
       return GRALLOC1_ERROR_NO_RESOURCES;
@@ -142,7 +161,21 @@ gralloc1_error_t BufferManager::AllocateBuffers(uint32_t num_descriptors,
     }
   }
 
-  // Allocation is successful. If backstore is not shared inform the client.
+  // Allocation is successful, the latency of the call is split over the buffers it produced.
+  // CreateSharedHandle does not fill the other handles, so only one is recorded when shared.
+  if (shared && (max_buf_index >= 0)) {
+    RecordOp(BufferTelemetry::kAllocate,
+             reinterpret_cast<const private_handle_t *>(out_buffers[max_buf_index]),
+             BufferTelemetry::Now() - start_ns);
+  } else {
+    uint64_t latency_ns = (BufferTelemetry::Now() - start_ns) / num_descriptors;
+    for (i = 0; i < num_descriptors; i++) {
+      RecordOp(BufferTelemetry::kAllocate,
+               reinterpret_cast<const private_handle_t *>(out_buffers[i]), latency_ns);
+    }
+  }
+
+  // If backstore is not shared inform the client.
   if (!shared) {
     return GRALLOC1_ERROR_NOT_SHARED;
   }
@@ -184,16 +217,146 @@ void BufferManager::CreateSharedHandle(buffer_handle_t inbuffer, const BufferDes
   *outbuffer = out_hnd;
 }
 
+bool BufferManager::CanSubAllocate(
+    const std::vector<std::shared_ptr<BufferDescriptor>> &descriptors) {
+  if (descriptors.size() < 2) {
+    return false;
+  }
+
+  bool uncached = allocator_->UseUncached(descriptors[0]->GetProducerUsage());
+  for (auto &descriptor : descriptors) {
+    gralloc1_producer_usage_t prod_usage = descriptor->GetProducerUsage();
+    if (!(prod_usage & GRALLOC1_PRODUCER_USAGE_PRIVATE_SUB_ALLOC) ||
+        allocator_->UseUncached(prod_usage) != uncached) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Allocates the buffers and their metadata from one ION allocation each. Every buffer gets its
+// own dup of the fds and addresses its slice through offset / offset_metadata, so it is
+// imported and mapped by other processes like any other buffer.
+int BufferManager::AllocateBufferSet(
+    const std::vector<std::shared_ptr<BufferDescriptor>> &descriptors,
+    buffer_handle_t *out_buffers) {
+  auto page_size = UINT(getpagesize());
+  unsigned int meta_size = ALIGN(UINT(sizeof(MetaData_t)), page_size);
+  size_t count = descriptors.size();
+  std::vector<unsigned int> sizes(count), offsets(count), widths(count), heights(count);
+  auto set = std::make_shared<BufferSet>(allocator_);
+
+  // Lay the buffers out back to back, each at its own data alignment
+  set->data.align = page_size;
+  for (size_t i = 0; i < count; i++) {
+    const BufferDescriptor &descriptor = *descriptors[i];
+    // Every slice starts on a page so that it can be mapped on its own
+    unsigned int align = std::max(page_size,
+                                  GetDataAlignment(descriptor.GetFormat(),
+                                                   descriptor.GetProducerUsage(),
+                                                   descriptor.GetConsumerUsage()));
+    allocator_->GetBufferSizeAndDimensions(descriptor, &sizes[i], &widths[i], &heights[i]);
+    offsets[i] = ALIGN(set->data.size, align);
+    set->data.size = offsets[i] + ALIGN(sizes[i], align);
+    set->data.align = std::max(set->data.align, align);
+  }
+
+  gralloc1_producer_usage_t prod_usage = descriptors[0]->GetProducerUsage();
+  gralloc1_consumer_usage_t cons_usage = descriptors[0]->GetConsumerUsage();
+  set->data.handle = (uintptr_t)out_buffers;
+  set->data.uncached = allocator_->UseUncached(prod_usage);
+  int err = allocator_->AllocateMem(&set->data, prod_usage, cons_usage);
+  if (err) {
+    ALOGE("gralloc failed to allocate buffer set err=%s", strerror(-err));
+    return err;
+  }
+
+  set->e_data.size = UINT(count) * meta_size;
+  set->e_data.handle = set->data.handle;
+  set->e_data.align = page_size;
+  err = allocator_->AllocateMem(&set->e_data, GRALLOC1_PRODUCER_USAGE_NONE,
+                                GRALLOC1_CONSUMER_USAGE_NONE);
+  if (err) {
+    ALOGE("gralloc failed to allocate buffer set metadata error=%s", strerror(-err));
+    return err;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const BufferDescriptor &descriptor = *descriptors[i];
+    int format = descriptor.GetFormat();
+    int flags = GetHandleFlags(format, descriptor.GetProducerUsage(),
+                               descriptor.GetConsumerUsage());
+    flags |= set->data.alloc_type | private_handle_t::PRIV_FLAGS_SUB_ALLOCATED;
+
+    // The first buffer takes over the fds returned by the allocation
+    private_handle_t *hnd = new private_handle_t(i ? dup(set->data.fd) : set->data.fd,
+                                                 i ? dup(set->e_data.fd) : set->e_data.fd,
+                                                 flags,
+                                                 INT(widths[i]),
+                                                 INT(heights[i]),
+                                                 descriptor.GetWidth(),
+                                                 descriptor.GetHeight(),
+                                                 format,
+                                                 GetBufferType(format),
+                                                 sizes[i],
+                                                 descriptor.GetProducerUsage(),
+                                                 descriptor.GetConsumerUsage());
+
+    hnd->id = ++next_id_;
+    hnd->offset = offsets[i];
+    hnd->offset_metadata = UINT(i) * meta_size;
+    if (set->data.base) {
+      hnd->base = reinterpret_cast<uint64_t>(set->data.base) + offsets[i];
+    }
+    hnd->base_metadata = reinterpret_cast<uint64_t>(set->e_data.base) + hnd->offset_metadata;
+    mapped_bytes_ += (hnd->base ? hnd->size : 0) + meta_size;
+
+    ColorSpace_t colorSpace = ITU_R_601;
+    setMetaData(hnd, UPDATE_COLOR_SPACE, reinterpret_cast<void *>(&colorSpace));
+    out_buffers[i] = hnd;
+    auto buffer = std::make_shared<Buffer>(hnd);
+    buffer->set = set;
+    buffer->heap_id = set->data.heap_id;
+    telemetry_.AddLiveBytes(buffer->heap_id, hnd->size);
+    handles_map_.emplace(std::make_pair(hnd, buffer));
+  }
+
+  // The fds are owned by the handles now
+  set->data.fd = -1;
+  set->e_data.fd = -1;
+
+  return 0;
+}
+
+BufferManager::BufferSet::~BufferSet() {
+  if (data.ion_handle >= 0) {
+    allocator->FreeBuffer(data.base, data.size, data.offset, data.fd, data.ion_handle);
+  }
+
+  if (e_data.ion_handle >= 0) {
+    allocator->FreeBuffer(e_data.base, e_data.size, e_data.offset, e_data.fd, e_data.ion_handle);
+  }
+}
+
 gralloc1_error_t BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf) {
+  uint64_t start_ns = BufferTelemetry::Now();
   auto hnd = buf->handle;
-  if (allocator_->FreeBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
-                             hnd->fd, buf->ion_handle_main) != 0) {
+  telemetry_.RemoveLiveBytes(buf->heap_id, hnd->size);
+  unsigned int meta_size = ALIGN((unsigned int)sizeof(MetaData_t), PAGE_SIZE);
+  mapped_bytes_ -= (hnd->base ? hnd->size : 0) + (hnd->base_metadata ? meta_size : 0);
+
+  // A sub-allocated buffer only drops its fds, the mapping goes away with the set
+  void *base = buf->set ? nullptr : reinterpret_cast<void *>(hnd->base);
+  void *base_metadata = buf->set ? nullptr : reinterpret_cast<void *>(hnd->base_metadata);
+  buf->set.reset();
+
+  if (allocator_->FreeBuffer(base, hnd->size, hnd->offset, hnd->fd, buf->ion_handle_main) != 0) {
     return GRALLOC1_ERROR_BAD_HANDLE;
   }
 
-  unsigned int meta_size = ALIGN((unsigned int)sizeof(MetaData_t), PAGE_SIZE);
-  if (allocator_->FreeBuffer(reinterpret_cast<void *>(hnd->base_metadata), meta_size,
-                             hnd->offset_metadata, hnd->fd_metadata, buf->ion_handle_meta) != 0) {
+  if (allocator_->FreeBuffer(base_metadata, meta_size, hnd->offset_metadata, hnd->fd_metadata,
+                             buf->ion_handle_meta) != 0) {
     return GRALLOC1_ERROR_BAD_HANDLE;
   }
 
@@ -202,29 +365,97 @@ gralloc1_error_t BufferManager::FreeBuffer(std::shared_ptr<Buffer> buf) {
   private_handle_t * handle = const_cast<private_handle_t *>(hnd);
   handle->fd = -1;
   handle->fd_metadata = -1;
+  RecordOp(BufferTelemetry::kFree, hnd, BufferTelemetry::Now() - start_ns);
   return GRALLOC1_ERROR_NONE;
 }
 
+void BufferManager::RecordOp(BufferTelemetry::Op op, const private_handle_t *hnd,
+                             uint64_t latency_ns) {
+  telemetry_.Record(op, hnd->format, hnd->GetProducerUsage(), hnd->GetConsumerUsage(), hnd->size,
+                    latency_ns);
+  telemetry_.Trace(op, hnd->id, hnd->unaligned_width, hnd->unaligned_height, hnd->format,
+                   hnd->GetProducerUsage(), hnd->GetConsumerUsage(), hnd->size, latency_ns,
+                   gralloc1_rect_t());
+}
+
+// The telemetry counts the lock against the usage class of the buffer, the trace keeps what the
+// client asked for so that a replay locks the same way.
+void BufferManager::RecordLock(const private_handle_t *hnd, gralloc1_producer_usage_t prod_usage,
+                               gralloc1_consumer_usage_t cons_usage,
+                               const gralloc1_rect_t &region, uint64_t latency_ns) {
+  telemetry_.Record(BufferTelemetry::kLock, hnd->format, hnd->GetProducerUsage(),
+                    hnd->GetConsumerUsage(), hnd->size, latency_ns);
+  telemetry_.Trace(BufferTelemetry::kLock, hnd->id, hnd->unaligned_width, hnd->unaligned_height,
+                   hnd->format, prod_usage, cons_usage, hnd->size, latency_ns, region);
+}
+
 gralloc1_error_t BufferManager::MapBuffer(private_handle_t const *handle) {
   private_handle_t *hnd = const_cast<private_handle_t *>(handle);
 
+  // Only slices of a buffer set start inside the fd, the offset of other handles is not
+  // guaranteed to be page aligned.
+  bool sub_allocated = hnd->flags & private_handle_t::PRIV_FLAGS_SUB_ALLOCATED;
   hnd->base = 0;
-  hnd->base_metadata = 0;
-  if (allocator_->MapBuffer(reinterpret_cast<void **>(&hnd->base), hnd->size, hnd->offset,
-                            hnd->fd) != 0) {
+  if (allocator_->MapBuffer(reinterpret_cast<void **>(&hnd->base), hnd->size,
+                            sub_allocated ? hnd->offset : 0, hnd->fd) != 0) {
+    hnd->base = 0;
     return GRALLOC1_ERROR_BAD_HANDLE;
   }
 
+  mapped_bytes_ += hnd->size;
+  return GRALLOC1_ERROR_NONE;
+}
+
+gralloc1_error_t BufferManager::MapMetaData(private_handle_t const *handle) {
+  private_handle_t *hnd = const_cast<private_handle_t *>(handle);
+
   unsigned int size = ALIGN((unsigned int)sizeof(MetaData_t), PAGE_SIZE);
+  bool sub_allocated = hnd->flags & private_handle_t::PRIV_FLAGS_SUB_ALLOCATED;
+  hnd->base_metadata = 0;
   if (allocator_->MapBuffer(reinterpret_cast<void **>(&hnd->base_metadata), size,
-                            hnd->offset_metadata, hnd->fd_metadata) != 0) {
+                            sub_allocated ? hnd->offset_metadata : 0, hnd->fd_metadata) != 0) {
+    hnd->base_metadata = 0;
     return GRALLOC1_ERROR_BAD_HANDLE;
   }
 
+  mapped_bytes_ += size;
   return GRALLOC1_ERROR_NONE;
 }
 
+// Imported buffers are mapped on first CPU access. Handles that were not retained in this
+// process are left as they are, nothing would unmap them.
+void BufferManager::MapOnDemand(const private_handle_t *hnd, bool map_data) {
+  std::lock_guard<std::mutex> lock(locker_);
+  if (handles_map_.find(hnd) == handles_map_.end()) {
+    return;
+  }
+
+  if (map_data && !hnd->base) {
+    MapBuffer(hnd);
+  }
+
+  if (!hnd->base_metadata) {
+    MapMetaData(hnd);
+  }
+}
+
+MetaData_t *BufferManager::GetMetaData(const private_handle_t *hnd) {
+  MapOnDemand(hnd, false);
+  return reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+}
+
+// UBWC allocations hold linear pixels when the producer rendered them in a linear format
+bool BufferManager::IsLinear(const private_handle_t *hnd) {
+  if (!(hnd->flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED)) {
+    return true;
+  }
+
+  MetaData_t *metadata = GetMetaData(hnd);
+  return metadata && (metadata->operation & LINEAR_FORMAT);
+}
+
 gralloc1_error_t BufferManager::RetainBuffer(private_handle_t const *hnd) {
+  uint64_t start_ns = BufferTelemetry::Now();
   std::lock_guard<std::mutex> lock(locker_);
 
   // find if this handle is already in map
@@ -235,17 +466,21 @@ gralloc1_error_t BufferManager::RetainBuffer(private_handle_t const *hnd) {
     auto buf = it->second;
     buf->ref_count++;
   } else {
-    // not present in the map. mmap and then add entry to map
-    if (MapBuffer(hnd) == GRALLOC1_ERROR_NONE) {
-      auto buffer = std::make_shared<Buffer>(hnd);
-      handles_map_.emplace(std::make_pair(hnd, buffer));
-    }
+    // Not present in the map. Compositors rarely touch the pixels, so nothing is mapped
+    // until the buffer is locked or its metadata is accessed.
+    private_handle_t *handle = const_cast<private_handle_t *>(hnd);
+    handle->base = 0;
+    handle->base_metadata = 0;
+    auto buffer = std::make_shared<Buffer>(hnd);
+    handles_map_.emplace(std::make_pair(hnd, buffer));
   }
 
+  RecordOp(BufferTelemetry::kRetain, hnd, BufferTelemetry::Now() - start_ns);
   return GRALLOC1_ERROR_NONE;
 }
 
 gralloc1_error_t BufferManager::ReleaseBuffer(private_handle_t const *hnd) {
+  uint64_t start_ns = BufferTelemetry::Now();
   std::lock_guard<std::mutex> lock(locker_);
   // find if this handle is already in map
   auto it = handles_map_.find(hnd);
@@ -261,12 +496,57 @@ gralloc1_error_t BufferManager::ReleaseBuffer(private_handle_t const *hnd) {
       FreeBuffer(buf);
     }
   }
+  RecordOp(BufferTelemetry::kRelease, hnd, BufferTelemetry::Now() - start_ns);
   return GRALLOC1_ERROR_NONE;
 }
 
+void BufferManager::GetCacheRange(const private_handle_t *hnd, const gralloc1_rect_t &region,
+                                  unsigned int *offset, unsigned int *size) {
+  *offset = 0;
+  *size = hnd->size;
+
+  // Only linear single plane buffers map a rect to one contiguous range. An empty region
+  // stands for the whole buffer.
+  if (!IsUncompressedRGBFormat(hnd->format) ||
+      (hnd->flags & private_handle_t::PRIV_FLAGS_UBWC_ALIGNED) || region.width <= 0 ||
+      region.height <= 0 || region.left < 0 || region.top < 0 ||
+      region.left + region.width > hnd->width || region.top + region.height > hnd->height) {
+    return;
+  }
+
+  unsigned int bpp = GetBppForUncompressedRGB(hnd->format);
+  unsigned int stride = UINT(hnd->width) * bpp;
+  unsigned int start = UINT(region.top) * stride + UINT(region.left) * bpp;
+  unsigned int end = UINT(region.top + region.height - 1) * stride +
+                     UINT(region.left + region.width) * bpp;
+
+  // Cache maintenance works on whole pages
+  unsigned int page_size = UINT(getpagesize());
+  start &= ~(page_size - 1);
+  end = std::min(ALIGN(end, page_size), hnd->size);
+  if (start < end) {
+    *offset = start;
+    *size = end - start;
+  }
+}
+
+// Must be called with locker_ held
+int BufferManager::GetIonHandle(Buffer *buf) {
+  if (buf->ion_handle_main < 0) {
+    int ion_handle = -1;
+    if (allocator_->ImportBuffer(buf->handle->fd, &ion_handle) == 0) {
+      buf->ion_handle_main = ion_handle;
+    }
+  }
+
+  return buf->ion_handle_main;
+}
+
 gralloc1_error_t BufferManager::LockBuffer(const private_handle_t *hnd,
                                            gralloc1_producer_usage_t prod_usage,
-                                           gralloc1_consumer_usage_t cons_usage) {
+                                           gralloc1_consumer_usage_t cons_usage,
+                                           const gralloc1_rect_t &region) {
+  uint64_t start_ns = BufferTelemetry::Now();
   gralloc1_error_t err = GRALLOC1_ERROR_NONE;
 
   // If buffer is not meant for CPU return err
@@ -274,20 +554,54 @@ gralloc1_error_t BufferManager::LockBuffer(const private_handle_t *hnd,
     return GRALLOC1_ERROR_BAD_VALUE;
   }
 
+  if ((cons_usage & GRALLOC1_CONSUMER_USAGE_PRIVATE_LINEAR_ACCESS) && !IsLinear(hnd)) {
+    return GRALLOC1_ERROR_UNSUPPORTED;
+  }
+
+  bool cached = (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) &&
+                (hnd->flags & private_handle_t::PRIV_FLAGS_CACHED);
+  unsigned int offset = 0, size = 0;
+  GetCacheRange(hnd, region, &offset, &size);
+
+  int ion_handle = -1;
+  locker_.lock();
   if (hnd->base == 0) {
     // we need to map for real
-    locker_.lock();
     err = MapBuffer(hnd);
-    locker_.unlock();
   }
 
+  // The plane layout of a locked buffer may be read from its metadata
+  if (!err && hnd->base_metadata == 0) {
+    err = MapMetaData(hnd);
+  }
+
+  auto it = handles_map_.find(hnd);
+  if (!err && it != handles_map_.end()) {
+    auto buf = it->second;
+    if (cached) {
+      ion_handle = GetIonHandle(buf.get());
+    }
+
+    // Accumulate the CPU written range to be flushed on unlock
+    if (CpuCanWrite(prod_usage)) {
+      if (buf->flush_size) {
+        unsigned int end = std::max(buf->flush_offset + buf->flush_size, offset + size);
+        buf->flush_offset = std::min(buf->flush_offset, offset);
+        buf->flush_size = end - buf->flush_offset;
+      } else {
+        buf->flush_offset = offset;
+        buf->flush_size = size;
+      }
+    }
+  }
+  locker_.unlock();
+
   // Invalidate if CPU reads in software and there are non-CPU
   // writers. No need to do this for the metadata buffer as it is
   // only read/written in software.
-  if (!err && (hnd->flags & private_handle_t::PRIV_FLAGS_USES_ION) &&
-      (hnd->flags & private_handle_t::PRIV_FLAGS_CACHED)) {
-    if (allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
-                                hnd->fd, CACHE_INVALIDATE)) {
+  if (!err && cached) {
+    if (allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base + offset), size,
+                                hnd->offset + offset, hnd->fd, CACHE_INVALIDATE, ion_handle)) {
       return GRALLOC1_ERROR_BAD_HANDLE;
     }
   }
@@ -298,24 +612,47 @@ gralloc1_error_t BufferManager::LockBuffer(const private_handle_t *hnd,
     handle->flags |= private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
   }
 
+  if (!err) {
+    RecordLock(hnd, prod_usage, cons_usage, region, BufferTelemetry::Now() - start_ns);
+  }
+
   return err;
 }
 
 gralloc1_error_t BufferManager::UnlockBuffer(const private_handle_t *handle) {
+  uint64_t start_ns = BufferTelemetry::Now();
   gralloc1_error_t status = GRALLOC1_ERROR_NONE;
-
-  locker_.lock();
   private_handle_t *hnd = const_cast<private_handle_t *>(handle);
+  bool flush = false;
+  int ion_handle = -1;
+  unsigned int offset = 0, size = hnd->size;
 
+  locker_.lock();
   if (hnd->flags & private_handle_t::PRIV_FLAGS_NEEDS_FLUSH) {
-    if (allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base), hnd->size, hnd->offset,
-                                hnd->fd, CACHE_CLEAN) != 0) {
-      status = GRALLOC1_ERROR_BAD_HANDLE;
-    }
+    flush = true;
     hnd->flags &= ~private_handle_t::PRIV_FLAGS_NEEDS_FLUSH;
+    auto it = handles_map_.find(hnd);
+    if (it != handles_map_.end()) {
+      auto buf = it->second;
+      ion_handle = GetIonHandle(buf.get());
+      if (buf->flush_size) {
+        offset = buf->flush_offset;
+        size = buf->flush_size;
+      }
+      buf->flush_offset = 0;
+      buf->flush_size = 0;
+    }
   }
-
   locker_.unlock();
+
+  // The cache operation does not touch any state guarded by locker_
+  if (flush && allocator_->CleanBuffer(reinterpret_cast<void *>(hnd->base + offset), size,
+                                       hnd->offset + offset, hnd->fd, CACHE_CLEAN,
+                                       ion_handle) != 0) {
+    status = GRALLOC1_ERROR_BAD_HANDLE;
+  }
+
+  RecordOp(BufferTelemetry::kUnlock, hnd, BufferTelemetry::Now() - start_ns);
   return status;
 }
 
@@ -453,11 +790,14 @@ int BufferManager::AllocateBuffer(unsigned int size, int aligned_w, int aligned_
   hnd->id = ++next_id_;
   hnd->base = reinterpret_cast<uint64_t >(data.base);
   hnd->base_metadata = reinterpret_cast<uint64_t >(e_data.base);
+  mapped_bytes_ += (hnd->base ? hnd->size : 0) + (hnd->base_metadata ? e_data.size : 0);
 
   ColorSpace_t colorSpace = ITU_R_601;
   setMetaData(hnd, UPDATE_COLOR_SPACE, reinterpret_cast<void *>(&colorSpace));
   *handle = hnd;
   auto buffer = std::make_shared<Buffer>(hnd, data.ion_handle, e_data.ion_handle);
+  buffer->heap_id = data.heap_id;
+  telemetry_.AddLiveBytes(buffer->heap_id, hnd->size);
   handles_map_.emplace(std::make_pair(hnd, buffer));
   return err;
 }
@@ -538,6 +878,7 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
         hnd->flags = private_handle_t::PRIV_FLAGS_USES_ION;
         hnd->size = size;
         hnd->offset = offset;
+        hnd->offset_metadata = 0;
         hnd->base = uint64_t(base) + offset;
         hnd->gpuaddr = 0;
         BufferDescriptor descriptor(width, height, format);
@@ -568,7 +909,7 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
         return GRALLOC1_ERROR_BAD_HANDLE;
       }
 
-      MetaData_t *metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+      MetaData_t *metadata = GetMetaData(hnd);
       if (metadata && metadata->operation & UPDATE_BUFFER_GEOMETRY) {
         *stride = metadata->bufferDim.sliceWidth;
       } else {
@@ -585,7 +926,7 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
         return GRALLOC1_ERROR_BAD_HANDLE;
       }
 
-      MetaData_t *metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+      MetaData_t *metadata = GetMetaData(hnd);
       if (metadata && metadata->operation & UPDATE_BUFFER_GEOMETRY) {
         *stride = metadata->bufferDim.sliceWidth;
         *height = metadata->bufferDim.sliceHeight;
@@ -624,7 +965,7 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
       if (private_handle_t::validate(hnd) != 0) {
         return GRALLOC1_ERROR_BAD_HANDLE;
       }
-      MetaData_t *metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+      MetaData_t *metadata = GetMetaData(hnd);
       if (!metadata) {
         return GRALLOC1_ERROR_BAD_HANDLE;
 #ifdef USE_COLOR_METADATA
@@ -655,6 +996,7 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
       if (private_handle_t::validate(hnd) != 0) {
         return GRALLOC1_ERROR_BAD_HANDLE;
       }
+      MapOnDemand(hnd, true);
       if (allocator_->GetYUVPlaneInfo(hnd, ycbcr)) {
         return GRALLOC1_ERROR_UNDEFINED;
       }
@@ -666,7 +1008,7 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
       if (private_handle_t::validate(hnd) != 0) {
         return GRALLOC1_ERROR_BAD_HANDLE;
       }
-      MetaData_t *metadata = reinterpret_cast<MetaData_t *>(hnd->base_metadata);
+      MetaData_t *metadata = GetMetaData(hnd);
       if (metadata && metadata->operation & MAP_SECURE_BUFFER) {
         *map_secure_buffer = metadata->mapSecureBuffer;
       } else {
@@ -689,7 +1031,11 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
       if (private_handle_t::validate(hnd) != 0) {
         return GRALLOC1_ERROR_BAD_HANDLE;
       }
-      if (allocator_->GetRgbDataAddress(hnd, rgb_data)) {
+      MapOnDemand(hnd, true);
+      // A UBWC buffer rendered in a linear format has no meta plane ahead of the pixels
+      if (IsUncompressedRGBFormat(hnd->format) && IsLinear(hnd)) {
+        *rgb_data = reinterpret_cast<void *>(hnd->base);
+      } else if (allocator_->GetRgbDataAddress(hnd, rgb_data)) {
         return GRALLOC1_ERROR_UNDEFINED;
       }
     } break;
@@ -730,6 +1076,37 @@ gralloc1_error_t BufferManager::Perform(int operation, va_list args) {
       AllocateBuffer(descriptor, hnd, size);
     } break;
 
+    case GRALLOC1_MODULE_PERFORM_GET_LAYOUT_CACHE_STATS: {
+      uint64_t *hits = va_arg(args, uint64_t *);
+      uint64_t *misses = va_arg(args, uint64_t *);
+      allocator_->GetLayoutCacheStats(hits, misses);
+    } break;
+
+    case GRALLOC1_MODULE_PERFORM_GET_MAPPED_BYTES: {
+      uint64_t *mapped_bytes = va_arg(args, uint64_t *);
+      *mapped_bytes = mapped_bytes_;
+    } break;
+
+    case GRALLOC1_MODULE_PERFORM_GET_BUFFER_TELEMETRY:
+    case GRALLOC1_MODULE_PERFORM_GET_OP_TRACE: {
+      // Same contract as the gralloc1 dump, a null buffer queries the size
+      uint32_t *out_size = va_arg(args, uint32_t *);
+      char *out_buffer = va_arg(args, char *);
+      std::ostringstream os;
+      if (operation == GRALLOC1_MODULE_PERFORM_GET_OP_TRACE) {
+        telemetry_.DumpTrace(&os);
+      } else {
+        Dump(&os);
+      }
+      std::string dump = os.str();
+      if (!out_buffer) {
+        *out_size = UINT(dump.size());
+      } else {
+        *out_size = std::min(*out_size, UINT(dump.size()));
+        memcpy(out_buffer, dump.data(), *out_size);
+      }
+    } break;
+
     default:
       break;
   }
@@ -766,6 +1143,33 @@ gralloc1_error_t BufferManager::GetNumFlexPlanes(const private_handle_t *hnd,
   return GRALLOC1_ERROR_NONE;
 }
 
+void BufferManager::Dump(std::ostream *os) {
+  const size_t kLargestBuffers = 10;
+  telemetry_.Dump(os);
+
+  std::lock_guard<std::mutex> lock(locker_);
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  for (auto &it : handles_map_) {
+    buffers.push_back(it.second);
+  }
+
+  size_t count = std::min(kLargestBuffers, buffers.size());
+  std::partial_sort(buffers.begin(), buffers.begin() + INT(count), buffers.end(),
+                    [](const std::shared_ptr<Buffer> &a, const std::shared_ptr<Buffer> &b) {
+                      return a->handle->size > b->handle->size;
+                    });
+
+  char line[128];
+  *os << "Largest of " << buffers.size() << " live buffers:" << std::endl;
+  for (size_t i = 0; i < count; i++) {
+    auto hnd = buffers[i]->handle;
+    snprintf(line, sizeof(line), "  id %" PRIu64 " %dx%d format 0x%x size %u KB refs %d %s",
+             hnd->id, hnd->unaligned_width, hnd->unaligned_height, hnd->format, hnd->size / 1024,
+             buffers[i]->ref_count, buffers[i]->heap_id ? "allocated" : "imported");
+    *os << line << std::endl;
+  }
+}
+
 gralloc1_error_t BufferManager::GetFlexLayout(const private_handle_t *hnd,
                                               struct android_flex_layout *layout) {
   if (!IsYuvFormat(hnd)) {
@@ -25,10 +25,15 @@
 #include <unordered_set>
 #include <utility>
 #include <mutex>
+#include <ostream>
+#include <vector>
 
 #include "gralloc_priv.h"
 #include "gr_allocator.h"
 #include "gr_buf_descriptor.h"
+#include "gr_telemetry.h"
+
+struct MetaData_t;
 
 namespace gralloc1 {
 
@@ -43,11 +48,13 @@ class BufferManager {
   gralloc1_error_t RetainBuffer(private_handle_t const *hnd);
   gralloc1_error_t ReleaseBuffer(private_handle_t const *hnd);
   gralloc1_error_t LockBuffer(const private_handle_t *hnd, gralloc1_producer_usage_t prod_usage,
-                              gralloc1_consumer_usage_t cons_usage);
+                              gralloc1_consumer_usage_t cons_usage,
+                              const gralloc1_rect_t &region);
   gralloc1_error_t UnlockBuffer(const private_handle_t *hnd);
   gralloc1_error_t Perform(int operation, va_list args);
   gralloc1_error_t GetFlexLayout(const private_handle_t *hnd, struct android_flex_layout *layout);
   gralloc1_error_t GetNumFlexPlanes(const private_handle_t *hnd, uint32_t *out_num_planes);
+  void Dump(std::ostream *os);
 
   template <typename... Args>
   gralloc1_error_t CallBufferDescriptorFunction(gralloc1_buffer_descriptor_t descriptor_id,
@@ -71,6 +78,10 @@ class BufferManager {
  private:
   BufferManager();
   gralloc1_error_t MapBuffer(private_handle_t const *hnd);
+  gralloc1_error_t MapMetaData(private_handle_t const *hnd);
+  void MapOnDemand(const private_handle_t *hnd, bool map_data);
+  MetaData_t *GetMetaData(const private_handle_t *hnd);
+  bool IsLinear(const private_handle_t *hnd);
   int GetBufferType(int format);
   int AllocateBuffer(const BufferDescriptor &descriptor, buffer_handle_t *handle,
                      unsigned int bufferSize = 0);
@@ -84,6 +95,20 @@ class BufferManager {
                      gralloc1_consumer_usage_t cons_usage);
   void CreateSharedHandle(buffer_handle_t inbuffer, const BufferDescriptor &descriptor,
                           buffer_handle_t *out_buffer);
+  bool CanSubAllocate(const std::vector<std::shared_ptr<BufferDescriptor>> &descriptors);
+  int AllocateBufferSet(const std::vector<std::shared_ptr<BufferDescriptor>> &descriptors,
+                        buffer_handle_t *out_buffers);
+
+  // ION allocation and CPU mapping shared by the buffers carved out of it.
+  // Released along with the last of those buffers
+  struct BufferSet {
+    Allocator *allocator = nullptr;
+    AllocData data;
+    AllocData e_data;
+
+    explicit BufferSet(Allocator *alloc) : allocator(alloc) {}
+    ~BufferSet();
+  };
 
   // Wrapper structure over private handle
   // Values associated with the private handle
@@ -94,10 +119,17 @@ class BufferManager {
     const private_handle_t *handle = nullptr;
     int ref_count = 1;
     // Hold the main and metadata ion handles
-    // Freed from the allocator process
-    // and unused in the mapping process
+    // Freed from the allocator process. The mapping process
+    // imports the main handle on first cache maintenance
     int ion_handle_main = -1;
     int ion_handle_meta = -1;
+    // Byte range written by the CPU, cleaned on unlock
+    unsigned int flush_offset = 0;
+    unsigned int flush_size = 0;
+    // Backing store for sub-allocated buffers, null otherwise
+    std::shared_ptr<BufferSet> set;
+    // ION heap of buffers allocated by this process, 0 for imported ones
+    unsigned int heap_id = 0;
 
     Buffer() = delete;
     explicit Buffer(const private_handle_t* h, int ih_main = -1, int ih_meta = -1):
@@ -107,6 +139,13 @@ class BufferManager {
     }
   };
   gralloc1_error_t FreeBuffer(std::shared_ptr<Buffer> buf);
+  void GetCacheRange(const private_handle_t *hnd, const gralloc1_rect_t &region,
+                     unsigned int *offset, unsigned int *size);
+  int GetIonHandle(Buffer *buf);
+  void RecordOp(BufferTelemetry::Op op, const private_handle_t *hnd, uint64_t latency_ns);
+  void RecordLock(const private_handle_t *hnd, gralloc1_producer_usage_t prod_usage,
+                  gralloc1_consumer_usage_t cons_usage, const gralloc1_rect_t &region,
+                  uint64_t latency_ns);
 
   bool map_fb_mem_ = false;
   bool ubwc_for_fb_ = false;
@@ -119,6 +158,9 @@ class BufferManager {
   std::unordered_map<gralloc1_buffer_descriptor_t,
                      std::shared_ptr<BufferDescriptor>> descriptors_map_ = {};
   std::atomic<uint64_t> next_id_;
+  // Bytes of buffer and metadata mappings held by this process
+  std::atomic<uint64_t> mapped_bytes_ {0};
+  BufferTelemetry telemetry_;
 };
 
 }  // namespace gralloc1
@@ -179,16 +179,19 @@ gralloc1_error_t GrallocImpl::Dump(gralloc1_device_t *device, uint32_t *out_size
     ALOGE("Gralloc Error : device=%p", (void *)device);
     return GRALLOC1_ERROR_BAD_DESCRIPTOR;
   }
+  GrallocImpl const *dev = GRALLOC_IMPL(device);
+  std::ostringstream os;
+  os << "-------------------------------" << std::endl;
+  os << "QTI gralloc dump:" << std::endl;
+  os << "-------------------------------" << std::endl;
+  dev->buf_mgr_->Dump(&os);
+  std::string dump = os.str();
+
   if (out_buffer == nullptr) {
-    *out_size = 1024;
+    *out_size = static_cast<uint32_t>(dump.size());
   } else {
-    std::ostringstream os;
-    // TODO(user): implement in buffer manager
-    os << "-------------------------------" << std::endl;
-    os << "QTI gralloc dump:" << std::endl;
-    os << "-------------------------------" << std::endl;
-    auto copy_size = os.str().size() < *out_size ? os.str().size() : *out_size;
-    std::copy_n(out_buffer, copy_size, os.str().begin());
+    auto copy_size = dump.size() < *out_size ? dump.size() : *out_size;
+    std::copy_n(dump.begin(), copy_size, out_buffer);
     *out_size = static_cast<uint32_t>(copy_size);
   }
 
@@ -410,12 +413,12 @@ gralloc1_error_t GrallocImpl::LockBuffer(gralloc1_device_t *device, buffer_handl
     // return GRALLOC1_ERROR_BAD_VALUE;
   }
 
-  // currently we ignore the region/rect client wants to lock
+  // The region limits cache maintenance to the pages the client accesses
   if (region == NULL) {
     return GRALLOC1_ERROR_BAD_VALUE;
   }
   // TODO(user): Need to check if buffer was allocated with the same flags
-  status = dev->buf_mgr_->LockBuffer(hnd, prod_usage, cons_usage);
+  status = dev->buf_mgr_->LockBuffer(hnd, prod_usage, cons_usage, *region);
 
   *out_data = reinterpret_cast<void *>(hnd->base);
 
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// In-process stand-in for /dev/ion, for host builds that exercise gralloc1 without the kernel
+// driver. Buffers are backed by unlinked temporary files, so they are shared as fds and mapped
+// like ION buffers. Handles are per buffer and reference counted as in the driver, importing a
+// buffer that already has a handle returns that handle. There are no caches to maintain on the
+// host, cache operations only validate their arguments.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sync/sync.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "gr_utils.h"
+#include "gr_ion_alloc.h"
+
+namespace gralloc1 {
+
+class FakeIonDevice {
+ public:
+  static FakeIonDevice *GetInstance() {
+    static FakeIonDevice instance;
+    return &instance;
+  }
+
+  // Returns 0 or an errno value
+  int Ioctl(int request, void *arg);
+
+ private:
+  struct Buffer {
+    ~Buffer() { close(fd); }
+    int fd = -1;
+    size_t size = 0;
+    dev_t dev = 0;
+    ino_t ino = 0;
+  };
+
+  struct Handle {
+    std::shared_ptr<Buffer> buffer;
+    unsigned int ref_count = 0;
+  };
+
+  int Alloc(ion_allocation_data *data);
+  int Free(ion_handle_data *data);
+  int Share(ion_fd_data *data);
+  int Import(ion_fd_data *data);
+  int Custom(ion_custom_data *data);
+  ion_user_handle_t AddHandle(std::shared_ptr<Buffer> buffer);
+
+  std::mutex lock_;
+  std::map<ion_user_handle_t, Handle> handles_;
+  ion_user_handle_t next_handle_ = 1;
+};
+
+int FakeIonDevice::Ioctl(int request, void *arg) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (request == INT(ION_IOC_ALLOC)) {
+    return Alloc(reinterpret_cast<ion_allocation_data *>(arg));
+  } else if (request == INT(ION_IOC_FREE)) {
+    return Free(reinterpret_cast<ion_handle_data *>(arg));
+  } else if (request == INT(ION_IOC_MAP) || request == INT(ION_IOC_SHARE)) {
+    return Share(reinterpret_cast<ion_fd_data *>(arg));
+  } else if (request == INT(ION_IOC_IMPORT)) {
+    return Import(reinterpret_cast<ion_fd_data *>(arg));
+  } else if (request == INT(ION_IOC_CUSTOM)) {
+    return Custom(reinterpret_cast<ion_custom_data *>(arg));
+  }
+
+  return ENOTTY;
+}
+
+ion_user_handle_t FakeIonDevice::AddHandle(std::shared_ptr<Buffer> buffer) {
+  ion_user_handle_t handle = next_handle_++;
+  Handle &entry = handles_[handle];
+  entry.buffer = buffer;
+  entry.ref_count = 1;
+
+  return handle;
+}
+
+int FakeIonDevice::Alloc(ion_allocation_data *data) {
+  if (!data->len || !data->heap_id_mask) {
+    return EINVAL;
+  }
+
+  const char *dir = getenv("TMPDIR");
+  std::string path = std::string(dir ? dir : "/tmp") + "/gralloc_ion_XXXXXX";
+  auto buffer = std::make_shared<Buffer>();
+  buffer->fd = mkstemp(&path[0]);
+  if (buffer->fd < 0) {
+    return errno;
+  }
+
+  unlink(path.c_str());
+  struct stat st;
+  if (ftruncate(buffer->fd, off_t(data->len)) || fstat(buffer->fd, &st)) {
+    return errno;
+  }
+
+  buffer->size = data->len;
+  buffer->dev = st.st_dev;
+  buffer->ino = st.st_ino;
+  data->handle = AddHandle(buffer);
+
+  return 0;
+}
+
+int FakeIonDevice::Free(ion_handle_data *data) {
+  auto it = handles_.find(data->handle);
+  if (it == handles_.end()) {
+    return EINVAL;
+  }
+
+  if (--it->second.ref_count == 0) {
+    handles_.erase(it);
+  }
+
+  return 0;
+}
+
+int FakeIonDevice::Share(ion_fd_data *data) {
+  auto it = handles_.find(data->handle);
+  if (it == handles_.end()) {
+    return EINVAL;
+  }
+
+  data->fd = dup(it->second.buffer->fd);
+  return (data->fd < 0) ? errno : 0;
+}
+
+int FakeIonDevice::Import(ion_fd_data *data) {
+  struct stat st;
+  if (fstat(data->fd, &st)) {
+    return errno;
+  }
+
+  for (auto &handle : handles_) {
+    const Buffer &buffer = *handle.second.buffer;
+    if (buffer.dev == st.st_dev && buffer.ino == st.st_ino) {
+      handle.second.ref_count++;
+      data->handle = handle.first;
+      return 0;
+    }
+  }
+
+  // Only fds shared by this device can be imported
+  return EINVAL;
+}
+
+int FakeIonDevice::Custom(ion_custom_data *data) {
+  if (data->cmd != ION_IOC_CLEAN_CACHES && data->cmd != ION_IOC_INV_CACHES &&
+      data->cmd != ION_IOC_CLEAN_INV_CACHES) {
+    return ENOTTY;
+  }
+
+  const ion_flush_data *flush_data = reinterpret_cast<const ion_flush_data *>(data->arg);
+  auto it = handles_.find(flush_data->handle);
+  if (it == handles_.end()) {
+    return EINVAL;
+  }
+
+  size_t end = size_t(flush_data->offset) + flush_data->length;
+  return (end > it->second.buffer->size) ? EINVAL : 0;
+}
+
+// Any fd stands for the device, requests are handled by FakeIonDevice
+int IonAlloc::OpenIonDevice() {
+  return open("/dev/null", O_RDONLY);
+}
+
+int IonAlloc::IonIoctl(int request, void *arg) {
+  int err = FakeIonDevice::GetInstance()->Ioctl(request, arg);
+  if (err) {
+    errno = err;
+    return -1;
+  }
+
+  return 0;
+}
+
+}  // namespace gralloc1
+
+// libsync is not built for the host. Waits for the fence fd the same way.
+extern "C" int sync_wait(int fd, int timeout) {
+  struct pollfd fds = {fd, POLLIN, 0};
+  int ret;
+
+  do {
+    ret = poll(&fds, 1, timeout);
+  } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+
+  if (ret == 0) {
+    errno = ETIME;
+    return -1;
+  }
+
+  return (ret < 0) ? -1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cutils/log.h>
+#include <string.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <thread>
+
+#include "gr_fill_pool.h"
+
+namespace gralloc1 {
+
+const size_t FillPool::kChunkSize;
+const unsigned int FillPool::kMaxWorkers;
+
+// Must be called with lock_ held
+void FillPool::StartWorkers() {
+  started_ = true;
+  unsigned int cpus = std::thread::hardware_concurrency();
+  unsigned int count = std::min(kMaxWorkers, cpus > 1 ? cpus - 1 : 0);
+  for (unsigned int i = 0; i < count; i++) {
+    std::thread(&FillPool::Worker, this).detach();
+    num_workers_++;
+  }
+
+  ALOGI("%s: %u fill workers", __FUNCTION__, num_workers_);
+}
+
+void FillPool::Worker() {
+  uint64_t generation = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(lock_);
+    job_cv_.wait(lock, [&] { return job_ && generation_ != generation; });
+    generation = generation_;
+    Job *job = job_;
+    job->active++;
+    lock.unlock();
+
+    Run(job);
+
+    lock.lock();
+    job->active--;
+    done_cv_.notify_all();
+  }
+}
+
+void FillPool::Run(Job *job) {
+  size_t chunk;
+  while ((chunk = job->next++) < job->chunks) {
+    size_t offset = chunk * kChunkSize;
+    memset(job->base + offset, 0, std::min(kChunkSize, job->size - offset));
+    if (++job->done == job->chunks) {
+      std::lock_guard<std::mutex> lock(lock_);
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void FillPool::Zero(void *base, size_t size) {
+  ATRACE_CALL();
+  std::lock_guard<std::mutex> fill_lock(fill_lock_);
+  std::unique_lock<std::mutex> lock(lock_);
+  if (!started_) {
+    StartWorkers();
+  }
+
+  if (!num_workers_ || size < 2 * kChunkSize) {
+    lock.unlock();
+    memset(base, 0, size);
+    return;
+  }
+
+  Job job;
+  job.base = static_cast<uint8_t *>(base);
+  job.size = size;
+  job.chunks = (size + kChunkSize - 1) / kChunkSize;
+  job_ = &job;
+  generation_++;
+  lock.unlock();
+  job_cv_.notify_all();
+
+  Run(&job);
+
+  // The job lives on this stack, wait for the workers to let go of it as well
+  lock.lock();
+  done_cv_.wait(lock, [&] { return job.done == job.chunks && !job.active; });
+  job_ = nullptr;
+}
+
+}  // namespace gralloc1
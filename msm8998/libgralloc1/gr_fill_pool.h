@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GR_FILL_POOL_H__
+#define __GR_FILL_POOL_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace gralloc1 {
+
+// Small pool of worker threads clearing large buffers in parallel chunks. The calling thread
+// takes chunks as well, and the workers are only started on first use.
+class FillPool {
+ public:
+  static FillPool *GetInstance() {
+    static FillPool *instance = new FillPool();
+    return instance;
+  }
+
+  void Zero(void *base, size_t size);
+
+ private:
+  static const size_t kChunkSize = 1024 * 1024;
+  static const unsigned int kMaxWorkers = 3;
+
+  struct Job {
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    size_t chunks = 0;
+    std::atomic<size_t> next {0};
+    std::atomic<size_t> done {0};
+    unsigned int active = 0;
+  };
+
+  FillPool() {}
+  void StartWorkers();
+  void Worker();
+  void Run(Job *job);
+
+  std::mutex fill_lock_;  // One job at a time
+  std::mutex lock_;
+  std::condition_variable job_cv_;
+  std::condition_variable done_cv_;
+  Job *job_ = nullptr;
+  uint64_t generation_ = 0;
+  unsigned int num_workers_ = 0;
+  bool started_ = false;
+};
+
+}  // namespace gralloc1
+
+#endif  // __GR_FILL_POOL_H__
@@ -29,15 +29,14 @@
 
 #define DEBUG 0
 #define ATRACE_TAG (ATRACE_TAG_GRAPHICS | ATRACE_TAG_HAL)
-#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <cutils/log.h>
 #include <errno.h>
 #include <utils/Trace.h>
 
 #include "gralloc_priv.h"
+#include "gr_fill_pool.h"
 #include "gr_utils.h"
 #include "gr_ion_alloc.h"
 
@@ -45,7 +44,7 @@ namespace gralloc1 {
 
 bool IonAlloc::Init() {
   if (ion_dev_fd_ == FD_INIT) {
-    ion_dev_fd_ = open(kIonDevice, O_RDONLY);
+    ion_dev_fd_ = OpenIonDevice();
   }
 
   if (ion_dev_fd_ < 0) {
@@ -79,7 +78,7 @@ int IonAlloc::AllocBuffer(AllocData *data) {
   ion_alloc_data.flags = data->flags;
   ion_alloc_data.flags |= data->uncached ? 0 : ION_FLAG_CACHED;
 
-  if (ioctl(ion_dev_fd_, INT(ION_IOC_ALLOC), &ion_alloc_data)) {
+  if (IonIoctl(INT(ION_IOC_ALLOC), &ion_alloc_data)) {
     err = -errno;
     ALOGE("ION_IOC_ALLOC failed with error - %s", strerror(errno));
     return err;
@@ -87,21 +86,31 @@ int IonAlloc::AllocBuffer(AllocData *data) {
 
   fd_data.handle = ion_alloc_data.handle;
   handle_data.handle = ion_alloc_data.handle;
-  if (ioctl(ion_dev_fd_, INT(ION_IOC_MAP), &fd_data)) {
+  if (IonIoctl(INT(ION_IOC_MAP), &fd_data)) {
     err = -errno;
     ALOGE("%s: ION_IOC_MAP failed with error - %s", __FUNCTION__, strerror(errno));
-    ioctl(ion_dev_fd_, INT(ION_IOC_FREE), &handle_data);
+    IonIoctl(INT(ION_IOC_FREE), &handle_data);
     return err;
   }
 
   if (!(INT(data->flags) & INT(ION_SECURE))) {
-    base = mmap(0, ion_alloc_data.len, PROT_READ | PROT_WRITE, MAP_SHARED, fd_data.fd, 0);
+    int map_flags = MAP_SHARED | (data->prefault ? MAP_POPULATE : 0);
+    base = mmap(0, ion_alloc_data.len, PROT_READ | PROT_WRITE, map_flags, fd_data.fd, 0);
     if (base == MAP_FAILED) {
       err = -errno;
       ALOGE("%s: Failed to map the allocated memory: %s", __FUNCTION__, strerror(errno));
-      ioctl(ion_dev_fd_, INT(ION_IOC_FREE), &handle_data);
+      IonIoctl(INT(ION_IOC_FREE), &handle_data);
       return err;
     }
+
+    if (data->zero_fill) {
+      FillPool::GetInstance()->Zero(base, ion_alloc_data.len);
+      // Write the zeroes back for the non CPU clients
+      if (!data->uncached) {
+        CleanBuffer(base, UINT(ion_alloc_data.len), 0, fd_data.fd, CACHE_CLEAN,
+                    handle_data.handle);
+      }
+    }
   }
 
   data->base = base;
@@ -125,8 +134,10 @@ int IonAlloc::FreeBuffer(void *base, unsigned int size, unsigned int offset, int
   }
   struct ion_handle_data handle_data;
   handle_data.handle = ion_handle;
-  ioctl(ion_dev_fd_, INT(ION_IOC_FREE), &handle_data);
-  close(fd);
+  IonIoctl(INT(ION_IOC_FREE), &handle_data);
+  if (fd >= 0) {
+    close(fd);
+  }
 
   return err;
 }
@@ -138,7 +149,7 @@ int IonAlloc::MapBuffer(void **base, unsigned int size, unsigned int offset, int
 
   // It is a (quirky) requirement of ION to have opened the
   // ion fd in the process that is doing the mapping
-  addr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  addr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(offset));
   *base = addr;
   if (addr == MAP_FAILED) {
     err = -errno;
@@ -163,23 +174,43 @@ int IonAlloc::UnmapBuffer(void *base, unsigned int size, unsigned int /*offset*/
   return err;
 }
 
-int IonAlloc::CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op) {
+int IonAlloc::ImportBuffer(int fd, int *ion_handle) {
   ATRACE_CALL();
-  ATRACE_INT("operation id", op);
-  struct ion_flush_data flush_data;
   struct ion_fd_data fd_data;
-  struct ion_handle_data handle_data;
-  int err = 0;
 
   fd_data.fd = fd;
-  if (ioctl(ion_dev_fd_, INT(ION_IOC_IMPORT), &fd_data)) {
-    err = -errno;
+  if (IonIoctl(INT(ION_IOC_IMPORT), &fd_data)) {
+    int err = -errno;
     ALOGE("%s: ION_IOC_IMPORT failed with error - %s", __FUNCTION__, strerror(errno));
     return err;
   }
 
-  handle_data.handle = fd_data.handle;
-  flush_data.handle = fd_data.handle;
+  *ion_handle = fd_data.handle;
+
+  return 0;
+}
+
+int IonAlloc::CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op,
+                          int ion_handle) {
+  ATRACE_CALL();
+  ATRACE_INT("operation id", op);
+  ATRACE_INT("operation size", INT(size));
+  struct ion_flush_data flush_data;
+  struct ion_handle_data handle_data;
+  int err = 0;
+
+  // Without a handle owned by the caller, import one just for this operation
+  bool imported = false;
+  if (ion_handle < 0) {
+    err = ImportBuffer(fd, &ion_handle);
+    if (err) {
+      return err;
+    }
+    imported = true;
+  }
+
+  handle_data.handle = ion_handle;
+  flush_data.handle = ion_handle;
   flush_data.vaddr = base;
   // offset and length are unsigned int
   flush_data.offset = offset;
@@ -199,16 +230,16 @@ int IonAlloc::CleanBuffer(void *base, unsigned int size, unsigned int offset, in
   }
 
   d.arg = (unsigned long)(&flush_data);  // NOLINT
-  if (ioctl(ion_dev_fd_, INT(ION_IOC_CUSTOM), &d)) {
+  if (IonIoctl(INT(ION_IOC_CUSTOM), &d)) {
     err = -errno;
     ALOGE("%s: ION_IOC_CLEAN_INV_CACHES failed with error - %s", __FUNCTION__, strerror(errno));
-    ioctl(ion_dev_fd_, INT(ION_IOC_FREE), &handle_data);
-    return err;
   }
 
-  ioctl(ion_dev_fd_, INT(ION_IOC_FREE), &handle_data);
+  if (imported) {
+    IonIoctl(INT(ION_IOC_FREE), &handle_data);
+  }
 
-  return 0;
+  return err;
 }
 
 }  // namespace gralloc1
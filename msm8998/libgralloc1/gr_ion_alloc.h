@@ -51,6 +51,8 @@ struct AllocData {
   unsigned int align = 1;
   uintptr_t handle = 0;
   bool uncached = false;
+  bool prefault = false;
+  bool zero_fill = false;
   unsigned int flags = 0x0;
   unsigned int heap_id = 0x0;
   unsigned int alloc_type = 0x0;
@@ -67,12 +69,16 @@ class IonAlloc {
   int FreeBuffer(void *base, unsigned int size, unsigned int offset, int fd, int ion_handle);
   int MapBuffer(void **base, unsigned int size, unsigned int offset, int fd);
   int UnmapBuffer(void *base, unsigned int size, unsigned int offset);
-  int CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op);
+  int ImportBuffer(int fd, int *ion_handle);
+  int CleanBuffer(void *base, unsigned int size, unsigned int offset, int fd, int op,
+                  int ion_handle);
 
  private:
   const char *kIonDevice = "/dev/ion";
 
+  // Defined in gr_ion_device.cpp, host builds use the in-process device of gr_fake_ion.cpp
   int OpenIonDevice();
+  int IonIoctl(int request, void *arg);
   void CloseIonDevice();
 
   int ion_dev_fd_;
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GR_LAYOUT_CACHE_H__
+#define __GR_LAYOUT_CACHE_H__
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "gr_buf_descriptor.h"
+
+namespace gralloc1 {
+
+// Bounded LRU cache of layouts computed from the width, height, format and usage of a buffer.
+// Safe to use from multiple threads.
+template <class Layout>
+class LayoutCache {
+ public:
+  explicit LayoutCache(size_t max_entries) : max_entries_(max_entries) {}
+
+  bool Find(const BufferDescriptor &descriptor, Layout *layout) {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto it = map_.find(MakeKey(descriptor));
+    if (it == map_.end()) {
+      misses_++;
+      return false;
+    }
+
+    // Move to the front of the LRU list
+    lru_.splice(lru_.begin(), lru_, it->second);
+    *layout = it->second->second;
+    hits_++;
+    return true;
+  }
+
+  void Insert(const BufferDescriptor &descriptor, const Layout &layout) {
+    std::lock_guard<std::mutex> lock(lock_);
+    Key key = MakeKey(descriptor);
+    auto it = map_.find(key);
+    if (it != map_.end()) {
+      it->second->second = layout;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return;
+    }
+
+    if (map_.size() >= max_entries_) {
+      map_.erase(lru_.back().first);
+      lru_.pop_back();
+    }
+    lru_.emplace_front(key, layout);
+    map_.emplace(key, lru_.begin());
+  }
+
+  void GetStats(uint64_t *hits, uint64_t *misses) {
+    std::lock_guard<std::mutex> lock(lock_);
+    *hits = hits_;
+    *misses = misses_;
+  }
+
+ private:
+  struct Key {
+    int width;
+    int height;
+    int format;
+    gralloc1_producer_usage_t prod_usage;
+    gralloc1_consumer_usage_t cons_usage;
+
+    bool operator==(const Key &other) const {
+      return width == other.width && height == other.height && format == other.format &&
+             prod_usage == other.prod_usage && cons_usage == other.cons_usage;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      uint64_t hash = (static_cast<uint64_t>(static_cast<uint32_t>(key.width)) << 32) ^
+                      static_cast<uint32_t>(key.height);
+      hash = hash * 31 + static_cast<uint32_t>(key.format);
+      hash = hash * 31 + static_cast<uint64_t>(key.prod_usage);
+      hash = hash * 31 + static_cast<uint64_t>(key.cons_usage);
+      return std::hash<uint64_t>()(hash);
+    }
+  };
+
+  typedef std::list<std::pair<Key, Layout>> LruList;
+
+  static Key MakeKey(const BufferDescriptor &descriptor) {
+    return Key{descriptor.GetWidth(), descriptor.GetHeight(), descriptor.GetFormat(),
+               descriptor.GetProducerUsage(), descriptor.GetConsumerUsage()};
+  }
+
+  std::mutex lock_;
+  size_t max_entries_;
+  LruList lru_;
+  std::unordered_map<Key, typename LruList::iterator, KeyHash> map_;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}  // namespace gralloc1
+
+#endif  // __GR_LAYOUT_CACHE_H__
@@ -0,0 +1,417 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Replays a buffer operation trace captured with debug.gralloc.trace_ops and read back through
+// GRALLOC1_MODULE_PERFORM_GET_OP_TRACE, and reports how long each operation takes on this device.
+//
+// Usage: gralloc_replay <trace.csv>
+//
+// Operations are issued back to back in trace order. A buffer the trace did not allocate, one
+// imported from another process or allocated before the capture started, gets a stand-in
+// allocated from the first entry that names it. Operations then run on a clone of the stand-in
+// handle, which is imported by its first retain the way compositors import buffers. Setting up
+// a stand-in is not part of the measurements.
+//
+// The host build links the gralloc1 sources against the in-process ION device of
+// gr_fake_ion.cpp, so a trace can be replayed off the device to compare allocator changes.
+
+#include <errno.h>
+#include <cutils/native_handle.h>
+#include <hardware/gralloc1.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <map>
+#include <string>
+
+#include "gralloc_priv.h"
+
+#ifndef __ANDROID__
+extern struct gralloc_module_t HAL_MODULE_INFO_SYM;
+#endif
+
+namespace {
+
+enum Op { kAllocate, kFree, kRetain, kRelease, kLock, kUnlock, kOpMax };
+
+// Same order and names as the trace
+const char *kOpNames[] = {"allocate", "free", "retain", "release", "lock", "unlock"};
+
+struct TraceEntry {
+  uint64_t id = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  int32_t format = 0;
+  uint64_t prod_usage = 0;
+  uint64_t cons_usage = 0;
+  uint64_t latency_ns = 0;
+  gralloc1_rect_t region = {};
+  Op op = kOpMax;
+};
+
+struct ReplayBuffer {
+  buffer_handle_t handle = nullptr;    // Handle the operations run on, null until imported
+  uint32_t ref_count = 0;              // References taken on handle
+  buffer_handle_t stand_in = nullptr;  // Allocation backing a buffer the trace did not allocate
+};
+
+struct OpStats {
+  uint64_t count = 0;
+  uint64_t skipped = 0;
+  uint64_t failed = 0;
+  uint64_t traced_ns = 0;
+  uint64_t replayed_ns = 0;
+};
+
+class TraceReplay {
+ public:
+  bool Init();
+  ~TraceReplay();
+  void Replay(const TraceEntry &entry);
+  void Dump();
+
+ private:
+  int32_t Allocate(const TraceEntry &entry, buffer_handle_t *buffer);
+  int32_t Run(const TraceEntry &entry, buffer_handle_t buffer);
+  ReplayBuffer *GetStandIn(const TraceEntry &entry);
+  void ReleaseAll(ReplayBuffer *buffer);
+
+  const hw_module_t *module_ = nullptr;
+  gralloc1_device_t *device_ = nullptr;
+  GRALLOC1_PFN_CREATE_DESCRIPTOR CreateDescriptor_ = nullptr;
+  GRALLOC1_PFN_DESTROY_DESCRIPTOR DestroyDescriptor_ = nullptr;
+  GRALLOC1_PFN_SET_DIMENSIONS SetDimensions_ = nullptr;
+  GRALLOC1_PFN_SET_FORMAT SetFormat_ = nullptr;
+  GRALLOC1_PFN_SET_PRODUCER_USAGE SetProducerUsage_ = nullptr;
+  GRALLOC1_PFN_SET_CONSUMER_USAGE SetConsumerUsage_ = nullptr;
+  GRALLOC1_PFN_ALLOCATE Allocate_ = nullptr;
+  GRALLOC1_PFN_RETAIN Retain_ = nullptr;
+  GRALLOC1_PFN_RELEASE Release_ = nullptr;
+  GRALLOC1_PFN_LOCK Lock_ = nullptr;
+  GRALLOC1_PFN_UNLOCK Unlock_ = nullptr;
+
+  std::map<uint64_t, ReplayBuffer> buffers_;  // Trace id --> replayed buffer
+  OpStats stats_[kOpMax];
+  uint64_t stand_ins_ = 0;
+};
+
+uint64_t Now() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+template <typename T>
+bool GetFunction(gralloc1_device_t *device, gralloc1_function_descriptor_t descriptor, T *func) {
+  *func = reinterpret_cast<T>(device->getFunction(device, descriptor));
+  return *func != nullptr;
+}
+
+bool TraceReplay::Init() {
+#ifdef __ANDROID__
+  if (hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module_)) {
+    fprintf(stderr, "Failed to load the gralloc module\n");
+    return false;
+  }
+#else
+  module_ = &HAL_MODULE_INFO_SYM.common;
+#endif
+
+  if (gralloc1_open(module_, &device_)) {
+    fprintf(stderr, "Failed to open the gralloc1 device\n");
+    return false;
+  }
+
+  if (!GetFunction(device_, GRALLOC1_FUNCTION_CREATE_DESCRIPTOR, &CreateDescriptor_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_DESTROY_DESCRIPTOR, &DestroyDescriptor_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_SET_DIMENSIONS, &SetDimensions_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_SET_FORMAT, &SetFormat_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_SET_PRODUCER_USAGE, &SetProducerUsage_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_SET_CONSUMER_USAGE, &SetConsumerUsage_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_ALLOCATE, &Allocate_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_RETAIN, &Retain_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_RELEASE, &Release_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_LOCK, &Lock_) ||
+      !GetFunction(device_, GRALLOC1_FUNCTION_UNLOCK, &Unlock_)) {
+    fprintf(stderr, "gralloc1 device is missing a function\n");
+    return false;
+  }
+
+  return true;
+}
+
+TraceReplay::~TraceReplay() {
+  if (!device_) {
+    return;
+  }
+
+  // Buffers that were still in use when the trace was captured
+  for (auto &buffer : buffers_) {
+    ReleaseAll(&buffer.second);
+  }
+  gralloc1_close(device_);
+}
+
+void TraceReplay::ReleaseAll(ReplayBuffer *buffer) {
+  for (; buffer->ref_count; buffer->ref_count--) {
+    Release_(device_, buffer->handle);
+  }
+
+  if (buffer->stand_in) {
+    // The last release of the clone closed its fds
+    if (buffer->handle) {
+      native_handle_delete(const_cast<native_handle_t *>(buffer->handle));
+    }
+    Release_(device_, buffer->stand_in);
+  }
+
+  buffer->handle = nullptr;
+  buffer->stand_in = nullptr;
+}
+
+ReplayBuffer *TraceReplay::GetStandIn(const TraceEntry &entry) {
+  buffer_handle_t stand_in = nullptr;
+  if (Allocate(entry, &stand_in) != GRALLOC1_ERROR_NONE) {
+    return nullptr;
+  }
+
+  stand_ins_++;
+  ReplayBuffer &buffer = buffers_[entry.id];
+  buffer.stand_in = stand_in;
+
+  return &buffer;
+}
+
+int32_t TraceReplay::Allocate(const TraceEntry &entry, buffer_handle_t *buffer) {
+  gralloc1_buffer_descriptor_t descriptor = 0;
+  int32_t err = CreateDescriptor_(device_, &descriptor);
+  if (err != GRALLOC1_ERROR_NONE) {
+    return err;
+  }
+
+  SetDimensions_(device_, descriptor, entry.width, entry.height);
+  SetFormat_(device_, descriptor, entry.format);
+  SetProducerUsage_(device_, descriptor, entry.prod_usage);
+  SetConsumerUsage_(device_, descriptor, entry.cons_usage);
+  err = Allocate_(device_, 1, &descriptor, buffer);
+  DestroyDescriptor_(device_, descriptor);
+
+  return err;
+}
+
+int32_t TraceReplay::Run(const TraceEntry &entry, buffer_handle_t buffer) {
+  switch (entry.op) {
+    case kRetain:
+      return Retain_(device_, buffer);
+
+    case kRelease:
+      return Release_(device_, buffer);
+
+    case kLock: {
+      void *data = nullptr;
+      return Lock_(device_, buffer, entry.prod_usage, entry.cons_usage, &entry.region, &data,
+                   -1);
+    }
+
+    case kUnlock: {
+      int32_t release_fence = -1;
+      int32_t err = Unlock_(device_, buffer, &release_fence);
+      if (release_fence >= 0) {
+        close(release_fence);
+      }
+      return err;
+    }
+
+    default:
+      return GRALLOC1_ERROR_UNSUPPORTED;
+  }
+}
+
+void TraceReplay::Replay(const TraceEntry &entry) {
+  OpStats &stats = stats_[entry.op];
+
+  // A free is the tail of the release that dropped the last reference, it is replayed there.
+  if (entry.op == kFree) {
+    stats.skipped++;
+    return;
+  }
+
+  ReplayBuffer *buffer = nullptr;
+  if (entry.op != kAllocate) {
+    auto it = buffers_.find(entry.id);
+    buffer = (it != buffers_.end()) ? &it->second : GetStandIn(entry);
+    if (!buffer) {
+      stats.failed++;
+      return;
+    }
+  }
+
+  // Import the stand-in through a clone of its handle. A retain is the import itself, any other
+  // operation needs a reference to have been taken before the capture started.
+  bool import = buffer && !buffer->handle;
+  if (import) {
+    buffer->handle = native_handle_clone(buffer->stand_in);
+    if (!buffer->handle) {
+      stats.failed++;
+      return;
+    }
+
+    if (entry.op != kRetain) {
+      if (Retain_(device_, buffer->handle) != GRALLOC1_ERROR_NONE) {
+        native_handle_close(buffer->handle);
+        native_handle_delete(const_cast<native_handle_t *>(buffer->handle));
+        buffer->handle = nullptr;
+        stats.failed++;
+        return;
+      }
+      buffer->ref_count = 1;
+    }
+  }
+
+  uint64_t start_ns = Now();
+  buffer_handle_t allocated = nullptr;
+  int32_t err = buffer ? Run(entry, buffer->handle) : Allocate(entry, &allocated);
+  uint64_t latency_ns = Now() - start_ns;
+
+  if (err != GRALLOC1_ERROR_NONE) {
+    if (import && entry.op == kRetain) {
+      native_handle_close(buffer->handle);
+      native_handle_delete(const_cast<native_handle_t *>(buffer->handle));
+      buffer->handle = nullptr;
+    }
+    stats.failed++;
+    return;
+  }
+
+  if (entry.op == kAllocate) {
+    ReplayBuffer &replay_buffer = buffers_[entry.id];
+    ReleaseAll(&replay_buffer);
+    replay_buffer.handle = allocated;
+    replay_buffer.ref_count = 1;
+  } else if (entry.op == kRetain) {
+    buffer->ref_count++;
+  } else if (entry.op == kRelease && --buffer->ref_count == 0) {
+    if (buffer->stand_in) {
+      // The stand-in stays allocated for the next import, the clone is gone with its fds
+      native_handle_delete(const_cast<native_handle_t *>(buffer->handle));
+      buffer->handle = nullptr;
+    } else {
+      buffers_.erase(entry.id);
+    }
+  }
+
+  stats.count++;
+  stats.traced_ns += entry.latency_ns;
+  stats.replayed_ns += latency_ns;
+}
+
+void TraceReplay::Dump() {
+  printf("%-10s %10s %10s %10s %14s %14s\n", "op", "count", "skipped", "failed", "traced_us",
+         "replayed_us");
+  for (int op = 0; op < kOpMax; op++) {
+    const OpStats &stats = stats_[op];
+    uint64_t count = stats.count ? stats.count : 1;
+    printf("%-10s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %14" PRIu64 " %14" PRIu64 "\n",
+           kOpNames[op], stats.count, stats.skipped, stats.failed,
+           stats.traced_ns / count / 1000, stats.replayed_ns / count / 1000);
+  }
+  printf("stand-in buffers: %" PRIu64 "\n", stand_ins_);
+}
+
+bool ParseEntry(const char *line, TraceEntry *entry) {
+  char op[16] = {};
+  unsigned int format = 0;
+  gralloc1_rect_t &region = entry->region;
+  int fields = sscanf(line, "%*u,%15[^,],%" SCNu64 ",%u,%u,%x,%" SCNx64 ",%" SCNx64 ",%*u,%" SCNu64
+                      ",%d,%d,%d,%d", op, &entry->id, &entry->width, &entry->height, &format,
+                      &entry->prod_usage, &entry->cons_usage, &entry->latency_ns, &region.left,
+                      &region.top, &region.width, &region.height);
+  // Traces without a region column lock the whole buffer
+  if (fields == 8) {
+    region = {0, 0, int32_t(entry->width), int32_t(entry->height)};
+  } else if (fields != 12) {
+    return false;
+  }
+
+  entry->format = int32_t(format);
+  for (int i = 0; i < kOpMax; i++) {
+    if (!strcmp(op, kOpNames[i])) {
+      entry->op = Op(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <trace.csv>\n", argv[0]);
+    return 1;
+  }
+
+  FILE *file = fopen(argv[1], "r");
+  if (!file) {
+    fprintf(stderr, "Failed to open %s: %s\n", argv[1], strerror(errno));
+    return 1;
+  }
+
+  TraceReplay replay;
+  if (!replay.Init()) {
+    fclose(file);
+    return 1;
+  }
+
+  // The first line is the header
+  char line[256];
+  unsigned int line_number = 1;
+  if (!fgets(line, sizeof(line), file)) {
+    fprintf(stderr, "%s is empty\n", argv[1]);
+    fclose(file);
+    return 1;
+  }
+
+  while (fgets(line, sizeof(line), file)) {
+    TraceEntry entry;
+    line_number++;
+    if (!ParseEntry(line, &entry)) {
+      fprintf(stderr, "Skipping malformed line %u\n", line_number);
+      continue;
+    }
+    replay.Replay(entry);
+  }
+  fclose(file);
+
+  replay.Dump();
+  return 0;
+}
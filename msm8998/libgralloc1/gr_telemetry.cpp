@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "gralloc_priv.h"
+#include "gr_telemetry.h"
+
+namespace gralloc1 {
+
+static const char *kOpNames[] = {"allocate", "free", "retain", "release", "lock", "unlock"};
+static const char *kUsageNames[] = {"protected", "camera", "video", "cpu", "gpu", "display",
+                                    "other"};
+
+const unsigned int BufferTelemetry::kSizeBucketsKB[] = {64, 1024, 4096, 16384, 65536};
+
+thread_local BufferTelemetry::ThreadSlot BufferTelemetry::tls_slot_;
+
+BufferTelemetry::ThreadSlot::~ThreadSlot() {
+  if (owner) {
+    owner->PutThreadStats(stats);
+  }
+}
+
+BufferTelemetry::BufferTelemetry() {
+  for (auto &format : formats_) {
+    format = 0;
+  }
+
+  for (auto &live_bytes : live_bytes_) {
+    live_bytes = 0;
+  }
+}
+
+BufferTelemetry::ThreadStats *BufferTelemetry::GetThreadStats() {
+  if (tls_slot_.owner == this) {
+    return tls_slot_.stats;
+  }
+
+  ThreadStats *stats = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(free_lock_);
+    if (free_) {
+      stats = free_;
+      free_ = stats->next_free;
+    }
+  }
+
+  if (!stats) {
+    // Value initialization zeroes the counters
+    stats = new ThreadStats();
+    stats->next = threads_.load();
+    while (!threads_.compare_exchange_weak(stats->next, stats)) {
+    }
+  }
+
+  tls_slot_.owner = this;
+  tls_slot_.stats = stats;
+  return stats;
+}
+
+void BufferTelemetry::PutThreadStats(ThreadStats *stats) {
+  // The counts stay in the block, they keep adding up under its next owner
+  std::lock_guard<std::mutex> lock(free_lock_);
+  stats->next_free = free_;
+  free_ = stats;
+}
+
+int BufferTelemetry::GetFormatSlot(int format) {
+  for (int i = 0; i < kFormatSlots; i++) {
+    int slot_format = formats_[i].load(std::memory_order_relaxed);
+    if (slot_format == format) {
+      return i;
+    }
+
+    if (!slot_format) {
+      // Claim the free slot, unless another thread took it first
+      if (formats_[i].compare_exchange_strong(slot_format, format) || slot_format == format) {
+        return i;
+      }
+    }
+  }
+
+  return kFormatSlots;
+}
+
+BufferTelemetry::UsageClass BufferTelemetry::GetUsageClass(gralloc1_producer_usage_t prod_usage,
+                                                           gralloc1_consumer_usage_t cons_usage) {
+  if (prod_usage & GRALLOC1_PRODUCER_USAGE_PROTECTED) {
+    return kUsageProtected;
+  }
+
+  if ((prod_usage & GRALLOC1_PRODUCER_USAGE_CAMERA) ||
+      (cons_usage & GRALLOC1_CONSUMER_USAGE_CAMERA)) {
+    return kUsageCamera;
+  }
+
+  if ((prod_usage & GRALLOC1_PRODUCER_USAGE_VIDEO_DECODER) ||
+      (cons_usage & GRALLOC1_CONSUMER_USAGE_VIDEO_ENCODER)) {
+    return kUsageVideo;
+  }
+
+  if ((prod_usage & (GRALLOC1_PRODUCER_USAGE_CPU_READ | GRALLOC1_PRODUCER_USAGE_CPU_WRITE)) ||
+      (cons_usage & GRALLOC1_CONSUMER_USAGE_CPU_READ)) {
+    return kUsageCpu;
+  }
+
+  if ((prod_usage & GRALLOC1_PRODUCER_USAGE_GPU_RENDER_TARGET) ||
+      (cons_usage & GRALLOC1_CONSUMER_USAGE_GPU_TEXTURE)) {
+    return kUsageGpu;
+  }
+
+  if (cons_usage & (GRALLOC1_CONSUMER_USAGE_HWCOMPOSER | GRALLOC1_CONSUMER_USAGE_CLIENT_TARGET)) {
+    return kUsageDisplay;
+  }
+
+  return kUsageOther;
+}
+
+int BufferTelemetry::GetSizeBucket(unsigned int size) {
+  int bucket = 0;
+  while (bucket < kSizeBuckets - 1 && size > kSizeBucketsKB[bucket] * 1024) {
+    bucket++;
+  }
+
+  return bucket;
+}
+
+int BufferTelemetry::GetLatencyBucket(uint64_t latency_ns) {
+  uint64_t latency_us = latency_ns / 1000;
+  int bucket = 0;
+  while (bucket < kLatencyBuckets - 1 && latency_us >= (1ULL << bucket)) {
+    bucket++;
+  }
+
+  return bucket;
+}
+
+void BufferTelemetry::Record(Op op, int format, gralloc1_producer_usage_t prod_usage,
+                             gralloc1_consumer_usage_t cons_usage, unsigned int size,
+                             uint64_t latency_ns) {
+  OpStats &stats = GetThreadStats()->ops[op];
+  const auto relaxed = std::memory_order_relaxed;
+
+  stats.latency[GetLatencyBucket(latency_ns)].fetch_add(1, relaxed);
+  stats.usage[GetUsageClass(prod_usage, cons_usage)].fetch_add(1, relaxed);
+  stats.size[GetSizeBucket(size)].fetch_add(1, relaxed);
+  stats.format[GetFormatSlot(format)].fetch_add(1, relaxed);
+  stats.total_ns.fetch_add(latency_ns, relaxed);
+}
+
+void BufferTelemetry::EnableTrace(size_t capacity) {
+  std::lock_guard<std::mutex> lock(trace_lock_);
+  trace_.clear();
+  trace_.reserve(capacity);
+  trace_capacity_ = capacity;
+  trace_next_ = 0;
+  trace_enabled_ = capacity > 0;
+}
+
+void BufferTelemetry::Trace(Op op, uint64_t id, int width, int height, int format,
+                            gralloc1_producer_usage_t prod_usage,
+                            gralloc1_consumer_usage_t cons_usage, unsigned int size,
+                            uint64_t latency_ns, const gralloc1_rect_t &region) {
+  if (!trace_enabled_) {
+    return;
+  }
+
+  TraceEntry entry = {Now(), id, uint64_t(prod_usage), uint64_t(cons_usage), latency_ns, size,
+                      width, height, format, region, op};
+  std::lock_guard<std::mutex> lock(trace_lock_);
+  if (trace_.size() < trace_capacity_) {
+    trace_.push_back(entry);
+  } else {
+    trace_[trace_next_] = entry;
+    trace_next_ = (trace_next_ + 1) % trace_.size();
+  }
+}
+
+void BufferTelemetry::DumpTrace(std::ostream *os) {
+  std::lock_guard<std::mutex> lock(trace_lock_);
+  char line[256];
+  *os << "time_ns,op,id,width,height,format,producer_usage,consumer_usage,size,latency_ns,"
+      << "region_left,region_top,region_width,region_height" << std::endl;
+  for (size_t i = 0; i < trace_.size(); i++) {
+    const TraceEntry &entry = trace_[(trace_next_ + i) % trace_.size()];
+    snprintf(line, sizeof(line), "%" PRIu64 ",%s,%" PRIu64 ",%d,%d,0x%x,0x%" PRIx64 ",0x%" PRIx64
+             ",%u,%" PRIu64 ",%d,%d,%d,%d", entry.time_ns, kOpNames[entry.op], entry.id,
+             entry.width, entry.height, entry.format, entry.prod_usage, entry.cons_usage,
+             entry.size, entry.latency_ns, entry.region.left, entry.region.top,
+             entry.region.width, entry.region.height);
+    *os << line << std::endl;
+  }
+}
+
+void BufferTelemetry::AddLiveBytes(unsigned int heap_id, unsigned int size) {
+  if (heap_id) {
+    live_bytes_[__builtin_ctz(heap_id)] += size;
+  }
+}
+
+void BufferTelemetry::RemoveLiveBytes(unsigned int heap_id, unsigned int size) {
+  if (heap_id) {
+    live_bytes_[__builtin_ctz(heap_id)] -= size;
+  }
+}
+
+// Upper bound in us of the bucket holding the given percentile
+uint64_t BufferTelemetry::GetPercentile(const Totals &totals, uint64_t percent) {
+  uint64_t target = (totals.count * percent + 99) / 100;
+  uint64_t count = 0;
+  for (int i = 0; i < kLatencyBuckets; i++) {
+    count += totals.latency[i];
+    if (count >= target) {
+      return 1ULL << i;
+    }
+  }
+
+  return 1ULL << (kLatencyBuckets - 1);
+}
+
+void BufferTelemetry::Dump(std::ostream *os) {
+  Totals totals[kOpMax];
+  for (ThreadStats *stats = threads_.load(); stats; stats = stats->next) {
+    for (int op = 0; op < kOpMax; op++) {
+      const OpStats &op_stats = stats->ops[op];
+      Totals &op_totals = totals[op];
+      for (int i = 0; i < kLatencyBuckets; i++) {
+        op_totals.latency[i] += op_stats.latency[i];
+        op_totals.count += op_stats.latency[i];
+      }
+      for (int i = 0; i < kUsageClassMax; i++) {
+        op_totals.usage[i] += op_stats.usage[i];
+      }
+      for (int i = 0; i < kSizeBuckets; i++) {
+        op_totals.size[i] += op_stats.size[i];
+      }
+      for (int i = 0; i <= kFormatSlots; i++) {
+        op_totals.format[i] += op_stats.format[i];
+      }
+      op_totals.total_ns += op_stats.total_ns;
+    }
+  }
+
+  char line[256];
+  *os << "Buffer lifecycle:" << std::endl;
+  for (int op = 0; op < kOpMax; op++) {
+    const Totals &op_totals = totals[op];
+    if (!op_totals.count) {
+      continue;
+    }
+
+    snprintf(line, sizeof(line), "  %-8s count %" PRIu64 " avg %" PRIu64 " us p50 <%" PRIu64
+             " us p99 <%" PRIu64 " us", kOpNames[op], op_totals.count,
+             op_totals.total_ns / op_totals.count / 1000, GetPercentile(op_totals, 50),
+             GetPercentile(op_totals, 99));
+    *os << line << std::endl;
+
+    *os << "    usage:";
+    for (int i = 0; i < kUsageClassMax; i++) {
+      if (op_totals.usage[i]) {
+        *os << " " << kUsageNames[i] << "=" << op_totals.usage[i];
+      }
+    }
+    *os << std::endl << "    size:";
+    for (int i = 0; i < kSizeBuckets; i++) {
+      if (op_totals.size[i]) {
+        if (i < kSizeBuckets - 1) {
+          *os << " <=" << kSizeBucketsKB[i] << "K=" << op_totals.size[i];
+        } else {
+          *os << " >" << kSizeBucketsKB[i - 1] << "K=" << op_totals.size[i];
+        }
+      }
+    }
+    *os << std::endl << "    format:";
+    for (int i = 0; i <= kFormatSlots; i++) {
+      if (op_totals.format[i]) {
+        if (i < kFormatSlots) {
+          snprintf(line, sizeof(line), " 0x%x=%" PRIu64, formats_[i].load(), op_totals.format[i]);
+        } else {
+          snprintf(line, sizeof(line), " other=%" PRIu64, op_totals.format[i]);
+        }
+        *os << line;
+      }
+    }
+    *os << std::endl;
+  }
+
+  *os << "Live bytes allocated by this process:" << std::endl;
+  for (int i = 0; i < kHeapSlots; i++) {
+    int64_t live_bytes = live_bytes_[i];
+    if (live_bytes) {
+      *os << "  ion heap " << i << ": " << live_bytes / 1024 << " KB" << std::endl;
+    }
+  }
+}
+
+}  // namespace gralloc1
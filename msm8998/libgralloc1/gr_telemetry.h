@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017, The Linux Foundation. All rights reserved.
+
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __GR_TELEMETRY_H__
+#define __GR_TELEMETRY_H__
+
+#include <hardware/gralloc1.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace gralloc1 {
+
+// Process wide counters for the buffer lifecycle. Every thread records into its own block of
+// counters, the blocks are only merged when the telemetry is read, so recording takes no lock.
+class BufferTelemetry {
+ public:
+  enum Op { kAllocate, kFree, kRetain, kRelease, kLock, kUnlock, kOpMax };
+
+  BufferTelemetry();
+  static uint64_t Now() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+  }
+  void Record(Op op, int format, gralloc1_producer_usage_t prod_usage,
+              gralloc1_consumer_usage_t cons_usage, unsigned int size, uint64_t latency_ns);
+  void AddLiveBytes(unsigned int heap_id, unsigned int size);
+  void RemoveLiveBytes(unsigned int heap_id, unsigned int size);
+  void Dump(std::ostream *os);
+
+  // Ring of the most recent operations in completion order, for capturing a device session
+  // and replaying it offline. Off unless enabled. Lock entries carry the usages and region
+  // passed to the lock, other entries the usages the buffer was allocated with and no region.
+  void EnableTrace(size_t capacity);
+  void Trace(Op op, uint64_t id, int width, int height, int format,
+             gralloc1_producer_usage_t prod_usage, gralloc1_consumer_usage_t cons_usage,
+             unsigned int size, uint64_t latency_ns, const gralloc1_rect_t &region);
+  void DumpTrace(std::ostream *os);
+
+ private:
+  enum UsageClass {
+    kUsageProtected,
+    kUsageCamera,
+    kUsageVideo,
+    kUsageCpu,
+    kUsageGpu,
+    kUsageDisplay,
+    kUsageOther,
+    kUsageClassMax,
+  };
+
+  // Log2 buckets of microseconds, the last one also holds anything slower
+  static const int kLatencyBuckets = 16;
+  // Upper bounds of the size buckets in KB, the last bucket is unbounded
+  static const unsigned int kSizeBucketsKB[];
+  static const int kSizeBuckets = 6;
+  // Formats are given a slot on first use, the last slot collects any overflow
+  static const int kFormatSlots = 24;
+  static const int kHeapSlots = 32;
+
+  struct OpStats {
+    std::atomic<uint64_t> latency[kLatencyBuckets];
+    std::atomic<uint64_t> usage[kUsageClassMax];
+    std::atomic<uint64_t> size[kSizeBuckets];
+    std::atomic<uint64_t> format[kFormatSlots + 1];
+    std::atomic<uint64_t> total_ns;
+  };
+
+  // Written by the owning thread only. Blocks stay on the list for the life of the instance,
+  // when a thread exits its block keeps the counts and is handed to the next new thread.
+  struct ThreadStats {
+    OpStats ops[kOpMax];
+    ThreadStats *next;
+    ThreadStats *next_free;
+  };
+
+  // Returns the block of the calling thread to the free list when the thread exits
+  struct ThreadSlot {
+    ~ThreadSlot();
+    BufferTelemetry *owner = nullptr;
+    ThreadStats *stats = nullptr;
+  };
+
+  struct TraceEntry {
+    uint64_t time_ns;
+    uint64_t id;
+    uint64_t prod_usage;
+    uint64_t cons_usage;
+    uint64_t latency_ns;
+    unsigned int size;
+    int width;
+    int height;
+    int format;
+    gralloc1_rect_t region;
+    Op op;
+  };
+
+  struct Totals {
+    uint64_t latency[kLatencyBuckets] = {};
+    uint64_t usage[kUsageClassMax] = {};
+    uint64_t size[kSizeBuckets] = {};
+    uint64_t format[kFormatSlots + 1] = {};
+    uint64_t total_ns = 0;
+    uint64_t count = 0;
+  };
+
+  ThreadStats *GetThreadStats();
+  void PutThreadStats(ThreadStats *stats);
+  int GetFormatSlot(int format);
+  static UsageClass GetUsageClass(gralloc1_producer_usage_t prod_usage,
+                                  gralloc1_consumer_usage_t cons_usage);
+  static int GetSizeBucket(unsigned int size);
+  static int GetLatencyBucket(uint64_t latency_ns);
+  static uint64_t GetPercentile(const Totals &totals, uint64_t percent);
+
+  // Block of the calling thread, along with the instance it was taken from
+  static thread_local ThreadSlot tls_slot_;
+
+  std::atomic<ThreadStats *> threads_ {nullptr};
+  std::mutex free_lock_;
+  ThreadStats *free_ = nullptr;
+  std::atomic<int> formats_[kFormatSlots];
+  std::atomic<int64_t> live_bytes_[kHeapSlots];
+
+  std::atomic<bool> trace_enabled_ {false};
+  std::mutex trace_lock_;
+  std::vector<TraceEntry> trace_;
+  size_t trace_capacity_ = 0;
+  size_t trace_next_ = 0;
+};
+
+}  // namespace gralloc1
+
+#endif  // __GR_TELEMETRY_H__
@@ -31,97 +31,177 @@
 
 namespace gralloc1 {
 
-bool IsUncompressedRGBFormat(int format) {
-  switch (format) {
-    case HAL_PIXEL_FORMAT_RGBA_8888:
-    case HAL_PIXEL_FORMAT_RGBX_8888:
-    case HAL_PIXEL_FORMAT_RGB_888:
-    case HAL_PIXEL_FORMAT_RGB_565:
-    case HAL_PIXEL_FORMAT_BGR_565:
-    case HAL_PIXEL_FORMAT_BGRA_8888:
-    case HAL_PIXEL_FORMAT_RGBA_5551:
-    case HAL_PIXEL_FORMAT_RGBA_4444:
-    case HAL_PIXEL_FORMAT_R_8:
-    case HAL_PIXEL_FORMAT_RG_88:
-    case HAL_PIXEL_FORMAT_BGRX_8888:
-    case HAL_PIXEL_FORMAT_RGBA_1010102:
-    case HAL_PIXEL_FORMAT_ARGB_2101010:
-    case HAL_PIXEL_FORMAT_RGBX_1010102:
-    case HAL_PIXEL_FORMAT_XRGB_2101010:
-    case HAL_PIXEL_FORMAT_BGRA_1010102:
-    case HAL_PIXEL_FORMAT_ABGR_2101010:
-    case HAL_PIXEL_FORMAT_BGRX_1010102:
-    case HAL_PIXEL_FORMAT_XBGR_2101010:
-      return true;
-    default:
-      break;
-  }
+// RGB formats known to gralloc, with the bytes per pixel of the uncompressed ones. A bpp of 0
+// marks formats whose size is not derived from a plain per pixel cost.
+enum RGBFormatFlags : uint32_t {
+  kUncompressedRGB = 0x1,
+  kCompressedRGB = 0x2,
+};
+
+struct RGBFormatInfo {
+  int format;
+  uint32_t bpp;
+  uint32_t flags;
+};
+
+static constexpr RGBFormatInfo kRGBFormats[] = {
+  { HAL_PIXEL_FORMAT_RGBA_8888,                               4, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGBX_8888,                               4, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGB_888,                                 3, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGB_565,                                 2, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_BGR_565,                                 2, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_BGRA_8888,                               4, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGBA_5551,                               2, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGBA_4444,                               2, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_R_8,                                     0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RG_88,                                   0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_BGRX_8888,                               4, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGBA_1010102,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_ARGB_2101010,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_RGBX_1010102,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_XRGB_2101010,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_BGRA_1010102,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_ABGR_2101010,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_BGRX_1010102,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_XBGR_2101010,                            0, kUncompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_5x4_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_5x4_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_5x5_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_5x5_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x5_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_6x5_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x5_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_8x5_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x6_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_8x6_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8_KHR,            0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR,    0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x5_KHR,           0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x5_KHR,   0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x6_KHR,           0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x6_KHR,   0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x8_KHR,           0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x8_KHR,   0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x10_KHR,          0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x10_KHR,  0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_12x10_KHR,          0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_12x10_KHR,  0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_12x12_KHR,          0, kCompressedRGB },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR,  0, kCompressedRGB },
+};
+
+static constexpr size_t kRGBFormatCount = sizeof(kRGBFormats) / sizeof(kRGBFormats[0]);
+
+// 19 uncompressed formats and the 14 ASTC block sizes in RGBA and SRGB8_ALPHA8
+static_assert(kRGBFormatCount == 19 + 2 * 14,
+              "RGB format table does not match the supported formats");
+
+// The formats above fall in the Android (< 0x40) and private (0x100..0x13F) format ranges and
+// the two ASTC ranges. Those ranges are folded into a dense index, and kRGBFormatTable holds the
+// entry of every index, so a lookup costs a few range checks and one array access.
+struct RGBFormatRange {
+  int base;
+  int count;
+};
+
+static constexpr RGBFormatRange kRGBFormatRanges[] = {
+  { 0,                                                     0x40 },
+  { 0x100,                                                 0x40 },
+  { HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4_KHR,         0x10 },
+  { HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR, 0x10 },
+};
+
+static constexpr size_t kRGBFormatRangeCount =
+  sizeof(kRGBFormatRanges) / sizeof(kRGBFormatRanges[0]);
+
+static constexpr int GetRGBTableSize(size_t range = 0) {
+  return (range == kRGBFormatRangeCount) ? 0 :
+         kRGBFormatRanges[range].count + GetRGBTableSize(range + 1);
+}
 
-  return false;
+static constexpr int kRGBTableSize = GetRGBTableSize();
+
+// Returns kRGBTableSize for formats outside all ranges
+static constexpr int GetRGBTableIndex(int format, size_t range = 0, int offset = 0) {
+  return (range == kRGBFormatRangeCount) ? kRGBTableSize :
+         (format >= kRGBFormatRanges[range].base &&
+          format < kRGBFormatRanges[range].base + kRGBFormatRanges[range].count) ?
+           (offset + format - kRGBFormatRanges[range].base) :
+           GetRGBTableIndex(format, range + 1, offset + kRGBFormatRanges[range].count);
 }
 
-bool IsCompressedRGBFormat(int format) {
-  switch (format) {
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_4x4_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_5x4_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_5x4_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_5x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_5x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_6x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_6x6_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_6x6_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_8x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x6_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_8x6_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_8x8_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_8x8_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x5_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x6_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x6_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x8_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x8_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_10x10_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_10x10_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_12x10_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_12x10_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_RGBA_ASTC_12x12_KHR:
-    case HAL_PIXEL_FORMAT_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR:
-      return true;
-    default:
-      break;
+static constexpr int GetRGBTableFormat(int index, size_t range = 0) {
+  return (index < kRGBFormatRanges[range].count) ? (kRGBFormatRanges[range].base + index) :
+         GetRGBTableFormat(index - kRGBFormatRanges[range].count, range + 1);
+}
+
+static constexpr RGBFormatInfo FindRGBFormat(int format, size_t i = 0) {
+  return (i == kRGBFormatCount) ? RGBFormatInfo{ format, 0, 0 } :
+         (kRGBFormats[i].format == format) ? kRGBFormats[i] : FindRGBFormat(format, i + 1);
+}
+
+static constexpr bool AreRGBFormatsIndexed(size_t i = 0) {
+  return (i == kRGBFormatCount) ||
+         ((GetRGBTableIndex(kRGBFormats[i].format) < kRGBTableSize) &&
+          AreRGBFormatsIndexed(i + 1));
+}
+
+static_assert(AreRGBFormatsIndexed(), "RGB format outside the indexed format ranges");
+
+template <int... I>
+struct IndexList {};
+
+template <int N, int... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+
+template <int... I>
+struct MakeIndexList<0, I...> {
+  typedef IndexList<I...> type;
+};
+
+struct RGBFormatTable {
+  RGBFormatInfo entries[kRGBTableSize];
+};
+
+template <int... I>
+static constexpr RGBFormatTable MakeRGBFormatTable(IndexList<I...>) {
+  return RGBFormatTable{ { FindRGBFormat(GetRGBTableFormat(I))... } };
+}
+
+static constexpr RGBFormatTable kRGBFormatTable =
+  MakeRGBFormatTable(MakeIndexList<kRGBTableSize>::type());
+
+static const RGBFormatInfo *GetRGBFormatInfo(int format) {
+  int index = GetRGBTableIndex(format);
+  if (index == kRGBTableSize || !kRGBFormatTable.entries[index].flags) {
+    return nullptr;
   }
 
-  return false;
+  return &kRGBFormatTable.entries[index];
+}
+
+bool IsUncompressedRGBFormat(int format) {
+  const RGBFormatInfo *info = GetRGBFormatInfo(format);
+  return info && (info->flags & kUncompressedRGB);
+}
+
+bool IsCompressedRGBFormat(int format) {
+  const RGBFormatInfo *info = GetRGBFormatInfo(format);
+  return info && (info->flags & kCompressedRGB);
 }
 
 uint32_t GetBppForUncompressedRGB(int format) {
-  uint32_t bpp = 0;
-  switch (format) {
-    case HAL_PIXEL_FORMAT_RGBA_8888:
-    case HAL_PIXEL_FORMAT_RGBX_8888:
-    case HAL_PIXEL_FORMAT_BGRA_8888:
-    case HAL_PIXEL_FORMAT_BGRX_8888:
-      bpp = 4;
-      break;
-    case HAL_PIXEL_FORMAT_RGB_888:
-      bpp = 3;
-      break;
-    case HAL_PIXEL_FORMAT_RGB_565:
-    case HAL_PIXEL_FORMAT_BGR_565:
-    case HAL_PIXEL_FORMAT_RGBA_5551:
-    case HAL_PIXEL_FORMAT_RGBA_4444:
-      bpp = 2;
-      break;
-    default:
-      ALOGE("Error : %s New format request", __FUNCTION__);
-      break;
+  const RGBFormatInfo *info = GetRGBFormatInfo(format);
+  if (!info || !info->bpp) {
+    ALOGE("Error : %s New format request", __FUNCTION__);
+    return 0;
   }
 
-  return bpp;
+  return info->bpp;
 }
 
 bool CpuCanAccess(gralloc1_producer_usage_t prod_usage, gralloc1_consumer_usage_t cons_usage) {
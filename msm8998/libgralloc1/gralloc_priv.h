@@ -51,6 +51,17 @@ inline int roundUpToPageSize(int x) {
 /* MM heap is a carveout heap for video, can be secured */
 #define GRALLOC1_PRODUCER_USAGE_PRIVATE_MM_HEAP     GRALLOC1_PRODUCER_USAGE_PRIVATE_5
 
+/* Carve the buffers of one allocate call out of a single ION allocation
+ * instead of aliasing them, must be set on all the descriptors */
+#define GRALLOC1_PRODUCER_USAGE_PRIVATE_SUB_ALLOC   GRALLOC1_PRODUCER_USAGE_PRIVATE_6
+
+/* Populate the CPU mapping at allocation time so the first access does not fault */
+#define GRALLOC1_PRODUCER_USAGE_PRIVATE_PREFAULT    GRALLOC1_PRODUCER_USAGE_PRIVATE_7
+
+/* Clear the buffer at allocation time, implies PREFAULT.
+ * Carveout heaps do not clear their memory */
+#define GRALLOC1_PRODUCER_USAGE_PRIVATE_ZERO_FILL   GRALLOC1_PRODUCER_USAGE_PRIVATE_8
+
 /* Use legacy ZSL definition until we know the correct usage on gralloc1 */
 #define GRALLOC1_PRODUCER_USAGE_PRIVATE_CAMERA_ZSL  GRALLOC_USAGE_HW_CAMERA_ZSL
 
@@ -69,6 +80,11 @@ inline int roundUpToPageSize(int x) {
 /* Buffer content should be displayed on an external display only */
 #define GRALLOC1_CONSUMER_USAGE_PRIVATE_EXTERNAL_ONLY  0x08000000
 
+/* Lock time flag, the lock fails unless the CPU sees linear pixels. UBWC data
+ * is returned only if it was rendered linear, otherwise the client has to
+ * fall back to a GPU or C2D blit instead of reading compressed tiles */
+#define GRALLOC1_CONSUMER_USAGE_PRIVATE_LINEAR_ACCESS  GRALLOC1_CONSUMER_USAGE_PRIVATE_4
+
 
 /* Legacy gralloc0.x definitions */
 /* Some clients may still be using the old flags */
@@ -97,6 +113,10 @@ inline int roundUpToPageSize(int x) {
 #define GRALLOC_MODULE_PERFORM_SET_SINGLE_BUFFER_MODE 13
 #define GRALLOC1_MODULE_PERFORM_GET_BUFFER_SIZE_AND_DIMENSIONS 14
 #define GRALLOC1_MODULE_PERFORM_ALLOCATE_BUFFER 15
+#define GRALLOC1_MODULE_PERFORM_GET_LAYOUT_CACHE_STATS 16
+#define GRALLOC1_MODULE_PERFORM_GET_MAPPED_BYTES 17
+#define GRALLOC1_MODULE_PERFORM_GET_BUFFER_TELEMETRY 18
+#define GRALLOC1_MODULE_PERFORM_GET_OP_TRACE 19
 
 // OEM specific HAL formats
 #define HAL_PIXEL_FORMAT_RGBA_5551 6
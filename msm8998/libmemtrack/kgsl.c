@@ -15,10 +15,15 @@
  */
 
 #include <errno.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 
 #include <hardware/memtrack.h>
 
@@ -27,6 +32,26 @@
 #define ARRAY_SIZE(x) (sizeof(x)/sizeof(x[0]))
 #define min(x, y) ((x) < (y) ? (x) : (y))
 
+/* dumpsys meminfo asks for MEMTRACK_TYPE_GL and MEMTRACK_TYPE_GRAPHICS of
+ * the same pid back to back, both are served from one parse of the file.
+ * debugfs does not update the mtime of the mem node when its content
+ * changes, the mtime only tells a recycled pid apart. Results are therefore
+ * also dropped after a short time to live.
+ */
+#define KGSL_CACHE_ENTRIES 16
+#define KGSL_CACHE_TTL_NS 200000000LL
+
+struct kgsl_cache_entry {
+    bool valid;
+    pid_t pid;
+    struct timespec mtime;
+    int64_t timestamp_ns;
+    struct kgsl_memtrack_usage usage;
+};
+
+static struct kgsl_cache_entry kgsl_cache[KGSL_CACHE_ENTRIES];
+static pthread_mutex_t kgsl_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 struct memtrack_record record_templates[] = {
     {
         .flags = MEMTRACK_FLAG_SMAPS_ACCOUNTED |
@@ -40,85 +65,363 @@ struct memtrack_record record_templates[] = {
     },
 };
 
-int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
-                             struct memtrack_record *records,
-                             size_t *num_records)
+struct kgsl_mem_entry {
+    unsigned long size;
+    unsigned long mapsize;
+    int egl_surface_count;
+    int egl_image_count;
+    const char *flags;
+    size_t flags_len;
+    const char *type;
+    size_t type_len;
+    const char *usage;
+    size_t usage_len;
+};
+
+static int64_t kgsl_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static const char *kgsl_next_token(const char *p, size_t *len)
+{
+    const char *start;
+
+    while (*p == ' ' || *p == '\t')
+        p++;
+
+    start = p;
+    while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n')
+        p++;
+
+    *len = (size_t)(p - start);
+    return start;
+}
+
+static bool kgsl_token_is(const char *tok, size_t len, const char *str)
+{
+    return strlen(str) == len && memcmp(tok, str, len) == 0;
+}
+
+static bool kgsl_parse_hex(const char *tok, size_t len)
+{
+    size_t i;
+
+    if (len == 0)
+        return false;
+
+    for (i = 0; i < len; i++) {
+        char c = tok[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+              (c >= 'A' && c <= 'F')))
+            return false;
+    }
+
+    return true;
+}
+
+static bool kgsl_parse_ulong(const char *tok, size_t len, unsigned long *val)
+{
+    unsigned long v = 0;
+    size_t i;
+
+    if (len == 0)
+        return false;
+
+    for (i = 0; i < len; i++) {
+        unsigned long digit;
+
+        if (tok[i] < '0' || tok[i] > '9')
+            return false;
+
+        digit = (unsigned long)(tok[i] - '0');
+        if (v > (ULONG_MAX - digit) / 10)
+            return false;
+
+        v = v * 10 + digit;
+    }
+
+    *val = v;
+    return true;
+}
+
+static bool kgsl_parse_int(const char *tok, size_t len, int *val)
+{
+    unsigned long v;
+    bool negative = (len > 0 && tok[0] == '-');
+
+    if (negative) {
+        tok++;
+        len--;
+    }
+
+    if (!kgsl_parse_ulong(tok, len, &v) || v > INT_MAX)
+        return false;
+
+    *val = negative ? -(int)v : (int)v;
+    return true;
+}
+
+/* Format:
+ *  gpuaddr useraddr     size    id flags       type            usage sglen mapsize eglsrf eglimg
+ * 545ba000 545ba000     4096     1 -----pY     gpumem      arraybuffer     1  4096      0      0
+ *
+ * Lines that do not carry all of these columns, such as the header, are
+ * skipped.
+ */
+static bool kgsl_parse_mem_line(const char *line, struct kgsl_mem_entry *entry)
+{
+    const char *tok;
+    size_t len;
+    int id, sglen;
+
+    tok = kgsl_next_token(line, &len);
+    if (!kgsl_parse_hex(tok, len))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_hex(tok, len))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_ulong(tok, len, &entry->size))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_int(tok, len, &id))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (len == 0)
+        return false;
+    entry->flags = tok;
+    entry->flags_len = len;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (len == 0)
+        return false;
+    entry->type = tok;
+    entry->type_len = len;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (len == 0)
+        return false;
+    entry->usage = tok;
+    entry->usage_len = len;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_int(tok, len, &sglen))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_ulong(tok, len, &entry->mapsize))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_int(tok, len, &entry->egl_surface_count))
+        return false;
+
+    tok = kgsl_next_token(tok + len, &len);
+    if (!kgsl_parse_int(tok, len, &entry->egl_image_count))
+        return false;
+
+    return true;
+}
+
+static void kgsl_account_gl(const struct kgsl_mem_entry *entry,
+                            struct kgsl_memtrack_usage *usage)
+{
+    if (usage->gl_unaccounted + entry->size < entry->size) {
+        usage->gl_error = -ERANGE;
+        return;
+    }
+
+    if (!kgsl_token_is(entry->type, entry->type_len, "gpumem"))
+        return;
+
+    /* A usermapped gpumem entry is accounted, anything else is not. */
+    if (entry->flags_len > 6 && entry->flags[6] == 'Y') {
+        if (usage->gl_accounted + entry->mapsize < usage->gl_accounted) {
+            usage->gl_error = -ERANGE;
+            return;
+        }
+
+        usage->gl_accounted += entry->mapsize;
+
+        if (entry->mapsize > entry->size) {
+            usage->gl_error = -EINVAL;
+            return;
+        }
+
+        usage->gl_unaccounted += entry->size - entry->mapsize;
+    } else {
+        usage->gl_unaccounted += entry->size;
+    }
+}
+
+static void kgsl_account_graphics(const struct kgsl_mem_entry *entry,
+                                  struct kgsl_memtrack_usage *usage)
+{
+    if (usage->graphics_unaccounted + entry->size < entry->size) {
+        usage->graphics_error = -ERANGE;
+        return;
+    }
+
+    if (!kgsl_token_is(entry->type, entry->type_len, "ion"))
+        return;
+
+    if (kgsl_token_is(entry->usage, entry->usage_len, "egl_surface"))
+        usage->graphics_unaccounted += entry->size;
+    else if (entry->egl_surface_count == 0)
+        usage->graphics_unaccounted += entry->size /
+            (unsigned long)(entry->egl_image_count ? entry->egl_image_count : 1);
+}
+
+static int kgsl_parse_mem_file(const char *path, struct kgsl_memtrack_usage *usage)
 {
-    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
     FILE *fp;
     char line[1024];
-    char tmp[128];
-    size_t accounted_size = 0;
-    size_t unaccounted_size = 0;
 
-    *num_records = ARRAY_SIZE(record_templates);
+    memset(usage, 0, sizeof(*usage));
 
-    /* fastpath to return the necessary number of records */
-    if (allocated_records == 0) {
-        return 0;
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -errno;
     }
 
-    memcpy(records, record_templates,
-           sizeof(struct memtrack_record) * allocated_records);
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        struct kgsl_mem_entry entry;
 
-    snprintf(tmp, sizeof(tmp), "/d/kgsl/proc/%d/mem", pid);
-    fp = fopen(tmp, "r");
-    if (fp == NULL) {
+        if (!kgsl_parse_mem_line(line, &entry)) {
+            continue;
+        }
+
+        if (entry.size == 0) {
+            usage->gl_error = -EINVAL;
+            usage->graphics_error = -EINVAL;
+        }
+
+        if (usage->gl_error == 0)
+            kgsl_account_gl(&entry, usage);
+
+        if (usage->graphics_error == 0)
+            kgsl_account_graphics(&entry, usage);
+
+        if (usage->gl_error && usage->graphics_error)
+            break;
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+int kgsl_memtrack_get_usage(pid_t pid, struct kgsl_memtrack_usage *usage)
+{
+    char path[128];
+    struct stat st;
+    struct kgsl_cache_entry *slot = &kgsl_cache[0];
+    int64_t now;
+    int ret;
+    size_t i;
+
+    snprintf(path, sizeof(path), "/d/kgsl/proc/%d/mem", pid);
+    if (stat(path, &st) < 0) {
         return -errno;
     }
 
-    /* Go through each line of <pid>/mem file and for every entry of type "gpumem"
-     * check if the gpubuffer entry is usermapped or not. If the entry is usermapped
-     * count the entry as accounted else count the entry as unaccounted.
-     */
-    while (1) {
-        unsigned long size, mapsize;
-        char line_type[7];
-        char flags[10];
-        char line_usage[19];
-        int ret, egl_surface_count = 0, egl_image_count = 0;
+    now = kgsl_now_ns();
 
-        if (fgets(line, sizeof(line), fp) == NULL) {
+    pthread_mutex_lock(&kgsl_cache_lock);
+    for (i = 0; i < KGSL_CACHE_ENTRIES; i++) {
+        struct kgsl_cache_entry *entry = &kgsl_cache[i];
+
+        if (entry->valid && entry->pid == pid) {
+            if (entry->mtime.tv_sec == st.st_mtim.tv_sec &&
+                entry->mtime.tv_nsec == st.st_mtim.tv_nsec &&
+                now - entry->timestamp_ns < KGSL_CACHE_TTL_NS) {
+                *usage = entry->usage;
+                pthread_mutex_unlock(&kgsl_cache_lock);
+                return 0;
+            }
+            slot = entry;
             break;
         }
 
-        /* Format:
-         *  gpuaddr useraddr     size    id flags       type            usage sglen mapsize eglsrf eglimg
-         * 545ba000 545ba000     4096     1 -----pY     gpumem      arraybuffer     1  4096      0      0
-         */
-        ret = sscanf(line, "%*x %*x %lu %*d %9s %6s %18s %*d %lu %6d %6d\n",
-                       &size, flags, line_type, line_usage, &mapsize,
-                       &egl_surface_count, &egl_image_count);
-        if (ret != 7) {
-            continue;
+        if (!entry->valid || entry->timestamp_ns < slot->timestamp_ns) {
+            slot = entry;
         }
+    }
+    pthread_mutex_unlock(&kgsl_cache_lock);
 
-        if (size == 0)
-            return -EINVAL;
+    ret = kgsl_parse_mem_file(path, usage);
+    if (ret < 0) {
+        return ret;
+    }
 
-        if (unaccounted_size + size < size)
-            return -ERANGE;
+    pthread_mutex_lock(&kgsl_cache_lock);
+    slot->valid = true;
+    slot->pid = pid;
+    slot->mtime = st.st_mtim;
+    slot->timestamp_ns = now;
+    slot->usage = *usage;
+    pthread_mutex_unlock(&kgsl_cache_lock);
 
-        if (type == MEMTRACK_TYPE_GL && strcmp(line_type, "gpumem") == 0) {
+    return 0;
+}
 
-            if (flags[6] == 'Y') {
-                if (accounted_size + mapsize < accounted_size)
-                    return -ERANGE;
+size_t kgsl_memtrack_get_usage_batch(const pid_t *pids, size_t num_pids,
+                                     struct kgsl_memtrack_usage *usages,
+                                     int *results)
+{
+    size_t i, count = 0;
 
-                accounted_size += mapsize;
+    for (i = 0; i < num_pids; i++) {
+        results[i] = kgsl_memtrack_get_usage(pids[i], &usages[i]);
+        if (results[i] == 0)
+            count++;
+    }
 
-                if (mapsize > size)
-                    return -EINVAL;
+    return count;
+}
 
-                unaccounted_size += size - mapsize;
-            } else
-                unaccounted_size += size;
-        } else if (type == MEMTRACK_TYPE_GRAPHICS && strcmp(line_type, "ion") == 0) {
-            if (strcmp(line_usage, "egl_surface") == 0)
-                unaccounted_size += size;
-            else if (egl_surface_count == 0)
-                unaccounted_size += size / (egl_image_count ? egl_image_count : 1);
-        }
+int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
+                             struct memtrack_record *records,
+                             size_t *num_records)
+{
+    size_t allocated_records = min(*num_records, ARRAY_SIZE(record_templates));
+    struct kgsl_memtrack_usage usage;
+    size_t accounted_size = 0;
+    size_t unaccounted_size = 0;
+    int ret;
+
+    *num_records = ARRAY_SIZE(record_templates);
+
+    /* fastpath to return the necessary number of records */
+    if (allocated_records == 0) {
+        return 0;
+    }
+
+    memcpy(records, record_templates,
+           sizeof(struct memtrack_record) * allocated_records);
+
+    ret = kgsl_memtrack_get_usage(pid, &usage);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (type == MEMTRACK_TYPE_GL) {
+        if (usage.gl_error)
+            return usage.gl_error;
+        accounted_size = usage.gl_accounted;
+        unaccounted_size = usage.gl_unaccounted;
+    } else if (type == MEMTRACK_TYPE_GRAPHICS) {
+        if (usage.graphics_error)
+            return usage.graphics_error;
+        unaccounted_size = usage.graphics_unaccounted;
     }
 
     if (allocated_records > 0) {
@@ -128,7 +431,5 @@ int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
         records[1].size_in_bytes = unaccounted_size;
     }
 
-    fclose(fp);
-
     return 0;
 }
@@ -17,6 +17,26 @@
 #ifndef _MEMTRACK_MSM_H_
 #define _MEMTRACK_MSM_H_
 
+/* Per-pid KGSL memory usage, gathered for all memtrack types in one pass.
+ * The error fields hold the error the type would report, 0 otherwise.
+ */
+struct kgsl_memtrack_usage {
+    size_t gl_accounted;
+    size_t gl_unaccounted;
+    size_t graphics_unaccounted;
+    int gl_error;
+    int graphics_error;
+};
+
+int kgsl_memtrack_get_usage(pid_t pid, struct kgsl_memtrack_usage *usage);
+
+/* Queries num_pids pids, results[i] holds the return value for pids[i].
+ * Returns the number of pids that were queried successfully.
+ */
+size_t kgsl_memtrack_get_usage_batch(const pid_t *pids, size_t num_pids,
+                                     struct kgsl_memtrack_usage *usages,
+                                     int *results);
+
 int kgsl_memtrack_get_memory(pid_t pid, enum memtrack_type type,
                              struct memtrack_record *records,
                              size_t *num_records);
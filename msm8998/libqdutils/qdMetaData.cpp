@@ -36,6 +36,13 @@
 #include <inttypes.h>
 #include "qdMetaData.h"
 
+// Only slices of a buffer set keep their metadata inside a shared fd
+static off_t getMetaDataOffset(private_handle_t *handle) {
+    if (handle->flags & private_handle_t::PRIV_FLAGS_SUB_ALLOCATED)
+        return static_cast<off_t>(handle->offset_metadata);
+    return 0;
+}
+
 int setMetaData(private_handle_t *handle, DispParamType paramType,
                                                     void *param) {
     if (private_handle_t::validate(handle)) {
@@ -48,7 +55,7 @@ int setMetaData(private_handle_t *handle, DispParamType paramType,
     }
     unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
     void *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
-        handle->fd_metadata, 0);
+        handle->fd_metadata, getMetaDataOffset(handle));
     if (base == reinterpret_cast<void*>(MAP_FAILED)) {
         ALOGE("%s: mmap() failed: error is %s!", __func__, strerror(errno));
         return -1;
@@ -122,7 +129,7 @@ int clearMetaData(private_handle_t *handle, DispParamType paramType) {
 
     unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
     void *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
-        handle->fd_metadata, 0);
+        handle->fd_metadata, getMetaDataOffset(handle));
     if (base == reinterpret_cast<void*>(MAP_FAILED)) {
         ALOGE("%s: mmap() failed: error is %s!", __func__, strerror(errno));
         return -1;
@@ -161,7 +168,7 @@ int getMetaData(private_handle_t *handle, DispFetchParamType paramType,
     }
     unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
     void *base = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
-        handle->fd_metadata, 0);
+        handle->fd_metadata, getMetaDataOffset(handle));
     if (base == reinterpret_cast<void*>(MAP_FAILED)) {
         ALOGE("%s: mmap() failed: error is %s!", __func__, strerror(errno));
         return -1;
@@ -270,14 +277,14 @@ int copyMetaData(struct private_handle_t *src, struct private_handle_t *dst) {
     unsigned long size = ROUND_UP_PAGESIZE(sizeof(MetaData_t));
 
     void *base_src = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
-        src->fd_metadata, 0);
+        src->fd_metadata, getMetaDataOffset(src));
     if (base_src == reinterpret_cast<void*>(MAP_FAILED)) {
         ALOGE("%s: src mmap() failed: error is %s!", __func__, strerror(errno));
         return -1;
     }
 
     void *base_dst = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED,
-        dst->fd_metadata, 0);
+        dst->fd_metadata, getMetaDataOffset(dst));
     if (base_dst == reinterpret_cast<void*>(MAP_FAILED)) {
         ALOGE("%s: dst mmap() failed: error is %s!", __func__, strerror(errno));
         if(munmap(base_src, size))
@@ -242,6 +242,20 @@ class DisplayEventHandler {
   */
   virtual DisplayError CECMessage(char *message) = 0;
 
+  /*! @brief Event handler for refresh rate changes made by the display itself.
+
+    @details This event is dispatched when the display changes its refresh rate without a request
+    from the client, e.g. when it lowers the refresh rate while idle and when it restores it on
+    exit from idle. It is dispatched from within the client call that caused the change.
+
+    @param[in] refresh_rate new refresh rate of the display
+
+    @return \link DisplayError \endlink
+
+    @sa DisplayInterface::SetRefreshRate
+  */
+  virtual DisplayError RefreshRateChanged(uint32_t refresh_rate) = 0;
+
  protected:
   virtual ~DisplayEventHandler() { }
 };
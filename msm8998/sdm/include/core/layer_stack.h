@@ -251,6 +251,11 @@ struct LayerStackFlags {
                                            // This applies only to primary displays currently
 
       uint32_t hdr_present : 1;  //!< Set if stack has HDR content
+
+      uint32_t shared_release_fence : 1;  //!< This flag shall be set by client to accept one
+                                          //!< release fence fd shared by all layers composed in
+                                          //!< the same commit. Layers may then return the same
+                                          //!< fd value, which the client must close only once.
     };
 
     uint32_t flags = 0;               //!< For initialization purpose only.
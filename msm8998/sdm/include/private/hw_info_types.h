@@ -110,6 +110,28 @@ enum HWAVRModes {
 
 typedef std::map<HWSubBlockType, std::vector<LayerBufferFormat>> FormatsMap;
 
+// LayerBufferFormat values come in groups of 0x100 (RGB, planar, semi-planar and packed YUV),
+// each with fewer than 64 formats. A format is bit (group * 64 + index in group) of the set.
+const uint32_t kFormatGroupBits = 6;
+const uint32_t kFormatGroupCount = 4;
+const uint32_t kFormatBitsetSize = kFormatGroupCount << kFormatGroupBits;
+typedef std::bitset<kFormatBitsetSize> FormatsBitset;
+
+static_assert(kFormatRGB101010 < (1 << kFormatGroupBits) &&
+              kFormatYCbCr420TP10Ubwc - kFormatYCbCr420SemiPlanar < (1 << kFormatGroupBits),
+              "LayerBufferFormat group does not fit in FormatsBitset");
+
+// Returns kFormatBitsetSize for formats outside of the set, like kFormatInvalid
+inline uint32_t GetFormatBit(LayerBufferFormat format) {
+  uint32_t group = static_cast<uint32_t>(format) >> 8;
+  uint32_t index = static_cast<uint32_t>(format) & 0xFF;
+  if (group >= kFormatGroupCount || index >= (1U << kFormatGroupBits)) {
+    return kFormatBitsetSize;
+  }
+
+  return (group << kFormatGroupBits) | index;
+}
+
 struct HWDynBwLimitInfo {
   uint32_t cur_mode = kBwDefault;
   uint32_t total_bw_limit[kBwModeMax] = { 0 };
@@ -187,12 +209,35 @@ struct HWResourceInfo {
   HWDynBwLimitInfo dyn_bw_info;
   std::vector<HWPipeCaps> hw_pipes;
   FormatsMap supported_formats_map;
+  FormatsBitset supported_formats[kHWSubBlockMax];  // supported_formats_map, one bit per format
   HWRotatorInfo hw_rot_info;
   HWDestScalarInfo hw_dest_scalar_info;
   bool has_avr = false;
   bool has_hdr = false;
 
   void Reset() { *this = HWResourceInfo(); }
+
+  void SetSupportedFormats(HWSubBlockType sub_blk_type,
+                           const std::vector<LayerBufferFormat> &formats) {
+    supported_formats_map[sub_blk_type] = formats;
+    supported_formats[sub_blk_type].reset();
+    for (LayerBufferFormat format : formats) {
+      uint32_t bit = GetFormatBit(format);
+      if (bit < kFormatBitsetSize) {
+        supported_formats[sub_blk_type].set(bit);
+      }
+    }
+  }
+
+  // A sub block with no reported formats is not restricted here, the driver decides
+  bool IsFormatSupported(HWSubBlockType sub_blk_type, LayerBufferFormat format) const {
+    if (sub_blk_type >= kHWSubBlockMax || supported_formats[sub_blk_type].none()) {
+      return sub_blk_type < kHWSubBlockMax;
+    }
+
+    uint32_t bit = GetFormatBit(format);
+    return (bit < kFormatBitsetSize) && supported_formats[sub_blk_type][bit];
+  }
 };
 
 struct HWSplitInfo {
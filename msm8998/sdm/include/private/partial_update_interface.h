@@ -28,6 +28,7 @@
 #include <core/display_interface.h>
 #include <core/buffer_allocator.h>
 #include <core/buffer_sync_handler.h>
+#include <vector>
 
 #include "hw_info_types.h"
 
@@ -37,6 +38,9 @@ struct PUConstraints {
   bool enable = true;             //!< If this is set, PU will be enabled or it will be disabled
   bool enable_cursor_pu = false;  //!< If this is set, PU will consider cursor layer in the layer
                                    //!< stack for cursor partial update
+  uint32_t max_dirty_rects = 1;    //!< Maximum number of rects in dirty_region
+  std::vector<LayerRect> dirty_region = {};  //!< Disjoint rects in mixer coordinates which were
+                                             //!< updated in this frame
 };
 
 class PartialUpdateInterface {
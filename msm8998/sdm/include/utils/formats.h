@@ -34,10 +34,36 @@
 
 namespace sdm {
 
+// LayerBufferFormat is made of four dense groups (RGB, planar YUV, semi-planar YUV and packed YUV)
+// starting at fixed bases. GetFormatIndex() folds them into a single dense range so that per format
+// properties can be looked up from compile time tables instead of switch statements.
+constexpr uint32_t kFormatRGBCount = kFormatRGB101010 + 1;
+constexpr uint32_t kFormatPlanarCount = kFormatYCrCb420PlanarStride16 - kFormatYCbCr420Planar + 1;
+constexpr uint32_t kFormatSemiPlanarCount =
+  kFormatYCbCr420TP10Ubwc - kFormatYCbCr420SemiPlanar + 1;
+constexpr uint32_t kFormatPackedCount = kFormatCbYCrY422H2V1Packed - kFormatYCbCr422H2V1Packed + 1;
+constexpr uint32_t kFormatIndexMax =
+  kFormatRGBCount + kFormatPlanarCount + kFormatSemiPlanarCount + kFormatPackedCount;
+
+// Returns kFormatIndexMax for formats outside of the known groups.
+constexpr uint32_t GetFormatIndex(LayerBufferFormat format) {
+  return (format <= kFormatRGB101010) ? format :
+         (format >= kFormatYCbCr420Planar && format <= kFormatYCrCb420PlanarStride16) ?
+           (kFormatRGBCount + format - kFormatYCbCr420Planar) :
+         (format >= kFormatYCbCr420SemiPlanar && format <= kFormatYCbCr420TP10Ubwc) ?
+           (kFormatRGBCount + kFormatPlanarCount + format - kFormatYCbCr420SemiPlanar) :
+         (format >= kFormatYCbCr422H2V1Packed && format <= kFormatCbYCrY422H2V1Packed) ?
+           (kFormatRGBCount + kFormatPlanarCount + kFormatSemiPlanarCount + format -
+            kFormatYCbCr422H2V1Packed) :
+         kFormatIndexMax;
+}
+
 bool IsUBWCFormat(LayerBufferFormat format);
 bool Is10BitFormat(LayerBufferFormat format);
 const char *GetFormatString(const LayerBufferFormat &format);
 BufferLayout GetBufferLayout(LayerBufferFormat format);
+// Bytes per pixel of the first plane, used to derive the line stride. Returns 0 if not supported.
+uint32_t GetStrideBpp(LayerBufferFormat format);
 
 }  // namespace sdm
 
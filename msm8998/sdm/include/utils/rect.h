@@ -34,6 +34,7 @@
 #include <core/sdm_types.h>
 #include <core/layer_stack.h>
 #include <utils/debug.h>
+#include <vector>
 
 namespace sdm {
 
@@ -59,6 +60,24 @@ namespace sdm {
                LayerRect *out_rect);
   void TransformHV(const LayerRect &src_domain, const LayerRect &in_rect, LayerRect *out_rect);
   RectOrientation GetOrientation(const LayerRect &in_rect);
+  float GetArea(const LayerRect &rect);
+
+  // Batch operations. These process one rect per vector register on targets with NEON support and
+  // produce the same results as the scalar functions above.
+  LayerRect Union(const LayerRect *rects, uint32_t count);
+  void Intersection(const LayerRect *rects, uint32_t count, const LayerRect &clip,
+                    LayerRect *out_rects);
+  void Intersection(const LayerRect *rects1, uint32_t count1, const LayerRect *rects2,
+                    uint32_t count2, std::vector<LayerRect> *out_rects);
+
+  // Region operations. A region is a list of non-overlapping rects, so that its area is the sum of
+  // the areas of its rects.
+  void SubtractToRegion(const LayerRect &rect1, const LayerRect &rect2,
+                        std::vector<LayerRect> *out_rects);
+  void UnionRegion(const LayerRect &rect, std::vector<LayerRect> *region);
+  void SubtractRegion(const LayerRect &rect, std::vector<LayerRect> *region);
+  void IntersectRegion(const LayerRect &clip, std::vector<LayerRect> *region);
+  float GetArea(const std::vector<LayerRect> &region);
 }  // namespace sdm
 
 #endif  // __RECT_H__
@@ -38,6 +38,7 @@ LOCAL_SRC_FILES               := core_interface.cpp \
                                  hw_info_interface.cpp \
                                  hw_interface.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_info.cpp \
+                                 $(LOCAL_HW_INTF_PATH_1)/hw_caps_cache.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_device.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_primary.cpp \
                                  $(LOCAL_HW_INTF_PATH_1)/hw_hdmi.cpp \
@@ -295,6 +295,12 @@ DisplayError DisplayBase::Commit(LayerStack *layer_stack) {
 
   CommitLayerParams(layer_stack);
 
+  // S3D layers may be split into two hw layers whose release fences get merged and closed in
+  // PostCommitLayerParams(), so they cannot hold a shared fence fd.
+  if (layer_stack->flags.s3d_mode_present) {
+    layer_stack->flags.shared_release_fence = 0;
+  }
+
   if (comp_manager_->Commit(display_comp_ctx_, &hw_layers_)) {
     if (error != kErrorNone) {
       return error;
@@ -31,6 +31,7 @@
 #include <vector>
 
 #include "display_primary.h"
+#include "dump_impl.h"
 #include "hw_interface.h"
 #include "hw_info_interface.h"
 
@@ -119,6 +120,15 @@ DisplayError DisplayPrimary::Prepare(LayerStack *layer_stack) {
     }
   }
 
+  if (idle_state_ == kIdleActive) {
+    if (HasContentUpdate(layer_stack)) {
+      ExitIdle("content update");
+    } else {
+      // Nothing changed on screen, keep composing from the frame buffer target.
+      comp_manager_->ProcessIdleTimeout(display_comp_ctx_);
+    }
+  }
+
   // Clean hw layers for reuse.
   hw_layers_ = HWLayers();
   hw_layers_.hw_avr_info.enable = NeedsAVREnable();
@@ -151,6 +161,10 @@ DisplayError DisplayPrimary::Commit(LayerStack *layer_stack) {
 
   DisplayBase::ReconfigureDisplay();
 
+  if (idle_state_ == kIdlePending) {
+    EnterIdle();
+  }
+
   if (hw_panel_info_.mode == kModeVideo) {
     if (set_idle_timeout && !layer_stack->flags.single_buffered_layer_present) {
       hw_intf_->SetIdleTimeoutMs(idle_timeout_ms_);
@@ -169,6 +183,11 @@ DisplayError DisplayPrimary::Commit(LayerStack *layer_stack) {
 DisplayError DisplayPrimary::SetDisplayState(DisplayState state) {
   lock_guard<recursive_mutex> obj(recursive_mutex_);
   DisplayError error = kErrorNone;
+
+  if (idle_state_ != kIdleNone) {
+    ExitIdle("display state change");
+  }
+
   error = DisplayBase::SetDisplayState(state);
   if (error != kErrorNone) {
     return error;
@@ -269,6 +288,15 @@ DisplayError DisplayPrimary::SetRefreshRate(uint32_t refresh_rate) {
     return error;
   }
 
+  // Client takes over the refresh rate. The panel already runs at it, so leaving idle must not
+  // restore, reconfigure or report a rate change; the reconfigure below covers it.
+  if (idle_state_ == kIdleActive) {
+    idle_restore_refresh_rate_ = 0;
+    ExitIdle("client refresh rate");
+  } else if (idle_state_ == kIdlePending) {
+    idle_restore_refresh_rate_ = refresh_rate;
+  }
+
   return DisplayBase::ReconfigureDisplay();
 }
 
@@ -283,6 +311,15 @@ DisplayError DisplayPrimary::VSync(int64_t timestamp) {
 }
 
 void DisplayPrimary::IdleTimeout() {
+  {
+    lock_guard<recursive_mutex> obj(recursive_mutex_);
+    if (idle_state_ == kIdleNone && active_) {
+      idle_state_ = kIdlePending;
+      idle_restore_refresh_rate_ = display_attributes_.fps;
+      idle_timeout_time_ = std::chrono::steady_clock::now();
+    }
+  }
+
   event_handler_->Refresh();
   comp_manager_->ProcessIdleTimeout(display_comp_ctx_);
 }
@@ -333,6 +370,104 @@ DisplayError DisplayPrimary::DisablePartialUpdateOneFrame() {
   return kErrorNone;
 }
 
+DisplayError DisplayPrimary::SetVSyncState(bool enable) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+
+  // Client asks for vsync only when it is about to draw, so restore the refresh rate ahead of the
+  // next frame instead of on its Prepare.
+  if (enable && idle_state_ == kIdleActive) {
+    ExitIdle("vsync enable");
+  }
+
+  return DisplayBase::SetVSyncState(enable);
+}
+
+bool DisplayPrimary::HasContentUpdate(LayerStack *layer_stack) {
+  if (layer_stack->flags.geometry_changed) {
+    return true;
+  }
+
+  for (Layer *layer : layer_stack->layers) {
+    if (layer->composition != kCompositionGPUTarget && layer->flags.updating) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void DisplayPrimary::EnterIdle() {
+  auto now = std::chrono::steady_clock::now();
+  idle_stats_.last_entry_us = UINT64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     now - idle_timeout_time_).count());
+
+  if (hw_panel_info_.mode == kModeVideo && hw_panel_info_.dynamic_fps &&
+      hw_panel_info_.min_fps && display_attributes_.fps > hw_panel_info_.min_fps) {
+    DisplayError error = hw_intf_->SetRefreshRate(hw_panel_info_.min_fps);
+    if (error != kErrorNone) {
+      DLOGW("Failed to lower refresh rate to %d for idle. Error = %d", hw_panel_info_.min_fps,
+            error);
+    } else {
+      DisplayBase::ReconfigureDisplay();
+      event_handler_->RefreshRateChanged(display_attributes_.fps);
+    }
+  }
+
+  idle_state_ = kIdleActive;
+  idle_entry_time_ = now;
+  idle_stats_.entry_count++;
+
+  DLOGV("Entered idle at %d fps in %" PRIu64 " us", display_attributes_.fps,
+        idle_stats_.last_entry_us);
+}
+
+void DisplayPrimary::ExitIdle(const char *reason) {
+  if (idle_state_ == kIdlePending) {
+    // Idle frame was never committed, nothing was changed on the panel.
+    idle_state_ = kIdleNone;
+    idle_stats_.aborted_count++;
+    DLOGV("Idle entry aborted on %s", reason);
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  if (idle_restore_refresh_rate_ && display_attributes_.fps != idle_restore_refresh_rate_) {
+    DisplayError error = hw_intf_->SetRefreshRate(idle_restore_refresh_rate_);
+    if (error != kErrorNone) {
+      DLOGW("Failed to restore refresh rate to %d. Error = %d", idle_restore_refresh_rate_, error);
+    } else {
+      DisplayBase::ReconfigureDisplay();
+      event_handler_->RefreshRateChanged(display_attributes_.fps);
+    }
+  }
+  auto now = std::chrono::steady_clock::now();
+
+  idle_state_ = kIdleNone;
+  idle_stats_.exit_count++;
+  idle_stats_.last_exit_us = UINT64(std::chrono::duration_cast<std::chrono::microseconds>(
+                                    now - start).count());
+  uint64_t idle_ms = UINT64(std::chrono::duration_cast<std::chrono::milliseconds>(
+                            now - idle_entry_time_).count());
+  idle_stats_.total_idle_ms += idle_ms;
+
+  DLOGV("Exited idle on %s after %" PRIu64 " ms, restore took %" PRIu64 " us", reason, idle_ms,
+        idle_stats_.last_exit_us);
+}
+
+void DisplayPrimary::AppendDump(char *buffer, uint32_t length) {
+  lock_guard<recursive_mutex> obj(recursive_mutex_);
+  DisplayBase::AppendDump(buffer, length);
+
+  sdm::DumpImpl::AppendString(buffer, length, "\nidle state: %d, timeout: %u ms, entries: %u, "
+                              "exits: %u, aborted: %u", idle_state_, idle_timeout_ms_,
+                              idle_stats_.entry_count, idle_stats_.exit_count,
+                              idle_stats_.aborted_count);
+  sdm::DumpImpl::AppendString(buffer, length, "\nlast idle entry: %" PRIu64 " us, last idle exit: "
+                              "%" PRIu64 " us, total idle: %" PRIu64 " ms",
+                              idle_stats_.last_entry_us, idle_stats_.last_exit_us,
+                              idle_stats_.total_idle_ms);
+}
+
 bool DisplayPrimary::NeedsAVREnable() {
   if (avr_prop_disabled_) {
     return false;
@@ -25,6 +25,7 @@
 #ifndef __DISPLAY_PRIMARY_H__
 #define __DISPLAY_PRIMARY_H__
 
+#include <chrono>
 #include <vector>
 
 #include "display_base.h"
@@ -51,6 +52,7 @@ class DisplayPrimary : public DisplayBase, HWEventHandler {
   virtual DisplayError SetRefreshRate(uint32_t refresh_rate);
   virtual DisplayError SetPanelBrightness(int level);
   virtual DisplayError GetPanelBrightness(int *level);
+  virtual DisplayError SetVSyncState(bool enable);
 
   // Implement the HWEventHandlers
   virtual DisplayError VSync(int64_t timestamp);
@@ -59,14 +61,45 @@ class DisplayPrimary : public DisplayBase, HWEventHandler {
   virtual void ThermalEvent(int64_t thermal_level);
   virtual void CECMessage(char *message) { }
 
+ protected:
+  // DumpImpl method
+  void AppendDump(char *buffer, uint32_t length);
+
  private:
+  // Idle power states of a video mode panel. An idle timeout moves the display to kIdlePending and
+  // requests one more frame, which is composed entirely by GPU into the frame buffer target. Once
+  // that frame is committed, the panel drops to its lowest refresh rate (kIdleActive) and the
+  // composition stays frozen on the frame buffer target until the content changes.
+  enum IdleState {
+    kIdleNone,
+    kIdlePending,
+    kIdleActive,
+  };
+
+  struct IdleStats {
+    uint32_t entry_count = 0;
+    uint32_t exit_count = 0;
+    uint32_t aborted_count = 0;
+    uint64_t last_entry_us = 0;     // Idle timeout to idle frame commit
+    uint64_t last_exit_us = 0;      // Time taken to restore the refresh rate
+    uint64_t total_idle_ms = 0;
+  };
+
   bool NeedsAVREnable();
+  bool HasContentUpdate(LayerStack *layer_stack);
+  void EnterIdle();
+  void ExitIdle(const char *reason);
 
   uint32_t idle_timeout_ms_ = 0;
   std::vector<HWEvent> event_list_ = { HWEvent::VSYNC, HWEvent::EXIT, HWEvent::IDLE_NOTIFY,
       HWEvent::SHOW_BLANK_EVENT, HWEvent::THERMAL_LEVEL };
   bool avr_prop_disabled_ = false;
   bool switch_to_cmd_ = false;
+  IdleState idle_state_ = kIdleNone;
+  uint32_t idle_restore_refresh_rate_ = 0;
+  std::chrono::steady_clock::time_point idle_timeout_time_;
+  std::chrono::steady_clock::time_point idle_entry_time_;
+  IdleStats idle_stats_ = {};
 };
 
 }  // namespace sdm
@@ -358,6 +358,34 @@ DisplayError HWDeviceDRM::Standby() {
   return kErrorNone;
 }
 
+template <typename T>
+void HWDeviceDRM::SetPlaneProperty(DRMOps op, uint32_t pipe_id, const T &value, T *shadow,
+                                   bool force) {
+  if (!force && !memcmp(&value, shadow, sizeof(T))) {
+    return;
+  }
+
+  drm_atomic_intf_->Perform(op, pipe_id, value);
+  *shadow = value;
+  atomic_prop_count_++;
+}
+
+void HWDeviceDRM::UpdatePlaneShadow(bool committed) {
+  if (!committed) {
+    // Driver state is unknown after a failed commit, program everything on the next frame.
+    committed_planes_.clear();
+  } else {
+    committed_planes_.clear();
+    for (auto &plane : pending_planes_) {
+      // Planes left out of this request are detached by the driver.
+      if (plane.second.valid && plane.second.used) {
+        plane.second.used = false;
+        committed_planes_.insert(plane);
+      }
+    }
+  }
+}
+
 void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
   if (default_mode_) {
     return;
@@ -366,6 +394,12 @@ void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
   HWLayersInfo &hw_layer_info = hw_layers->info;
   uint32_t hw_layer_count = UINT32(hw_layer_info.hw_layers.size());
 
+  // Prepare may validate several strategies before committing one. Diff every attempt against
+  // the committed state, so that the request holds all changes whatever earlier attempts staged.
+  pending_planes_ = committed_planes_;
+  crtc_active_pending_ = false;
+  atomic_prop_count_ = 0;
+
   for (uint32_t i = 0; i < hw_layer_count; i++) {
     Layer &layer = hw_layer_info.hw_layers.at(i);
     LayerBuffer &input_buffer = layer.input_buffer;
@@ -381,25 +415,32 @@ void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
       HWPipeInfo *pipe_info = (count == 0) ? left_pipe : right_pipe;
       if (pipe_info->valid) {
         uint32_t pipe_id = pipe_info->pipe_id;
+        DRMPlaneShadow &shadow = pending_planes_[pipe_id];
         if (input_buffer.fb_id == 0) {
           // We set these to 0 to clear any previous cycle's state from another buffer.
           // Unfortunately this layer will be skipped from validation because it's dimensions are
           // tied to fb_id which is not available yet.
           drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, 0);
           drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CRTC, pipe_id, 0);
+          atomic_prop_count_ += 2;
+          shadow = DRMPlaneShadow();
           continue;
         }
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ALPHA, pipe_id, layer.plane_alpha);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ZORDER, pipe_id, pipe_info->z_order);
+
+        bool force = !shadow.valid;
+        SetPlaneProperty(DRMOps::PLANE_SET_ALPHA, pipe_id, UINT32(layer.plane_alpha),
+                         &shadow.alpha, force);
+        SetPlaneProperty(DRMOps::PLANE_SET_ZORDER, pipe_id, pipe_info->z_order, &shadow.z_order,
+                         force);
         DRMBlendType blending = {};
         SetBlending(layer.blending, &blending);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_BLEND_TYPE, pipe_id, blending);
+        SetPlaneProperty(DRMOps::PLANE_SET_BLEND_TYPE, pipe_id, blending, &shadow.blending, force);
         DRMRect src = {};
         SetRect(pipe_info->src_roi, &src);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_SRC_RECT, pipe_id, src);
+        SetPlaneProperty(DRMOps::PLANE_SET_SRC_RECT, pipe_id, src, &shadow.src, force);
         DRMRect dst = {};
         SetRect(pipe_info->dst_roi, &dst);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_DST_RECT, pipe_id, dst);
+        SetPlaneProperty(DRMOps::PLANE_SET_DST_RECT, pipe_id, dst, &shadow.dst, force);
         uint32_t rot_bit_mask = 0;
         if (layer.transform.flip_horizontal) {
           rot_bit_mask |= 1 << DRM_REFLECT_X;
@@ -408,22 +449,33 @@ void HWDeviceDRM::SetupAtomic(HWLayers *hw_layers, bool validate) {
           rot_bit_mask |= 1 << DRM_REFLECT_Y;
         }
 
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_H_DECIMATION, pipe_id,
-                                  pipe_info->horizontal_decimation);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_V_DECIMATION, pipe_id,
-                                  pipe_info->vertical_decimation);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_ROTATION, pipe_id, rot_bit_mask);
-        drm_atomic_intf_->Perform(DRMOps::PLANE_SET_FB_ID, pipe_id, input_buffer.fb_id);
+        SetPlaneProperty(DRMOps::PLANE_SET_H_DECIMATION, pipe_id,
+                         UINT32(pipe_info->horizontal_decimation), &shadow.h_decimation, force);
+        SetPlaneProperty(DRMOps::PLANE_SET_V_DECIMATION, pipe_id,
+                         UINT32(pipe_info->vertical_decimation), &shadow.v_decimation, force);
+        SetPlaneProperty(DRMOps::PLANE_SET_ROTATION, pipe_id, rot_bit_mask, &shadow.rotation,
+                         force);
+        SetPlaneProperty(DRMOps::PLANE_SET_FB_ID, pipe_id, input_buffer.fb_id, &shadow.fb_id,
+                         force);
+        // CRTC assignment marks the plane as in use for this commit, so it is always set.
         drm_atomic_intf_->Perform(DRMOps::PLANE_SET_CRTC, pipe_id, token_.crtc_id);
+        atomic_prop_count_++;
+        shadow.valid = true;
+        shadow.used = true;
         if (!validate && input_buffer.acquire_fence_fd >= 0) {
           drm_atomic_intf_->Perform(DRMOps::PLANE_SET_INPUT_FENCE, pipe_id,
                                     input_buffer.acquire_fence_fd);
+          atomic_prop_count_++;
         }
       }
     }
+  }
 
-    // TODO(user): Remove this and enable the one in Init() onces underruns are fixed
+  // TODO(user): Remove this and enable the one in Init() onces underruns are fixed
+  if (hw_layer_count && !crtc_active_pending_) {
     drm_atomic_intf_->Perform(DRMOps::CRTC_SET_ACTIVE, token_.crtc_id, 1);
+    atomic_prop_count_++;
+    crtc_active_pending_ = true;
   }
 }
 
@@ -502,12 +554,16 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
   DTRACE_SCOPED();
   SetupAtomic(hw_layers, false /* validate */);
 
+  uint32_t prop_count = atomic_prop_count_;
   int ret = drm_atomic_intf_->Commit(false /* synchronous */);
+  UpdatePlaneShadow(ret == 0);
   if (ret) {
     DLOGE("%s failed with error %d", __FUNCTION__, ret);
     return kErrorHardware;
   }
 
+  DLOGV_IF(kTagDriverConfig, "Committed %u atomic properties", prop_count);
+
   int release_fence = -1;
   int retire_fence = -1;
 
@@ -518,8 +574,17 @@ DisplayError HWDeviceDRM::AtomicCommit(HWLayers *hw_layers) {
   LayerStack *stack = hw_layer_info.stack;
   stack->retire_fence_fd = retire_fence;
 
+  // The shared copy is made for the first layer that takes it.
+  int shared_release_fence = -1;
   for (Layer &layer : hw_layer_info.hw_layers) {
-    layer.input_buffer.release_fence_fd = Sys::dup_(release_fence);
+    if (stack->flags.shared_release_fence) {
+      if (shared_release_fence < 0) {
+        shared_release_fence = Sys::dup_(release_fence);
+      }
+      layer.input_buffer.release_fence_fd = shared_release_fence;
+    } else {
+      layer.input_buffer.release_fence_fd = Sys::dup_(release_fence);
+    }
   }
 
   hw_layer_info.sync_handle = release_fence;
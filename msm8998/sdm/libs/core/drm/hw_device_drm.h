@@ -34,6 +34,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <xf86drmMode.h>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -113,6 +114,26 @@ class HWDeviceDRM : public HWInterface {
   DisplayError DefaultCommit(HWLayers *hw_layers);
   DisplayError AtomicCommit(HWLayers *hw_layers);
   void SetupAtomic(HWLayers *hw_layers, bool validate);
+  template <typename T>
+  void SetPlaneProperty(sde_drm::DRMOps op, uint32_t pipe_id, const T &value, T *shadow,
+                        bool force);
+  void UpdatePlaneShadow(bool committed);
+
+  // Plane properties currently known to the driver. Only properties that differ from the shadow
+  // are added to the atomic request.
+  struct DRMPlaneShadow {
+    bool valid = false;
+    bool used = false;
+    uint32_t alpha = 0;
+    uint32_t z_order = 0;
+    sde_drm::DRMBlendType blending = {};
+    sde_drm::DRMRect src = {};
+    sde_drm::DRMRect dst = {};
+    uint32_t h_decimation = 0;
+    uint32_t v_decimation = 0;
+    uint32_t rotation = 0;
+    uint32_t fb_id = 0;
+  };
 
   HWResourceInfo hw_resource_ = {};
   HWPanelInfo hw_panel_info_ = {};
@@ -130,6 +151,10 @@ class HWDeviceDRM : public HWInterface {
   bool default_mode_ = false;
   sde_drm::DRMConnectorInfo connector_info_ = {};
   std::string interface_str_ = "DSI";
+  std::map<uint32_t, DRMPlaneShadow> committed_planes_;  // State after the last commit
+  std::map<uint32_t, DRMPlaneShadow> pending_planes_;    // Committed state + current attempt
+  bool crtc_active_pending_ = false;
+  uint32_t atomic_prop_count_ = 0;                       // Properties emitted for this attempt
 };
 
 }  // namespace sdm
@@ -314,8 +314,7 @@ void HWInfoDRM::GetHWPlanesInfo(HWResourceInfo *hw_resource) {
     }
 
     if (sub_blk_type != kHWSubBlockMax) {
-      hw_resource->supported_formats_map.erase(sub_blk_type);
-      hw_resource->supported_formats_map.insert(make_pair(sub_blk_type, supported_sdm_formats));
+      hw_resource->SetSupportedFormats(sub_blk_type, supported_sdm_formats);
     }
   }
 }
@@ -336,8 +335,7 @@ void HWInfoDRM::GetWBInfo(HWResourceInfo *hw_resource) {
     GetSDMFormat(fmts.first, fmts.second, &supported_sdm_formats);
   }
 
-  hw_resource->supported_formats_map.erase(sub_blk_type);
-  hw_resource->supported_formats_map.insert(make_pair(sub_blk_type, supported_sdm_formats));
+  hw_resource->SetSupportedFormats(sub_blk_type, supported_sdm_formats);
 
   drm_mgr_intf_->UnregisterDisplay(token);
 }
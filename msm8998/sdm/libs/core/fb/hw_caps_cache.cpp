@@ -0,0 +1,400 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utils/constants.h>
+#include <utils/debug.h>
+#include <utils/sys.h>
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "hw_caps_cache.h"
+
+#define __CLASS__ "HWCapsCache"
+
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace sdm {
+
+class CapsWriter {
+ public:
+  explicit CapsWriter(vector<uint8_t> *data) : data_(data) { }
+
+  template <class T>
+  void Field(T *value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Field type must be trivially copyable");
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(value);
+    data_->insert(data_->end(), bytes, bytes + sizeof(T));
+  }
+
+  template <class T>
+  void Field(vector<T> *values) {
+    uint32_t count = UINT32(values->size());
+    Field(&count);
+    for (auto &value : *values) {
+      Field(&value);
+    }
+  }
+
+  void Field(string *value) {
+    uint32_t size = UINT32(value->size());
+    Field(&size);
+    data_->insert(data_->end(), value->begin(), value->end());
+  }
+
+  void Field(FormatsMap *formats_map) {
+    uint32_t count = UINT32(formats_map->size());
+    Field(&count);
+    for (auto &it : *formats_map) {
+      HWSubBlockType sub_blk_type = it.first;
+      Field(&sub_blk_type);
+      Field(&it.second);
+    }
+  }
+
+ private:
+  vector<uint8_t> *data_ = NULL;
+};
+
+class CapsReader {
+ public:
+  explicit CapsReader(const vector<uint8_t> &data) : data_(data) { }
+
+  template <class T>
+  void Field(T *value) {
+    static_assert(std::is_trivially_copyable<T>::value, "Field type must be trivially copyable");
+    if (!Consume(sizeof(T))) {
+      return;
+    }
+    memcpy(value, &data_[offset_ - sizeof(T)], sizeof(T));
+  }
+
+  template <class T>
+  void Field(vector<T> *values) {
+    uint32_t count = 0;
+    Field(&count);
+    if (!valid_ || count > (data_.size() - offset_)) {
+      valid_ = false;
+      return;
+    }
+    values->resize(count);
+    for (auto &value : *values) {
+      Field(&value);
+    }
+  }
+
+  void Field(string *value) {
+    uint32_t size = 0;
+    Field(&size);
+    if (!Consume(size)) {
+      return;
+    }
+    value->assign(reinterpret_cast<const char *>(&data_[offset_ - size]), size);
+  }
+
+  void Field(FormatsMap *formats_map) {
+    uint32_t count = 0;
+    Field(&count);
+    formats_map->clear();
+    for (uint32_t i = 0; valid_ && i < count; i++) {
+      HWSubBlockType sub_blk_type = kHWSubBlockMax;
+      std::vector<LayerBufferFormat> formats;
+      Field(&sub_blk_type);
+      Field(&formats);
+      (*formats_map)[sub_blk_type] = formats;
+    }
+  }
+
+  bool IsValid() const { return valid_ && (offset_ == data_.size()); }
+
+ private:
+  bool Consume(size_t size) {
+    if (!valid_ || size > (data_.size() - offset_)) {
+      valid_ = false;
+      return false;
+    }
+    offset_ += size;
+    return true;
+  }
+
+  const vector<uint8_t> &data_;
+  size_t offset_ = 0;
+  bool valid_ = true;
+};
+
+// Single field list shared by the writer and the reader, so that both sides always agree on the
+// serialized layout.
+template <class Archive>
+static void SerializeResourceInfo(Archive *ar, HWResourceInfo *info) {
+  ar->Field(&info->hw_version);
+  ar->Field(&info->hw_revision);
+  ar->Field(&info->num_dma_pipe);
+  ar->Field(&info->num_vig_pipe);
+  ar->Field(&info->num_rgb_pipe);
+  ar->Field(&info->num_cursor_pipe);
+  ar->Field(&info->num_blending_stages);
+  ar->Field(&info->num_control);
+  ar->Field(&info->num_mixer_to_disp);
+  ar->Field(&info->smp_total);
+  ar->Field(&info->smp_size);
+  ar->Field(&info->num_smp_per_pipe);
+  ar->Field(&info->max_scale_up);
+  ar->Field(&info->max_scale_down);
+  ar->Field(&info->max_bandwidth_low);
+  ar->Field(&info->max_bandwidth_high);
+  ar->Field(&info->max_mixer_width);
+  ar->Field(&info->max_pipe_width);
+  ar->Field(&info->max_cursor_size);
+  ar->Field(&info->max_pipe_bw);
+  ar->Field(&info->max_sde_clk);
+  ar->Field(&info->clk_fudge_factor);
+  ar->Field(&info->macrotile_nv12_factor);
+  ar->Field(&info->macrotile_factor);
+  ar->Field(&info->linear_factor);
+  ar->Field(&info->scale_factor);
+  ar->Field(&info->extra_fudge_factor);
+  ar->Field(&info->amortizable_threshold);
+  ar->Field(&info->system_overhead_lines);
+  ar->Field(&info->has_bwc);
+  ar->Field(&info->has_ubwc);
+  ar->Field(&info->has_decimation);
+  ar->Field(&info->has_macrotile);
+  ar->Field(&info->has_non_scalar_rgb);
+  ar->Field(&info->is_src_split);
+  ar->Field(&info->perf_calc);
+  ar->Field(&info->has_dyn_bw_support);
+  ar->Field(&info->separate_rotator);
+  ar->Field(&info->has_qseed3);
+  ar->Field(&info->has_concurrent_writeback);
+  ar->Field(&info->has_ppp);
+  ar->Field(&info->writeback_index);
+  ar->Field(&info->dyn_bw_info);
+  ar->Field(&info->hw_pipes);
+  ar->Field(&info->supported_formats_map);
+  ar->Field(&info->hw_rot_info.type);
+  ar->Field(&info->hw_rot_info.num_rotator);
+  ar->Field(&info->hw_rot_info.has_downscale);
+  ar->Field(&info->hw_rot_info.device_path);
+  ar->Field(&info->hw_rot_info.min_downscale);
+  ar->Field(&info->hw_rot_info.downscale_compression);
+  ar->Field(&info->hw_dest_scalar_info);
+  ar->Field(&info->has_avr);
+  ar->Field(&info->has_hdr);
+}
+
+bool HWCapsCache::LoadResourceInfo(HWResourceInfo *hw_resource) {
+  vector<uint8_t> payload;
+  if (!IsEnabled() || !ReadFile(GetResourcePath(), &payload)) {
+    return false;
+  }
+
+  HWResourceInfo info;
+  CapsReader reader(payload);
+  SerializeResourceInfo(&reader, &info);
+  if (!reader.IsValid()) {
+    DLOGW("Discarding malformed resource snapshot");
+    return false;
+  }
+
+  // The format bitsets are not part of the snapshot, rebuild them from the lists
+  const FormatsMap formats_map = info.supported_formats_map;
+  for (auto &it : formats_map) {
+    info.SetSupportedFormats(it.first, it.second);
+  }
+
+  *hw_resource = info;
+
+  return true;
+}
+
+void HWCapsCache::StoreResourceInfo(const HWResourceInfo &hw_resource) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  HWResourceInfo info = hw_resource;
+  vector<uint8_t> payload;
+  CapsWriter writer(&payload);
+  SerializeResourceInfo(&writer, &info);
+  WriteFile(GetResourcePath(), payload);
+}
+
+bool HWCapsCache::LoadPanelInfo(int device_node, HWPanelInfo *panel_info) {
+  vector<uint8_t> payload;
+  if (!IsEnabled() || !ReadFile(GetPanelPath(device_node), &payload)) {
+    return false;
+  }
+
+  HWPanelInfo info;
+  CapsReader reader(payload);
+  reader.Field(&info);
+  if (!reader.IsValid()) {
+    DLOGW("Discarding malformed panel snapshot for device node %d", device_node);
+    return false;
+  }
+
+  *panel_info = info;
+
+  return true;
+}
+
+void HWCapsCache::StorePanelInfo(int device_node, const HWPanelInfo &panel_info) {
+  if (!IsEnabled()) {
+    return;
+  }
+
+  HWPanelInfo info = panel_info;
+  vector<uint8_t> payload;
+  CapsWriter writer(&payload);
+  writer.Field(&info);
+  WriteFile(GetPanelPath(device_node), payload);
+}
+
+bool HWCapsCache::IsEnabled() {
+  return !Debug::IsHWCapsCacheDisabled() && (GetFingerprint() != 0);
+}
+
+uint64_t HWCapsCache::GetFingerprint() {
+  // The kernel build identifies the MDSS driver and the capabilities it exposes, the panel
+  // selected by the bootloader identifies the panel nodes. Both stay constant for a boot.
+  static const uint64_t fingerprint = []() -> uint64_t {
+    string version;
+    Sys::fstream version_fs("/proc/version", std::fstream::in);
+    if (!version_fs.is_open() || !Sys::getline_(version_fs, version) || version.empty()) {
+      return 0;
+    }
+
+    string panel;
+    string cmdline;
+    Sys::fstream cmdline_fs("/proc/cmdline", std::fstream::in);
+    if (cmdline_fs.is_open() && Sys::getline_(cmdline_fs, cmdline)) {
+      size_t start = cmdline.find(kPanelCmdlineKey);
+      if (start != string::npos) {
+        size_t end = cmdline.find(' ', start);
+        panel = cmdline.substr(start, (end == string::npos) ? end : (end - start));
+      }
+    }
+
+    uint64_t hash = Hash(version.data(), version.size(), 0);
+    return Hash(panel.data(), panel.size(), hash);
+  }();
+
+  return fingerprint;
+}
+
+uint64_t HWCapsCache::Hash(const void *data, size_t size, uint64_t seed) {
+  // 64 bit FNV-1a
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  uint64_t hash = seed ? seed : 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hash;
+}
+
+string HWCapsCache::GetResourcePath() {
+  return string(kCachePath) + "/sdm_hw_resource.bin";
+}
+
+string HWCapsCache::GetPanelPath(int device_node) {
+  return string(kCachePath) + "/sdm_panel_info_fb" + to_string(device_node) + ".bin";
+}
+
+bool HWCapsCache::ReadFile(const string &path, vector<uint8_t> *payload) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st = {};
+  if (fstat(fd, &st) || (st.st_size <= INT(sizeof(Header)))) {
+    close(fd);
+    return false;
+  }
+
+  vector<uint8_t> data(size_t(st.st_size));
+  ssize_t bytes = read(fd, data.data(), data.size());
+  close(fd);
+  if (bytes != ssize_t(data.size())) {
+    return false;
+  }
+
+  Header header;
+  memcpy(&header, data.data(), sizeof(header));
+  size_t payload_size = data.size() - sizeof(header);
+  const uint8_t *payload_data = data.data() + sizeof(header);
+  if ((header.magic != kMagic) || (header.version != kVersion) ||
+      (header.resource_size != sizeof(HWResourceInfo)) ||
+      (header.panel_size != sizeof(HWPanelInfo)) || (header.fingerprint != GetFingerprint()) ||
+      (header.payload_size != payload_size) ||
+      (header.checksum != Hash(payload_data, payload_size, 0))) {
+    DLOGI("Snapshot %s is stale", path.c_str());
+    return false;
+  }
+
+  payload->assign(payload_data, payload_data + payload_size);
+
+  return true;
+}
+
+void HWCapsCache::WriteFile(const string &path, const vector<uint8_t> &payload) {
+  Header header;
+  header.fingerprint = GetFingerprint();
+  header.payload_size = UINT32(payload.size());
+  header.checksum = Hash(payload.data(), payload.size(), 0);
+
+  vector<uint8_t> data(sizeof(header) + payload.size());
+  memcpy(data.data(), &header, sizeof(header));
+  memcpy(data.data() + sizeof(header), payload.data(), payload.size());
+
+  // Write to a temporary file and rename, so that a reader never observes a partial snapshot.
+  string tmp_path = path + ".tmp";
+  int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0660);
+  if (fd < 0) {
+    // Data partition may not be available yet during early boot.
+    DLOGI("Unable to create %s, error = %s", tmp_path.c_str(), strerror(errno));
+    return;
+  }
+
+  ssize_t bytes = write(fd, data.data(), data.size());
+  close(fd);
+  if ((bytes != ssize_t(data.size())) || rename(tmp_path.c_str(), path.c_str())) {
+    DLOGW("Failed to write %s, error = %s", path.c_str(), strerror(errno));
+    unlink(tmp_path.c_str());
+  }
+}
+
+}  // namespace sdm
@@ -0,0 +1,75 @@
+/*
+* Copyright (c) 2017, The Linux Foundation. All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted
+* provided that the following conditions are met:
+*    * Redistributions of source code must retain the above copyright notice, this list of
+*      conditions and the following disclaimer.
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of
+*      conditions and the following disclaimer in the documentation and/or other materials provided
+*      with the distribution.
+*    * Neither the name of The Linux Foundation nor the names of its contributors may be used to
+*      endorse or promote products derived from this software without specific prior written
+*      permission.
+*
+* THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+* NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+* FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+* OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __HW_CAPS_CACHE_H__
+#define __HW_CAPS_CACHE_H__
+
+#include <private/hw_info_types.h>
+
+#include <string>
+#include <vector>
+
+namespace sdm {
+
+// Binary snapshot of the capabilities parsed from the MDSS sysfs nodes. The snapshot is stamped
+// with a fingerprint of the running kernel and panel selection and is discarded on any mismatch,
+// in which case the caller falls back to parsing the text nodes and refreshes the snapshot.
+class HWCapsCache {
+ public:
+  static bool LoadResourceInfo(HWResourceInfo *hw_resource);
+  static void StoreResourceInfo(const HWResourceInfo &hw_resource);
+  static bool LoadPanelInfo(int device_node, HWPanelInfo *panel_info);
+  static void StorePanelInfo(int device_node, const HWPanelInfo &panel_info);
+
+ private:
+  // Bump whenever the serialized layout of HWResourceInfo or HWPanelInfo changes.
+  static const uint32_t kVersion = 1;
+  static const uint32_t kMagic = 0x53434448;  // "HDCS"
+  static constexpr const char *kCachePath = "/data/misc/display";
+  static constexpr const char *kPanelCmdlineKey = "mdss_mdp.panel=";
+
+  struct Header {
+    uint32_t magic = kMagic;
+    uint32_t version = kVersion;
+    uint32_t resource_size = sizeof(HWResourceInfo);
+    uint32_t panel_size = sizeof(HWPanelInfo);
+    uint64_t fingerprint = 0;
+    uint64_t checksum = 0;
+    uint32_t payload_size = 0;
+    uint32_t reserved = 0;
+  };
+
+  static bool IsEnabled();
+  static uint64_t GetFingerprint();
+  static uint64_t Hash(const void *data, size_t size, uint64_t seed);
+  static std::string GetResourcePath();
+  static std::string GetPanelPath(int device_node);
+  static bool ReadFile(const std::string &path, std::vector<uint8_t> *payload);
+  static void WriteFile(const std::string &path, const std::vector<uint8_t> &payload);
+};
+
+}  // namespace sdm
+
+#endif  // __HW_CAPS_CACHE_H__
+
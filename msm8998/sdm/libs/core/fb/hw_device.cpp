@@ -42,6 +42,7 @@
 #include <linux/fb.h>
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <utils/formats.h>
 #include <utils/sys.h>
 #include <vector>
 #include <algorithm>
@@ -52,6 +53,7 @@
 #include "hw_hdmi.h"
 #include "hw_virtual.h"
 #include "hw_info_interface.h"
+#include "hw_caps_cache.h"
 
 #define __CLASS__ "HWDevice"
 
@@ -489,8 +491,9 @@ DisplayError HWDevice::Commit(HWLayers *hw_layers) {
   }
 #endif
   // MDP returns only one release fence for the entire layer stack. Duplicate this fence into all
-  // layers being composed by MDP.
-
+  // layers being composed by MDP, or hand out a single copy if the client can share it.
+  // The shared copy is made for the first layer that takes it.
+  int shared_release_fence = -1;
   for (uint32_t i = 0; i < hw_layer_count; i++) {
     const Layer &layer = hw_layer_info.hw_layers.at(i);
     LayerBuffer *input_buffer = const_cast<LayerBuffer *>(&layer.input_buffer);
@@ -502,7 +505,14 @@ DisplayError HWDevice::Commit(HWLayers *hw_layers) {
       continue;
     }
 
-    input_buffer->release_fence_fd = Sys::dup_(mdp_commit.release_fence);
+    if (stack->flags.shared_release_fence) {
+      if (shared_release_fence < 0) {
+        shared_release_fence = Sys::dup_(mdp_commit.release_fence);
+      }
+      input_buffer->release_fence_fd = shared_release_fence;
+    } else {
+      input_buffer->release_fence_fd = Sys::dup_(mdp_commit.release_fence);
+    }
   }
 
   hw_layer_info.sync_handle = Sys::dup_(mdp_commit.release_fence);
@@ -545,52 +555,76 @@ DisplayError HWDevice::Flush() {
   return kErrorNone;
 }
 
+// MDP pixel format for every LayerBufferFormat, in GetFormatIndex() order.
+static constexpr uint32_t kMDPFormatUnsupported = UINT32_MAX;
+static constexpr struct {
+  LayerBufferFormat format;
+  uint32_t mdp_format;
+} kMDPFormatMap[] = {
+  { kFormatARGB8888,                 MDP_ARGB_8888 },
+  { kFormatRGBA8888,                 MDP_RGBA_8888 },
+  { kFormatBGRA8888,                 MDP_BGRA_8888 },
+  { kFormatXRGB8888,                 kMDPFormatUnsupported },
+  { kFormatRGBX8888,                 MDP_RGBX_8888 },
+  { kFormatBGRX8888,                 MDP_BGRX_8888 },
+  { kFormatRGBA5551,                 MDP_RGBA_5551 },
+  { kFormatRGBA4444,                 MDP_RGBA_4444 },
+  { kFormatRGB888,                   MDP_RGB_888 },
+  { kFormatBGR888,                   MDP_BGR_888 },
+  { kFormatRGB565,                   MDP_RGB_565 },
+  { kFormatBGR565,                   MDP_BGR_565 },
+  { kFormatRGBA8888Ubwc,             MDP_RGBA_8888_UBWC },
+  { kFormatRGBX8888Ubwc,             MDP_RGBX_8888_UBWC },
+  { kFormatBGR565Ubwc,               MDP_RGB_565_UBWC },
+  { kFormatRGBA1010102,              MDP_RGBA_1010102 },
+  { kFormatARGB2101010,              MDP_ARGB_2101010 },
+  { kFormatRGBX1010102,              MDP_RGBX_1010102 },
+  { kFormatXRGB2101010,              MDP_XRGB_2101010 },
+  { kFormatBGRA1010102,              MDP_BGRA_1010102 },
+  { kFormatABGR2101010,              MDP_ABGR_2101010 },
+  { kFormatBGRX1010102,              MDP_BGRX_1010102 },
+  { kFormatXBGR2101010,              MDP_XBGR_2101010 },
+  { kFormatRGBA1010102Ubwc,          MDP_RGBA_1010102_UBWC },
+  { kFormatRGBX1010102Ubwc,          MDP_RGBX_1010102_UBWC },
+  { kFormatRGB101010,                kMDPFormatUnsupported },
+  { kFormatYCbCr420Planar,           MDP_Y_CB_CR_H2V2 },
+  { kFormatYCrCb420Planar,           MDP_Y_CR_CB_H2V2 },
+  { kFormatYCrCb420PlanarStride16,   MDP_Y_CR_CB_GH2V2 },
+  { kFormatYCbCr420SemiPlanar,       MDP_Y_CBCR_H2V2 },
+  { kFormatYCrCb420SemiPlanar,       MDP_Y_CRCB_H2V2 },
+  { kFormatYCbCr420SemiPlanarVenus,  MDP_Y_CBCR_H2V2_VENUS },
+  { kFormatYCbCr422H1V2SemiPlanar,   MDP_Y_CBCR_H1V2 },
+  { kFormatYCrCb422H1V2SemiPlanar,   MDP_Y_CRCB_H1V2 },
+  { kFormatYCbCr422H2V1SemiPlanar,   MDP_Y_CBCR_H2V1 },
+  { kFormatYCrCb422H2V1SemiPlanar,   MDP_Y_CRCB_H2V1 },
+  { kFormatYCbCr420SPVenusUbwc,      MDP_Y_CBCR_H2V2_UBWC },
+  { kFormatYCrCb420SemiPlanarVenus,  kMDPFormatUnsupported },
+  { kFormatYCbCr420P010,             MDP_Y_CBCR_H2V2_P010 },
+  { kFormatYCbCr420TP10Ubwc,         MDP_Y_CBCR_H2V2_TP10_UBWC },
+  { kFormatYCbCr422H2V1Packed,       MDP_YCBYCR_H2V1 },
+  { kFormatCbYCrY422H2V1Packed,      MDP_CBYCRY_H2V1 },
+};
+
+static_assert(sizeof(kMDPFormatMap) / sizeof(kMDPFormatMap[0]) == kFormatIndexMax,
+              "kMDPFormatMap must have one entry per LayerBufferFormat");
+
+static constexpr bool IsMDPFormatMapOrdered(uint32_t index) {
+  return (index == kFormatIndexMax) ||
+         ((GetFormatIndex(kMDPFormatMap[index].format) == index) &&
+          IsMDPFormatMapOrdered(index + 1));
+}
+
+static_assert(IsMDPFormatMapOrdered(0), "kMDPFormatMap entries are not in GetFormatIndex() order");
+
 DisplayError HWDevice::SetFormat(const LayerBufferFormat &source, uint32_t *target) {
-  switch (source) {
-  case kFormatARGB8888:                 *target = MDP_ARGB_8888;         break;
-  case kFormatRGBA8888:                 *target = MDP_RGBA_8888;         break;
-  case kFormatBGRA8888:                 *target = MDP_BGRA_8888;         break;
-  case kFormatRGBX8888:                 *target = MDP_RGBX_8888;         break;
-  case kFormatBGRX8888:                 *target = MDP_BGRX_8888;         break;
-  case kFormatRGBA5551:                 *target = MDP_RGBA_5551;         break;
-  case kFormatRGBA4444:                 *target = MDP_RGBA_4444;         break;
-  case kFormatRGB888:                   *target = MDP_RGB_888;           break;
-  case kFormatBGR888:                   *target = MDP_BGR_888;           break;
-  case kFormatRGB565:                   *target = MDP_RGB_565;           break;
-  case kFormatBGR565:                   *target = MDP_BGR_565;           break;
-  case kFormatYCbCr420Planar:           *target = MDP_Y_CB_CR_H2V2;      break;
-  case kFormatYCrCb420Planar:           *target = MDP_Y_CR_CB_H2V2;      break;
-  case kFormatYCrCb420PlanarStride16:   *target = MDP_Y_CR_CB_GH2V2;     break;
-  case kFormatYCbCr420SemiPlanar:       *target = MDP_Y_CBCR_H2V2;       break;
-  case kFormatYCrCb420SemiPlanar:       *target = MDP_Y_CRCB_H2V2;       break;
-  case kFormatYCbCr422H1V2SemiPlanar:   *target = MDP_Y_CBCR_H1V2;       break;
-  case kFormatYCrCb422H1V2SemiPlanar:   *target = MDP_Y_CRCB_H1V2;       break;
-  case kFormatYCbCr422H2V1SemiPlanar:   *target = MDP_Y_CBCR_H2V1;       break;
-  case kFormatYCrCb422H2V1SemiPlanar:   *target = MDP_Y_CRCB_H2V1;       break;
-  case kFormatYCbCr422H2V1Packed:       *target = MDP_YCBYCR_H2V1;       break;
-  case kFormatYCbCr420SemiPlanarVenus:  *target = MDP_Y_CBCR_H2V2_VENUS; break;
-  case kFormatRGBA8888Ubwc:             *target = MDP_RGBA_8888_UBWC;    break;
-  case kFormatRGBX8888Ubwc:             *target = MDP_RGBX_8888_UBWC;    break;
-  case kFormatBGR565Ubwc:               *target = MDP_RGB_565_UBWC;      break;
-  case kFormatYCbCr420SPVenusUbwc:      *target = MDP_Y_CBCR_H2V2_UBWC;  break;
-  case kFormatCbYCrY422H2V1Packed:      *target = MDP_CBYCRY_H2V1;       break;
-  case kFormatRGBA1010102:              *target = MDP_RGBA_1010102;      break;
-  case kFormatARGB2101010:              *target = MDP_ARGB_2101010;      break;
-  case kFormatRGBX1010102:              *target = MDP_RGBX_1010102;      break;
-  case kFormatXRGB2101010:              *target = MDP_XRGB_2101010;      break;
-  case kFormatBGRA1010102:              *target = MDP_BGRA_1010102;      break;
-  case kFormatABGR2101010:              *target = MDP_ABGR_2101010;      break;
-  case kFormatBGRX1010102:              *target = MDP_BGRX_1010102;      break;
-  case kFormatXBGR2101010:              *target = MDP_XBGR_2101010;      break;
-  case kFormatRGBA1010102Ubwc:          *target = MDP_RGBA_1010102_UBWC; break;
-  case kFormatRGBX1010102Ubwc:          *target = MDP_RGBX_1010102_UBWC; break;
-  case kFormatYCbCr420P010:             *target = MDP_Y_CBCR_H2V2_P010;  break;
-  case kFormatYCbCr420TP10Ubwc:         *target = MDP_Y_CBCR_H2V2_TP10_UBWC; break;
-  default:
+  uint32_t index = GetFormatIndex(source);
+  if (index >= kFormatIndexMax || kMDPFormatMap[index].mdp_format == kMDPFormatUnsupported) {
     DLOGE("Unsupported format type %d", source);
     return kErrorParameters;
   }
 
+  *target = kMDPFormatMap[index].mdp_format;
+
   return kErrorNone;
 }
 
@@ -603,61 +637,14 @@ DisplayError HWDevice::SetStride(HWDeviceType device_type, LayerBufferFormat for
     return kErrorNone;
   }
 
-  switch (format) {
-  case kFormatARGB8888:
-  case kFormatRGBA8888:
-  case kFormatBGRA8888:
-  case kFormatRGBX8888:
-  case kFormatBGRX8888:
-  case kFormatRGBA8888Ubwc:
-  case kFormatRGBX8888Ubwc:
-  case kFormatRGBA1010102:
-  case kFormatARGB2101010:
-  case kFormatRGBX1010102:
-  case kFormatXRGB2101010:
-  case kFormatBGRA1010102:
-  case kFormatABGR2101010:
-  case kFormatBGRX1010102:
-  case kFormatXBGR2101010:
-  case kFormatRGBA1010102Ubwc:
-  case kFormatRGBX1010102Ubwc:
-    *target = width * 4;
-    break;
-  case kFormatRGB888:
-  case kFormatBGR888:
-    *target = width * 3;
-    break;
-  case kFormatRGB565:
-  case kFormatBGR565:
-  case kFormatBGR565Ubwc:
-    *target = width * 2;
-    break;
-  case kFormatYCbCr420SemiPlanarVenus:
-  case kFormatYCbCr420SPVenusUbwc:
-  case kFormatYCbCr420Planar:
-  case kFormatYCrCb420Planar:
-  case kFormatYCrCb420PlanarStride16:
-  case kFormatYCbCr420SemiPlanar:
-  case kFormatYCrCb420SemiPlanar:
-  case kFormatYCbCr420P010:
-  case kFormatYCbCr420TP10Ubwc:
-    *target = width;
-    break;
-  case kFormatYCbCr422H2V1Packed:
-  case kFormatCbYCrY422H2V1Packed:
-  case kFormatYCrCb422H2V1SemiPlanar:
-  case kFormatYCrCb422H1V2SemiPlanar:
-  case kFormatYCbCr422H2V1SemiPlanar:
-  case kFormatYCbCr422H1V2SemiPlanar:
-  case kFormatRGBA5551:
-  case kFormatRGBA4444:
-    *target = width * 2;
-    break;
-  default:
+  uint32_t bpp = GetStrideBpp(format);
+  if (!bpp) {
     DLOGE("Unsupported format type %d", format);
     return kErrorParameters;
   }
 
+  *target = width * bpp;
+
   return kErrorNone;
 }
 
@@ -720,7 +707,7 @@ void HWDevice::SetMDPFlags(const Layer *layer, const bool &is_rotator_used,
 int HWDevice::GetFBNodeIndex(HWDeviceType device_type) {
   for (int i = 0; i < kFBNodeMax; i++) {
     HWPanelInfo panel_info;
-    GetHWPanelInfoByNode(i, &panel_info);
+    GetCachedHWPanelInfoByNode(i, &panel_info);
     switch (device_type) {
     case kDevicePrimary:
       if (panel_info.is_primary_panel) {
@@ -789,13 +776,26 @@ void HWDevice::GetHWPanelNameByNode(int device_node, HWPanelInfo *panel_info) {
   }
 }
 
-void HWDevice::GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info) {
+void HWDevice::GetCachedHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info) {
+  // Node enumeration only relies on the static panel properties, which are served from the
+  // capability snapshot. The device's own panel info is always read from sysfs, as the panel mode
+  // and resolution can change at runtime.
+  if (HWCapsCache::LoadPanelInfo(device_node, panel_info)) {
+    return;
+  }
+
+  if (GetHWPanelInfoByNode(device_node, panel_info)) {
+    HWCapsCache::StorePanelInfo(device_node, *panel_info);
+  }
+}
+
+bool HWDevice::GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info) {
   string file_name = fb_path_ + to_string(device_node) + "/msm_fb_panel_info";
 
   Sys::fstream fs(file_name, fstream::in);
   if (!fs.is_open()) {
     DLOGW("Failed to open msm_fb_panel_info node device node %d", device_node);
-    return;
+    return false;
   }
 
   string line;
@@ -874,6 +874,8 @@ void HWDevice::GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info) {
   GetSplitInfo(device_node, panel_info);
   GetHWPanelNameByNode(device_node, panel_info);
   GetHWPanelMaxBrightnessFromNode(panel_info);
+
+  return true;
 }
 
 void HWDevice::GetHWDisplayPortAndMode(int device_node, HWPanelInfo *panel_info) {
@@ -1013,7 +1015,7 @@ bool HWDevice::EnableHotPlugDetection(int enable) {
   // Enable HPD for all pluggable devices.
   for (int i = 0; i < kFBNodeMax; i++) {
     HWPanelInfo panel_info;
-    GetHWPanelInfoByNode(i, &panel_info);
+    GetCachedHWPanelInfoByNode(i, &panel_info);
     if (panel_info.is_pluggable == true) {
       snprintf(hpdpath , sizeof(hpdpath), "%s%d/hpd", fb_path_, i);
 
@@ -120,7 +120,8 @@ class HWDevice : public HWInterface {
   int GetFBNodeIndex(HWDeviceType device_type);
   // Populates HWPanelInfo based on node index
   void PopulateHWPanelInfo();
-  void GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info);
+  bool GetHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info);
+  void GetCachedHWPanelInfoByNode(int device_node, HWPanelInfo *panel_info);
   void GetHWPanelNameByNode(int device_node, HWPanelInfo *panel_info);
   void GetHWDisplayPortAndMode(int device_node, HWPanelInfo *panel_info);
   void GetSplitInfo(int device_node, HWPanelInfo *panel_info);
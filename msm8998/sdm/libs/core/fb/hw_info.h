@@ -46,6 +46,7 @@ class HWInfo: public HWInfoInterface {
   virtual DisplayError GetFirstDisplayInterfaceType(HWDisplayInterfaceInfo *hw_disp_info);
 
  private:
+  DisplayError ParseHWResourceInfo(HWResourceInfo *hw_resource);
   virtual DisplayError GetHWRotatorInfo(HWResourceInfo *hw_resource);
   virtual DisplayError GetMDSSRotatorInfo(HWResourceInfo *hw_resource);
   virtual DisplayError GetV4L2RotatorInfo(HWResourceInfo *hw_resource);
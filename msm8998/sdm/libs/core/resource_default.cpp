@@ -264,7 +264,7 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
   // left pipe is needed
   if (left_pipe->valid) {
     need_scale = IsScalingNeeded(left_pipe);
-    left_index = GetPipe(hw_block_id, need_scale);
+    left_index = GetPipe(hw_block_id, need_scale, layer.input_buffer.format);
     if (left_index >= num_pipe_) {
       DLOGV_IF(kTagResources, "Get left pipe failed: hw_block_id = %d, need_scale = %d",
                hw_block_id, need_scale);
@@ -289,7 +289,7 @@ DisplayError ResourceDefault::Prepare(Handle display_ctx, HWLayers *hw_layers) {
 
   need_scale = IsScalingNeeded(right_pipe);
 
-  right_index = GetPipe(hw_block_id, need_scale);
+  right_index = GetPipe(hw_block_id, need_scale, layer.input_buffer.format);
   if (right_index >= num_pipe_) {
     DLOGV_IF(kTagResources, "Get right pipe failed: hw_block_id = %d, need_scale = %d", hw_block_id,
              need_scale);
@@ -422,19 +422,21 @@ uint32_t ResourceDefault::NextPipe(PipeType type, HWBlockType hw_block_id) {
   return SearchPipe(hw_block_id, src_pipes, num_pipe);
 }
 
-uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_id, bool need_scale) {
+uint32_t ResourceDefault::GetPipe(HWBlockType hw_block_id, bool need_scale,
+                                  LayerBufferFormat format) {
   uint32_t index = num_pipe_;
 
   // The default behavior is to assume RGB and VG pipes have scalars
-  if (!need_scale) {
+  if (!need_scale && hw_res_info_.IsFormatSupported(kHWDMAPipe, format)) {
     index = NextPipe(kPipeTypeDMA, hw_block_id);
   }
 
-  if ((index >= num_pipe_) && (!need_scale || !hw_res_info_.has_non_scalar_rgb)) {
+  if ((index >= num_pipe_) && (!need_scale || !hw_res_info_.has_non_scalar_rgb) &&
+      hw_res_info_.IsFormatSupported(kHWRGBPipe, format)) {
     index = NextPipe(kPipeTypeRGB, hw_block_id);
   }
 
-  if (index >= num_pipe_) {
+  if ((index >= num_pipe_) && hw_res_info_.IsFormatSupported(kHWVIGPipe, format)) {
     index = NextPipe(kPipeTypeVIG, hw_block_id);
   }
 
@@ -109,7 +109,7 @@ class ResourceDefault : public ResourceInterface {
   DisplayError Deinit();
   uint32_t NextPipe(PipeType pipe_type, HWBlockType hw_block_id);
   uint32_t SearchPipe(HWBlockType hw_block_id, SourcePipe *src_pipes, uint32_t num_pipe);
-  uint32_t GetPipe(HWBlockType hw_block_id, bool need_scale);
+  uint32_t GetPipe(HWBlockType hw_block_id, bool need_scale, LayerBufferFormat format);
   bool IsScalingNeeded(const HWPipeInfo *pipe_info);
   DisplayError Config(DisplayResourceContext *display_resource_ctx, HWLayers *hw_layers);
   DisplayError DisplaySplitConfig(DisplayResourceContext *display_resource_ctx,
@@ -24,6 +24,10 @@
 
 #include <utils/constants.h>
 #include <utils/debug.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
 
 #include "strategy.h"
 #include "utils/rect.h"
@@ -90,7 +94,12 @@ DisplayError Strategy::Start(HWLayersInfo *hw_layers_info, uint32_t *max_attempt
   }
 
   if (partial_update_intf_) {
-    partial_update_intf_->Start(pu_constraints);
+    pu_constraints_ = pu_constraints;
+    if (pu_constraints_.enable && hw_panel_info_.partial_update) {
+      pu_constraints_.max_dirty_rects = GetMaxDirtyRects();
+      GenerateDirtyRegion(&pu_constraints_.dirty_region);
+    }
+    partial_update_intf_->Start(pu_constraints_);
   }
   GenerateROI();
 
@@ -255,4 +264,121 @@ DisplayError Strategy::Purge() {
 }
 
 
+void Strategy::GenerateDirtyRegion(std::vector<LayerRect> *dirty_region) {
+  LayerStack *layer_stack = hw_layers_info_->stack;
+  LayerRect fb_rect(0.0f, 0.0f, FLOAT(fb_config_.x_pixels), FLOAT(fb_config_.y_pixels));
+  LayerRect mixer_rect(0.0f, 0.0f, FLOAT(mixer_attributes_.width),
+                       FLOAT(mixer_attributes_.height));
+  uint32_t max_rects = pu_constraints_.max_dirty_rects;
+
+  dirty_region->clear();
+  if (layer_stack->flags.geometry_changed) {
+    dirty_region->push_back(mixer_rect);
+    return;
+  }
+
+  std::vector<LayerRect> layer_damage;
+  for (uint32_t i = 0; i < hw_layers_info_->app_layer_count; i++) {
+    Layer *layer = layer_stack->layers.at(i);
+    if (!layer->flags.updating) {
+      continue;
+    }
+
+    const LayerRect &src = layer->src_rect;
+    const LayerRect &dst = layer->dst_rect;
+    const LayerTransform &transform = layer->transform;
+    bool scaled = ((src.right - src.left) != (dst.right - dst.left)) ||
+                  ((src.bottom - src.top) != (dst.bottom - dst.top));
+    bool transformed = (transform.rotation != 0.0f) || transform.flip_horizontal ||
+                       transform.flip_vertical;
+
+    // Damage is reported in buffer coordinates. It maps onto the display by an offset only for
+    // layers which are neither scaled nor transformed, the others are considered fully updated.
+    layer_damage.clear();
+    if (layer->dirty_regions.empty() || scaled || transformed) {
+      layer_damage.push_back(dst);
+    } else {
+      for (auto &dirty : layer->dirty_regions) {
+        LayerRect rect = Intersection(dirty, src);
+        if (IsValid(rect)) {
+          MapRect(src, dst, rect, &rect);
+          layer_damage.push_back(rect);
+        }
+      }
+    }
+
+    for (auto &damage : layer_damage) {
+      LayerRect rect;
+      MapRect(fb_rect, mixer_rect, damage, &rect);
+      rect = Intersection(LayerRect(floorf(rect.left), floorf(rect.top), ceilf(rect.right),
+                                    ceilf(rect.bottom)), mixer_rect);
+      UnionRegion(rect, dirty_region);
+      if (dirty_region->size() > kMaxAccumulatedDirtyRects) {
+        MergeDirtyRegion(max_rects, dirty_region);
+      }
+    }
+  }
+
+  MergeDirtyRegion(max_rects, dirty_region);
+
+  if (!dirty_region->empty()) {
+    float bounds_area = GetArea(Union(dirty_region->data(), UINT32(dirty_region->size())));
+    DLOGD_IF(kTagStrategy, "Dirty region: %zu rects, %.0f pixels, bounding box %.0f pixels, "
+             "frame %.0f pixels", dirty_region->size(), GetArea(*dirty_region), bounds_area,
+             GetArea(mixer_rect));
+  }
+}
+
+void Strategy::MergeDirtyRegion(uint32_t max_rects, std::vector<LayerRect> *dirty_region) {
+  // Merging two rects into their bounding box costs the pixels of the box which did not change.
+  // Greedily merge the cheapest pair until the region fits in the allowed number of rects.
+  while (dirty_region->size() > std::max(max_rects, 1U)) {
+    size_t merge_a = 0;
+    size_t merge_b = 1;
+    float min_cost = FLT_MAX;
+    for (size_t a = 0; a < dirty_region->size(); a++) {
+      for (size_t b = a + 1; b < dirty_region->size(); b++) {
+        const LayerRect &rect_a = dirty_region->at(a);
+        const LayerRect &rect_b = dirty_region->at(b);
+        float cost = GetArea(Union(rect_a, rect_b)) - GetArea(rect_a) - GetArea(rect_b);
+        if (cost < min_cost) {
+          min_cost = cost;
+          merge_a = a;
+          merge_b = b;
+        }
+      }
+    }
+
+    LayerRect bounds = Union(dirty_region->at(merge_a), dirty_region->at(merge_b));
+    dirty_region->erase(dirty_region->begin() + INT(merge_b));
+    dirty_region->erase(dirty_region->begin() + INT(merge_a));
+
+    // The bounding box can overlap other rects of the region, absorb them to keep it disjoint.
+    bool absorbed = true;
+    while (absorbed) {
+      absorbed = false;
+      for (auto it = dirty_region->begin(); it != dirty_region->end(); it++) {
+        if (IsValid(Intersection(*it, bounds))) {
+          bounds = Union(bounds, *it);
+          dirty_region->erase(it);
+          absorbed = true;
+          break;
+        }
+      }
+    }
+
+    dirty_region->push_back(bounds);
+  }
+}
+
+uint32_t Strategy::GetMaxDirtyRects() {
+  // Dual DSI panels take a separate set of ROIs for the left and the right half.
+  uint32_t max_rects = hw_panel_info_.left_roi_count;
+  if (display_attributes_.is_device_split) {
+    max_rects += hw_panel_info_.right_roi_count;
+  }
+
+  return std::max(max_rects, 1U);
+}
+
 }  // namespace sdm
@@ -28,6 +28,7 @@
 #include <core/display_interface.h>
 #include <private/extension_interface.h>
 #include <core/buffer_allocator.h>
+#include <vector>
 
 namespace sdm {
 
@@ -55,6 +56,13 @@ class Strategy {
 
  private:
   void GenerateROI();
+  void GenerateDirtyRegion(std::vector<LayerRect> *dirty_region);
+  void MergeDirtyRegion(uint32_t max_rects, std::vector<LayerRect> *dirty_region);
+  uint32_t GetMaxDirtyRects();
+
+  // Upper bound on the rects accumulated before merging, to keep the merge cost bounded when
+  // layers report many damage rects.
+  static const uint32_t kMaxAccumulatedDirtyRects = 16;
 
   ExtensionInterface *extension_intf_ = NULL;
   StrategyInterface *strategy_intf_ = NULL;
@@ -70,6 +78,7 @@ class Strategy {
   bool tried_default_ = false;
   bool disable_gpu_comp_ = false;
   BufferAllocator *buffer_allocator_ = NULL;
+  PUConstraints pu_constraints_ = {};
 };
 
 }  // namespace sdm
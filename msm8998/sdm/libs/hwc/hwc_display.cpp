@@ -184,6 +184,13 @@ int HWCDisplay::Init() {
 
   tone_mapper_ = new HWCToneMapper();
 
+  if (qdutils::getDriverType() == qdutils::DriverType::DRM &&
+      hw_get_module(GRALLOC_HARDWARE_MODULE_ID,
+                    reinterpret_cast<const hw_module_t **>(&gralloc_module_)) != 0) {
+    DLOGW("Failed to load gralloc module, buffers will not be registered with DRM");
+    gralloc_module_ = NULL;
+  }
+
   display_intf_->GetRefreshRateRange(&min_refresh_rate_, &max_refresh_rate_);
   current_refresh_rate_ = max_refresh_rate_;
 
@@ -400,6 +407,12 @@ DisplayError HWCDisplay::CECMessage(char *message) {
   return kErrorNone;
 }
 
+DisplayError HWCDisplay::RefreshRateChanged(uint32_t refresh_rate) {
+  // Keeps the rate the next frame is compared against in line with the panel
+  current_refresh_rate_ = refresh_rate;
+  return kErrorNone;
+}
+
 int HWCDisplay::AllocateLayerStack(hwc_display_contents_1_t *content_list) {
   if (!content_list || !content_list->numHwLayers) {
     DLOGW("Invalid content list");
@@ -521,6 +534,13 @@ void HWCDisplay::CommitLayerParams(hwc_layer_1_t *hwc_layer, Layer *layer) {
     layer_buffer.planes[0].stride = UINT32(pvt_handle->width);
     layer_buffer.size = pvt_handle->size;
     layer_buffer.fb_id = pvt_handle->fb_id;
+    // Gralloc registers the buffer with DRM the first time it is committed to a pipe.
+    bool scanout = (layer->composition == kCompositionSDE) ||
+                   (layer->composition == kCompositionGPUTarget);
+    if (!layer_buffer.fb_id && scanout && gralloc_module_) {
+      gralloc_module_->perform(gralloc_module_, GRALLOC_MODULE_PERFORM_GET_FB_ID, pvt_handle,
+                               &layer_buffer.fb_id);
+    }
   }
 
   // if swapinterval property is set to 0 then close and reset the acquireFd
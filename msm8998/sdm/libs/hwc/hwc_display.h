@@ -170,6 +170,7 @@ class HWCDisplay : public DisplayEventHandler {
   virtual DisplayError VSync(const DisplayEventVSync &vsync);
   virtual DisplayError Refresh();
   virtual DisplayError CECMessage(char *message);
+  virtual DisplayError RefreshRateChanged(uint32_t refresh_rate);
 
   int AllocateLayerStack(hwc_display_contents_1_t *content_list);
   void FreeLayerStack();
@@ -253,6 +254,7 @@ class HWCDisplay : public DisplayEventHandler {
   BlitEngine *blit_engine_ = NULL;
   qService::QService *qservice_ = NULL;
   DisplayClass display_class_;
+  const gralloc_module_t *gralloc_module_ = NULL;
 };
 
 inline int HWCDisplay::Perform(uint32_t operation, ...) {
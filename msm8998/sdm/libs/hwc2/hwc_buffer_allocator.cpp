@@ -50,6 +50,10 @@ HWCBufferAllocator::HWCBufferAllocator() {
       gralloc_device_->getFunction(gralloc_device_, GRALLOC1_FUNCTION_RELEASE));
   Perform_ = reinterpret_cast<GRALLOC1_PFN_PERFORM>(
       gralloc_device_->getFunction(gralloc_device_, GRALLOC1_FUNCTION_PERFORM));
+  LockBuffer_ = reinterpret_cast<GRALLOC1_PFN_LOCK>(
+      gralloc_device_->getFunction(gralloc_device_, GRALLOC1_FUNCTION_LOCK));
+  UnlockBuffer_ = reinterpret_cast<GRALLOC1_PFN_UNLOCK>(
+      gralloc_device_->getFunction(gralloc_device_, GRALLOC1_FUNCTION_UNLOCK));
 }
 
 HWCBufferAllocator::~HWCBufferAllocator() {
@@ -114,6 +118,36 @@ DisplayError HWCBufferAllocator::FreeBuffer(BufferInfo *buffer_info) {
   return err;
 }
 
+DisplayError HWCBufferAllocator::MapBuffer(const private_handle_t *handle, int acquire_fence,
+                                           void **base) {
+  gralloc1_rect_t region = {0, 0, handle->width, handle->height};
+  buffer_handle_t buffer = handle;
+  *base = nullptr;
+  if (LockBuffer_(gralloc_device_, buffer, GRALLOC1_PRODUCER_USAGE_NONE,
+                  GRALLOC1_CONSUMER_USAGE_CPU_READ, &region, base, acquire_fence) !=
+      GRALLOC1_ERROR_NONE || !*base) {
+    DLOGE("Failed to map buffer %p", handle);
+    return kErrorMemory;
+  }
+
+  return kErrorNone;
+}
+
+DisplayError HWCBufferAllocator::UnmapBuffer(const private_handle_t *handle) {
+  int32_t release_fence = -1;
+  buffer_handle_t buffer = handle;
+  if (UnlockBuffer_(gralloc_device_, buffer, &release_fence) != GRALLOC1_ERROR_NONE) {
+    DLOGE("Failed to unmap buffer %p", handle);
+    return kErrorMemory;
+  }
+
+  if (release_fence >= 0) {
+    close(release_fence);
+  }
+
+  return kErrorNone;
+}
+
 void HWCBufferAllocator::GetCustomWidthAndHeight(const private_handle_t *handle, int *width,
                                                  int *height) {
   Perform_(gralloc_device_, GRALLOC_MODULE_PERFORM_GET_CUSTOM_STRIDE_AND_HEIGHT_FROM_HANDLE, handle,
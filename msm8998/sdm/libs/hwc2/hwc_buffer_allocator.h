@@ -58,12 +58,18 @@ class HWCBufferAllocator : public BufferAllocator {
   DisplayError GetAllocatedBufferInfo(const BufferConfig &buffer_config,
                                       AllocatedBufferInfo *allocated_buffer_info);
   int SetBufferInfo(LayerBufferFormat format, int *target, int *flags);
+  // Maps the buffer for CPU reads once the fence has signaled. Imported buffers are mapped on
+  // demand, so handle->base cannot be used before this.
+  DisplayError MapBuffer(const private_handle_t *handle, int acquire_fence, void **base);
+  DisplayError UnmapBuffer(const private_handle_t *handle);
 
  private:
   gralloc1_device_t *gralloc_device_ = nullptr;
   const hw_module_t *module_;
   GRALLOC1_PFN_RELEASE ReleaseBuffer_ = nullptr;
   GRALLOC1_PFN_PERFORM Perform_ = nullptr;
+  GRALLOC1_PFN_LOCK LockBuffer_ = nullptr;
+  GRALLOC1_PFN_UNLOCK UnlockBuffer_ = nullptr;
 };
 
 }  // namespace sdm
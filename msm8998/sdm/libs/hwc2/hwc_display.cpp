@@ -323,6 +323,7 @@ void HWCDisplay::BuildLayerStack() {
   layer_stack_ = LayerStack();
   display_rect_ = LayerRect();
   metadata_refresh_rate_ = 0;
+  layer_stack_.flags.shared_release_fence = true;
 
   // Add one layer for fb target
   // TODO(user): Add blit target layers
@@ -715,6 +716,12 @@ DisplayError HWCDisplay::CECMessage(char *message) {
   return kErrorNone;
 }
 
+DisplayError HWCDisplay::RefreshRateChanged(uint32_t refresh_rate) {
+  // Keeps the rate the next frame is compared against in line with the panel
+  current_refresh_rate_ = refresh_rate;
+  return kErrorNone;
+}
+
 HWC2::Error HWCDisplay::PrepareLayerStack(uint32_t *out_num_types, uint32_t *out_num_requests) {
   layer_changes_.clear();
   layer_requests_.clear();
@@ -929,13 +936,24 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(int32_t *out_retire_fence) {
     display_intf_->Flush();
   }
 
+  // Layers composed in the same commit may carry the same shared release fence fd. Wrap every
+  // distinct fd once, it gets closed when the last layer referring to it has handed it out.
+  std::map<int32_t, std::shared_ptr<HWCReleaseFence>> release_fences;
+  auto take_release_fence = [&release_fences](int32_t *fd) {
+    std::shared_ptr<HWCReleaseFence> fence = nullptr;
+    if (*fd >= 0) {
+      auto it = release_fences.find(*fd);
+      if (it == release_fences.end()) {
+        it = release_fences.emplace(*fd, std::make_shared<HWCReleaseFence>(*fd)).first;
+      }
+      fence = it->second;
+    }
+    *fd = -1;
+    return fence;
+  };
+
   // TODO(user): No way to set the client target release fence on SF
-  int32_t &client_target_release_fence =
-      client_target_->GetSDMLayer()->input_buffer.release_fence_fd;
-  if (client_target_release_fence >= 0) {
-    close(client_target_release_fence);
-    client_target_release_fence = -1;
-  }
+  take_release_fence(&client_target_->GetSDMLayer()->input_buffer.release_fence_fd);
 
   for (auto hwc_layer : layer_set_) {
     hwc_layer->ResetGeometryChanges();
@@ -943,16 +961,12 @@ HWC2::Error HWCDisplay::PostCommitLayerStack(int32_t *out_retire_fence) {
     LayerBuffer *layer_buffer = &layer->input_buffer;
 
     if (!flush_) {
+      auto release_fence = take_release_fence(&layer_buffer->release_fence_fd);
       // If swapinterval property is set to 0 or for single buffer layers, do not update f/w
       // release fences and discard fences from driver
-      if (swap_interval_zero_ || layer->flags.single_buffer) {
-        close(layer_buffer->release_fence_fd);
-        layer_buffer->release_fence_fd = -1;
-      } else if (layer->composition != kCompositionGPU) {
-        hwc_layer->PushReleaseFence(layer_buffer->release_fence_fd);
-        layer_buffer->release_fence_fd = -1;
-      } else {
-        hwc_layer->PushReleaseFence(-1);
+      if (!swap_interval_zero_ && !layer->flags.single_buffer) {
+        bool composed_by_gpu = (layer->composition == kCompositionGPU);
+        hwc_layer->PushReleaseFence(composed_by_gpu ? nullptr : release_fence);
       }
     }
 
@@ -1156,7 +1170,8 @@ void HWCDisplay::DumpInputBuffers() {
       }
     }
 
-    if (pvt_handle && pvt_handle->base) {
+    void *base = nullptr;
+    if (pvt_handle && buffer_allocator_->MapBuffer(pvt_handle, -1, &base) == kErrorNone) {
       char dump_file_name[PATH_MAX];
       size_t result = 0;
 
@@ -1166,9 +1181,10 @@ void HWCDisplay::DumpInputBuffers() {
 
       FILE *fp = fopen(dump_file_name, "w+");
       if (fp) {
-        result = fwrite(reinterpret_cast<void *>(pvt_handle->base), pvt_handle->size, 1, fp);
+        result = fwrite(base, pvt_handle->size, 1, fp);
         fclose(fp);
       }
+      buffer_allocator_->UnmapBuffer(pvt_handle);
 
       DLOGI("Frame Dump %s: is %s", dump_file_name, result ? "Successful" : "Failed");
     }
@@ -1596,9 +1612,11 @@ std::string HWCDisplay::Dump() {
   std::ostringstream os;
   os << "-------------------------------" << std::endl;
   os << "HWC2 LayerDump display_id: " << id_ << std::endl;
+  int64_t now = qdutils::LayerCadence::Now();
   for (auto layer : layer_set_) {
     auto sdm_layer = layer->GetSDMLayer();
     auto transform = sdm_layer->transform;
+    auto &cadence = layer->GetCadence();
     os << "-------------------------------" << std::endl;
     os << "layer_id: " << layer->GetId() << std::endl;
     os << "\tz: " << layer->GetZ() << std::endl;
@@ -1612,6 +1630,10 @@ std::string HWCDisplay::Dump() {
           " flip_v: "<< transform.flip_vertical << std::endl;
     os << "\tbuffer_id: " << std::hex << "0x" << sdm_layer->input_buffer.buffer_id << std::dec
        << std::endl;
+    int64_t age = cadence.GetAgeNs(now);
+    os << "\tcadence: rate: " << cadence.GetRate(now) << "fps jitter: " <<
+          cadence.GetJitterMs(now) << "ms age: " << (age < 0 ? age : age / 1000000) <<
+          "ms updates: " << cadence.GetUpdateCount() << std::endl;
   }
   return os.str();
 }
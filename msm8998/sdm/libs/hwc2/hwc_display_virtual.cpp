@@ -135,17 +135,20 @@ HWC2::Error HWCDisplayVirtual::Present(int32_t *out_retire_fence) {
     status = HWCDisplay::CommitLayerStack();
     if (status == HWC2::Error::None) {
       if (dump_frame_count_ && !flush_ && dump_output_layer_) {
-        if (output_handle_ && output_handle_->base) {
+        const private_handle_t *output_handle =
+            reinterpret_cast<const private_handle_t *>(output_buffer_->buffer_id);
+        void *base = nullptr;
+        if (output_handle && buffer_allocator_->MapBuffer(output_handle,
+                                                          layer_stack_.retire_fence_fd,
+                                                          &base) == kErrorNone) {
           BufferInfo buffer_info;
-          const private_handle_t *output_handle =
-              reinterpret_cast<const private_handle_t *>(output_buffer_->buffer_id);
           buffer_info.buffer_config.width = static_cast<uint32_t>(output_handle->width);
           buffer_info.buffer_config.height = static_cast<uint32_t>(output_handle->height);
           buffer_info.buffer_config.format =
               GetSDMFormat(output_handle->format, output_handle->flags);
           buffer_info.alloc_buffer_info.size = static_cast<uint32_t>(output_handle->size);
-          DumpOutputBuffer(buffer_info, reinterpret_cast<void *>(output_handle->base),
-                           layer_stack_.retire_fence_fd);
+          DumpOutputBuffer(buffer_info, base, layer_stack_.retire_fence_fd);
+          buffer_allocator_->UnmapBuffer(output_handle);
         }
       }
 
@@ -74,15 +74,11 @@ HWCLayer::HWCLayer(hwc2_display_t display_id, HWCBufferAllocator *buf_allocator)
   layer_ = new Layer();
   // Fences are deferred, so the first time this layer is presented, return -1
   // TODO(user): Verify that fences are properly obtained on suspend/resume
-  release_fences_.push(-1);
+  release_fences_.push(nullptr);
 }
 
 HWCLayer::~HWCLayer() {
-  // Close any fences left for this layer
-  while (!release_fences_.empty()) {
-    close(release_fences_.front());
-    release_fences_.pop();
-  }
+  // Fences left for this layer are closed along with their last reference
   close(ion_fd_);
   if (layer_) {
     delete layer_;
@@ -154,6 +150,12 @@ HWC2::Error HWCLayer::SetLayerBuffer(buffer_handle_t buffer, int32_t acquire_fen
   layer_buffer->acquire_fence_fd = acquire_fence;
   layer_buffer->size = handle->size;
   layer_buffer->buffer_id = reinterpret_cast<uint64_t>(handle);
+
+  // Front buffer rendering reuses the handle for every update
+  if (layer_buffer->buffer_id != last_buffer_id_ || layer_->flags.single_buffer) {
+    cadence_.Update(qdutils::LayerCadence::Now());
+    last_buffer_id_ = layer_buffer->buffer_id;
+  }
   layer_buffer->fb_id = handle->fb_id;
 
   return HWC2::Error::None;
@@ -571,7 +573,7 @@ void HWCLayer::SetComposition(const LayerComposition &sdm_composition) {
 
   return;
 }
-void HWCLayer::PushReleaseFence(int32_t fence) {
+void HWCLayer::PushReleaseFence(std::shared_ptr<HWCReleaseFence> fence) {
   release_fences_.push(fence);
 }
 int32_t HWCLayer::PopReleaseFence(void) {
@@ -579,7 +581,27 @@ int32_t HWCLayer::PopReleaseFence(void) {
     return -1;
   auto fence = release_fences_.front();
   release_fences_.pop();
-  return fence;
+  if (!fence) {
+    return -1;
+  }
+  // The client owns the returned fd. Hand over the fence itself if no other layer refers to it.
+  return (fence.use_count() == 1) ? fence->Release() : fence->Dup();
+}
+
+HWCReleaseFence::~HWCReleaseFence() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+int32_t HWCReleaseFence::Dup() const {
+  return (fd_ >= 0) ? dup(fd_) : -1;
+}
+
+int32_t HWCReleaseFence::Release() {
+  int32_t fd = fd_;
+  fd_ = -1;
+  return fd;
 }
 
 }  // namespace sdm
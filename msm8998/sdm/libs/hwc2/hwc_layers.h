@@ -25,6 +25,7 @@
 
 #include <gralloc_priv.h>
 #include <qdMetaData.h>
+#include <layer_cadence.h>
 #include <core/layer_stack.h>
 #define HWC2_INCLUDE_STRINGIFICATION
 #define HWC2_USE_CPP11
@@ -32,6 +33,7 @@
 #undef HWC2_INCLUDE_STRINGIFICATION
 #undef HWC2_USE_CPP11
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
 #include "core/buffer_allocator.h"
@@ -54,6 +56,22 @@ enum GeometryChanges {
   kRemoved      = 0x100,
 };
 
+// Release fence fd returned by SDM for one commit. With a shared release fence the same fd is
+// referenced by all layers composed in that commit and is closed along with the last reference.
+class HWCReleaseFence {
+ public:
+  explicit HWCReleaseFence(int32_t fd) : fd_(fd) {}
+  ~HWCReleaseFence();
+  int32_t Dup() const;
+  int32_t Release();
+
+ private:
+  HWCReleaseFence(const HWCReleaseFence &) = delete;
+  HWCReleaseFence &operator=(const HWCReleaseFence &) = delete;
+
+  int32_t fd_ = -1;
+};
+
 class HWCLayer {
  public:
   explicit HWCLayer(hwc2_display_t display_id, HWCBufferAllocator *buf_allocator);
@@ -80,8 +98,9 @@ class HWCLayer {
   HWC2::Composition GetDeviceSelectedCompositionType() { return device_selected_; }
   uint32_t GetGeometryChanges() { return geometry_changes_; }
   void ResetGeometryChanges() { geometry_changes_ = GeometryChanges::kNone; }
-  void PushReleaseFence(int32_t fence);
+  void PushReleaseFence(std::shared_ptr<HWCReleaseFence> fence);
   int32_t PopReleaseFence(void);
+  const qdutils::LayerCadence &GetCadence() const { return cadence_; }
 
  private:
   Layer *layer_ = nullptr;
@@ -89,7 +108,7 @@ class HWCLayer {
   const hwc2_layer_t id_;
   const hwc2_display_t display_id_;
   static std::atomic<hwc2_layer_t> next_id_;
-  std::queue<int32_t> release_fences_;
+  std::queue<std::shared_ptr<HWCReleaseFence>> release_fences_;
   int ion_fd_ = -1;
   HWCBufferAllocator *buffer_allocator_ = NULL;
 
@@ -98,6 +117,8 @@ class HWCLayer {
   // Composition selected by SDM
   HWC2::Composition device_selected_ = HWC2::Composition::Device;
   uint32_t geometry_changes_ = GeometryChanges::kNone;
+  qdutils::LayerCadence cadence_;
+  uint64_t last_buffer_id_ = 0;
 
   void SetRect(const hwc_rect_t &source, LayerRect *target);
   void SetRect(const hwc_frect_t &source, LayerRect *target);
@@ -33,95 +33,100 @@
 
 namespace sdm {
 
+struct FormatInfo {
+  LayerBufferFormat format;
+  const char *name;
+  uint32_t stride_bpp;
+  bool ubwc;
+  bool ten_bit;
+  BufferLayout layout;
+};
+
+// Entries must be kept in GetFormatIndex() order; this is enforced at compile time below.
+static constexpr FormatInfo kFormatInfo[] = {
+  // format                          name                     bpp  ubwc   10bit  layout
+  { kFormatARGB8888,                 "ARGB_8888",               4, false, false, kLinear  },
+  { kFormatRGBA8888,                 "RGBA_8888",               4, false, false, kLinear  },
+  { kFormatBGRA8888,                 "BGRA_8888",               4, false, false, kLinear  },
+  { kFormatXRGB8888,                 "XRGB_8888",               4, false, false, kLinear  },
+  { kFormatRGBX8888,                 "RGBX_8888",               4, false, false, kLinear  },
+  { kFormatBGRX8888,                 "BGRX_8888",               4, false, false, kLinear  },
+  { kFormatRGBA5551,                 "RGBA_5551",               2, false, false, kLinear  },
+  { kFormatRGBA4444,                 "RGBA_4444",               2, false, false, kLinear  },
+  { kFormatRGB888,                   "RGB_888",                 3, false, false, kLinear  },
+  { kFormatBGR888,                   "BGR_888",                 3, false, false, kLinear  },
+  { kFormatRGB565,                   "RGB_565",                 2, false, false, kLinear  },
+  { kFormatBGR565,                   "BGR_565",                 2, false, false, kLinear  },
+  { kFormatRGBA8888Ubwc,             "RGBA_8888_UBWC",          4, true,  false, kUBWC    },
+  { kFormatRGBX8888Ubwc,             "RGBX_8888_UBWC",          4, true,  false, kUBWC    },
+  { kFormatBGR565Ubwc,               "BGR_565_UBWC",            2, true,  false, kUBWC    },
+  { kFormatRGBA1010102,              "RGBA_1010102",            4, false, true,  kLinear  },
+  { kFormatARGB2101010,              "ARGB_2101010",            4, false, true,  kLinear  },
+  { kFormatRGBX1010102,              "RGBX_1010102",            4, false, true,  kLinear  },
+  { kFormatXRGB2101010,              "XRGB_2101010",            4, false, true,  kLinear  },
+  { kFormatBGRA1010102,              "BGRA_1010102",            4, false, true,  kLinear  },
+  { kFormatABGR2101010,              "ABGR_2101010",            4, false, true,  kLinear  },
+  { kFormatBGRX1010102,              "BGRX_1010102",            4, false, true,  kLinear  },
+  { kFormatXBGR2101010,              "XBGR_2101010",            4, false, true,  kLinear  },
+  { kFormatRGBA1010102Ubwc,          "RGBA_1010102_UBWC",       4, true,  true,  kUBWC    },
+  { kFormatRGBX1010102Ubwc,          "RGBX_1010102_UBWC",       4, true,  true,  kUBWC    },
+  { kFormatRGB101010,                "UNKNOWN",                 0, false, false, kLinear  },
+  { kFormatYCbCr420Planar,           "Y_CB_CR_420",             1, false, false, kLinear  },
+  { kFormatYCrCb420Planar,           "Y_CR_CB_420",             1, false, false, kLinear  },
+  { kFormatYCrCb420PlanarStride16,   "Y_CR_CB_420_STRIDE16",    1, false, false, kLinear  },
+  { kFormatYCbCr420SemiPlanar,       "Y_CBCR_420",              1, false, false, kLinear  },
+  { kFormatYCrCb420SemiPlanar,       "Y_CRCB_420",              1, false, false, kLinear  },
+  { kFormatYCbCr420SemiPlanarVenus,  "Y_CBCR_420_VENUS",        1, false, false, kLinear  },
+  { kFormatYCbCr422H1V2SemiPlanar,   "Y_CBCR_422_H1V2",         2, false, false, kLinear  },
+  { kFormatYCrCb422H1V2SemiPlanar,   "Y_CRCB_422_H1V2",         2, false, false, kLinear  },
+  { kFormatYCbCr422H2V1SemiPlanar,   "Y_CBCR_422_H2V1",         2, false, false, kLinear  },
+  { kFormatYCrCb422H2V1SemiPlanar,   "Y_CRCB_422_H2V2",         2, false, false, kLinear  },
+  { kFormatYCbCr420SPVenusUbwc,      "Y_CBCR_420_VENUS_UBWC",   1, true,  false, kUBWC    },
+  { kFormatYCrCb420SemiPlanarVenus,  "Y_CRCB_420_VENUS",        0, false, false, kLinear  },
+  { kFormatYCbCr420P010,             "Y_CBCR_420_P010",         1, false, true,  kLinear  },
+  { kFormatYCbCr420TP10Ubwc,         "Y_CBCR_420_TP10_UBWC",    1, true,  true,  kTPTiled },
+  { kFormatYCbCr422H2V1Packed,       "YCBYCR_422_H2V1",         2, false, false, kLinear  },
+  { kFormatCbYCrY422H2V1Packed,      "CBYCRY_422_H2V1",         2, false, false, kLinear  },
+};
+
+static_assert(sizeof(kFormatInfo) / sizeof(kFormatInfo[0]) == kFormatIndexMax,
+              "kFormatInfo must have one entry per LayerBufferFormat");
+
+static constexpr bool IsFormatInfoOrdered(uint32_t index) {
+  return (index == kFormatIndexMax) ||
+         ((GetFormatIndex(kFormatInfo[index].format) == index) && IsFormatInfoOrdered(index + 1));
+}
+
+static_assert(IsFormatInfoOrdered(0), "kFormatInfo entries are not in GetFormatIndex() order");
+
+static inline const FormatInfo *GetFormatInfo(LayerBufferFormat format) {
+  uint32_t index = GetFormatIndex(format);
+  return (index < kFormatIndexMax) ? &kFormatInfo[index] : nullptr;
+}
+
 bool IsUBWCFormat(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatRGBA8888Ubwc:
-  case kFormatRGBX8888Ubwc:
-  case kFormatBGR565Ubwc:
-  case kFormatYCbCr420SPVenusUbwc:
-  case kFormatRGBA1010102Ubwc:
-  case kFormatRGBX1010102Ubwc:
-  case kFormatYCbCr420TP10Ubwc:
-    return true;
-  default:
-    return false;
-  }
+  const FormatInfo *info = GetFormatInfo(format);
+  return info && info->ubwc;
 }
 
 bool Is10BitFormat(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatRGBA1010102:
-  case kFormatARGB2101010:
-  case kFormatRGBX1010102:
-  case kFormatXRGB2101010:
-  case kFormatBGRA1010102:
-  case kFormatABGR2101010:
-  case kFormatBGRX1010102:
-  case kFormatXBGR2101010:
-  case kFormatRGBA1010102Ubwc:
-  case kFormatRGBX1010102Ubwc:
-  case kFormatYCbCr420P010:
-  case kFormatYCbCr420TP10Ubwc:
-    return true;
-  default:
-    return false;
-  }
+  const FormatInfo *info = GetFormatInfo(format);
+  return info && info->ten_bit;
 }
 
 const char *GetFormatString(const LayerBufferFormat &format) {
-  switch (format) {
-  case kFormatARGB8888:                 return "ARGB_8888";
-  case kFormatRGBA8888:                 return "RGBA_8888";
-  case kFormatBGRA8888:                 return "BGRA_8888";
-  case kFormatXRGB8888:                 return "XRGB_8888";
-  case kFormatRGBX8888:                 return "RGBX_8888";
-  case kFormatBGRX8888:                 return "BGRX_8888";
-  case kFormatRGBA5551:                 return "RGBA_5551";
-  case kFormatRGBA4444:                 return "RGBA_4444";
-  case kFormatRGB888:                   return "RGB_888";
-  case kFormatBGR888:                   return "BGR_888";
-  case kFormatRGB565:                   return "RGB_565";
-  case kFormatBGR565:                   return "BGR_565";
-  case kFormatRGBA8888Ubwc:             return "RGBA_8888_UBWC";
-  case kFormatRGBX8888Ubwc:             return "RGBX_8888_UBWC";
-  case kFormatBGR565Ubwc:               return "BGR_565_UBWC";
-  case kFormatYCbCr420Planar:           return "Y_CB_CR_420";
-  case kFormatYCrCb420Planar:           return "Y_CR_CB_420";
-  case kFormatYCrCb420PlanarStride16:   return "Y_CR_CB_420_STRIDE16";
-  case kFormatYCbCr420SemiPlanar:       return "Y_CBCR_420";
-  case kFormatYCrCb420SemiPlanar:       return "Y_CRCB_420";
-  case kFormatYCbCr420SemiPlanarVenus:  return "Y_CBCR_420_VENUS";
-  case kFormatYCrCb420SemiPlanarVenus:  return "Y_CRCB_420_VENUS";
-  case kFormatYCbCr422H1V2SemiPlanar:   return "Y_CBCR_422_H1V2";
-  case kFormatYCrCb422H1V2SemiPlanar:   return "Y_CRCB_422_H1V2";
-  case kFormatYCbCr422H2V1SemiPlanar:   return "Y_CBCR_422_H2V1";
-  case kFormatYCrCb422H2V1SemiPlanar:   return "Y_CRCB_422_H2V2";
-  case kFormatYCbCr420SPVenusUbwc:      return "Y_CBCR_420_VENUS_UBWC";
-  case kFormatYCbCr422H2V1Packed:       return "YCBYCR_422_H2V1";
-  case kFormatCbYCrY422H2V1Packed:      return "CBYCRY_422_H2V1";
-  case kFormatRGBA1010102:              return "RGBA_1010102";
-  case kFormatARGB2101010:              return "ARGB_2101010";
-  case kFormatRGBX1010102:              return "RGBX_1010102";
-  case kFormatXRGB2101010:              return "XRGB_2101010";
-  case kFormatBGRA1010102:              return "BGRA_1010102";
-  case kFormatABGR2101010:              return "ABGR_2101010";
-  case kFormatBGRX1010102:              return "BGRX_1010102";
-  case kFormatXBGR2101010:              return "XBGR_2101010";
-  case kFormatRGBA1010102Ubwc:          return "RGBA_1010102_UBWC";
-  case kFormatRGBX1010102Ubwc:          return "RGBX_1010102_UBWC";
-  case kFormatYCbCr420P010:             return "Y_CBCR_420_P010";
-  case kFormatYCbCr420TP10Ubwc:         return "Y_CBCR_420_TP10_UBWC";
-  default:                              return "UNKNOWN";
-  }
+  const FormatInfo *info = GetFormatInfo(format);
+  return info ? info->name : "UNKNOWN";
 }
 
 BufferLayout GetBufferLayout(LayerBufferFormat format) {
-  switch (format) {
-  case kFormatYCbCr420TP10Ubwc:
-    return kTPTiled;
-  default:
-    return (IsUBWCFormat(format) ? kUBWC : kLinear);
-  }
+  const FormatInfo *info = GetFormatInfo(format);
+  return info ? info->layout : kLinear;
+}
+
+uint32_t GetStrideBpp(LayerBufferFormat format) {
+  const FormatInfo *info = GetFormatInfo(format);
+  return info ? info->stride_bpp : 0;
 }
 
 }  // namespace sdm
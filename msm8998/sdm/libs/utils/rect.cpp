@@ -31,11 +31,32 @@
 #include <utils/rect.h>
 #include <utils/constants.h>
 #include <algorithm>
+#include <vector>
+
+#if defined(__ARM_HAVE_NEON)
+#include <arm_neon.h>
+#endif
 
 #define __CLASS__ "RectUtils"
 
 namespace sdm {
 
+#if defined(__ARM_HAVE_NEON)
+static_assert(sizeof(LayerRect) == (4 * sizeof(float)), "LayerRect must be a packed float4");
+
+// With right and bottom negated, the intersection of two rects is the lane-wise max of their
+// vectors and the union is the lane-wise min, so either takes a single instruction per rect.
+static const float kRectSign[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+
+static inline float32x4_t LoadRect(const LayerRect &rect, const float32x4_t &sign) {
+  return vmulq_f32(vld1q_f32(&rect.left), sign);
+}
+
+static inline void StoreRect(const float32x4_t &value, const float32x4_t &sign, LayerRect *rect) {
+  vst1q_f32(&rect->left, vmulq_f32(value, sign));
+}
+#endif
+
 bool IsValid(const LayerRect &rect) {
   return ((rect.bottom > rect.top) && (rect.right > rect.left));
 }
@@ -252,5 +273,174 @@ RectOrientation GetOrientation(const LayerRect &in_rect) {
   return kOrientationLandscape;
 }
 
-}  // namespace sdm
+float GetArea(const LayerRect &rect) {
+  if (!IsValid(rect)) {
+    return 0.0f;
+  }
+
+  return (rect.right - rect.left) * (rect.bottom - rect.top);
+}
+
+LayerRect Union(const LayerRect *rects, uint32_t count) {
+  LayerRect res;
+  uint32_t i = 0;
+
+  // Seed with the first valid rect, invalid rects do not contribute to the union.
+  while (i < count && !IsValid(rects[i])) {
+    i++;
+  }
+
+  if (i == count) {
+    return LayerRect();
+  }
+
+#if defined(__ARM_HAVE_NEON)
+  float32x4_t sign = vld1q_f32(kRectSign);
+  float32x4_t acc = LoadRect(rects[i++], sign);
+  for (; i < count; i++) {
+    if (IsValid(rects[i])) {
+      acc = vminq_f32(acc, LoadRect(rects[i], sign));
+    }
+  }
+  StoreRect(acc, sign, &res);
+#else
+  res = rects[i++];
+  for (; i < count; i++) {
+    if (IsValid(rects[i])) {
+      res.left = std::min(res.left, rects[i].left);
+      res.top = std::min(res.top, rects[i].top);
+      res.right = std::max(res.right, rects[i].right);
+      res.bottom = std::max(res.bottom, rects[i].bottom);
+    }
+  }
+#endif
+
+  return res;
+}
+
+void Intersection(const LayerRect *rects, uint32_t count, const LayerRect &clip,
+                  LayerRect *out_rects) {
+  if (!IsValid(clip)) {
+    std::fill(out_rects, out_rects + count, LayerRect());
+    return;
+  }
+
+#if defined(__ARM_HAVE_NEON)
+  float32x4_t sign = vld1q_f32(kRectSign);
+  float32x4_t clip_value = LoadRect(clip, sign);
+  for (uint32_t i = 0; i < count; i++) {
+    if (!IsValid(rects[i])) {
+      out_rects[i] = LayerRect();
+      continue;
+    }
+    LayerRect res;
+    StoreRect(vmaxq_f32(LoadRect(rects[i], sign), clip_value), sign, &res);
+    out_rects[i] = IsValid(res) ? res : LayerRect();
+  }
+#else
+  for (uint32_t i = 0; i < count; i++) {
+    out_rects[i] = Intersection(rects[i], clip);
+  }
+#endif
+}
+
+void Intersection(const LayerRect *rects1, uint32_t count1, const LayerRect *rects2,
+                  uint32_t count2, std::vector<LayerRect> *out_rects) {
+  std::vector<LayerRect> clipped(count1);
+
+  for (uint32_t i = 0; i < count2; i++) {
+    Intersection(rects1, count1, rects2[i], clipped.data());
+    for (auto &rect : clipped) {
+      if (IsValid(rect)) {
+        out_rects->push_back(rect);
+      }
+    }
+  }
+}
 
+// Geometrical deduction of rect2 from rect1. Appends up to four disjoint rects covering the part
+// of rect1 that lies outside rect2.
+void SubtractToRegion(const LayerRect &rect1, const LayerRect &rect2,
+                      std::vector<LayerRect> *out_rects) {
+  if (!IsValid(rect1)) {
+    return;
+  }
+
+  LayerRect overlap = Intersection(rect1, rect2);
+  if (!IsValid(overlap)) {
+    out_rects->push_back(rect1);
+    return;
+  }
+
+  if (overlap.top > rect1.top) {
+    out_rects->push_back(LayerRect(rect1.left, rect1.top, rect1.right, overlap.top));
+  }
+
+  if (overlap.bottom < rect1.bottom) {
+    out_rects->push_back(LayerRect(rect1.left, overlap.bottom, rect1.right, rect1.bottom));
+  }
+
+  if (overlap.left > rect1.left) {
+    out_rects->push_back(LayerRect(rect1.left, overlap.top, overlap.left, overlap.bottom));
+  }
+
+  if (overlap.right < rect1.right) {
+    out_rects->push_back(LayerRect(overlap.right, overlap.top, rect1.right, overlap.bottom));
+  }
+}
+
+void UnionRegion(const LayerRect &rect, std::vector<LayerRect> *region) {
+  if (!IsValid(rect)) {
+    return;
+  }
+
+  // Rects fully covered by the new rect are dropped rather than fragmenting the new rect.
+  region->erase(std::remove_if(region->begin(), region->end(), [&rect](const LayerRect &r) {
+                  return IsCongruent(Intersection(r, rect), r);
+                }), region->end());
+
+  std::vector<LayerRect> pieces(1, rect);
+  std::vector<LayerRect> remaining;
+  for (auto &existing : *region) {
+    remaining.clear();
+    for (auto &piece : pieces) {
+      SubtractToRegion(piece, existing, &remaining);
+    }
+    pieces.swap(remaining);
+    if (pieces.empty()) {
+      return;
+    }
+  }
+
+  region->insert(region->end(), pieces.begin(), pieces.end());
+}
+
+void SubtractRegion(const LayerRect &rect, std::vector<LayerRect> *region) {
+  if (!IsValid(rect)) {
+    return;
+  }
+
+  std::vector<LayerRect> remaining;
+  for (auto &existing : *region) {
+    SubtractToRegion(existing, rect, &remaining);
+  }
+  region->swap(remaining);
+}
+
+void IntersectRegion(const LayerRect &clip, std::vector<LayerRect> *region) {
+  Intersection(region->data(), UINT32(region->size()), clip, region->data());
+  region->erase(std::remove_if(region->begin(), region->end(), [](const LayerRect &r) {
+                  return !IsValid(r);
+                }), region->end());
+}
+
+float GetArea(const std::vector<LayerRect> &region) {
+  float area = 0.0f;
+  for (auto &rect : region) {
+    area += GetArea(rect);
+  }
+
+  return area;
+}
+
+}  // namespace sdm